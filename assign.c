@@ -0,0 +1,370 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "assign.h"
+
+struct pairs {
+	const struct entities *ent;
+	const struct tech_numbers *tn;
+	const struct bomber *designs;
+	bool direct;
+	struct hb_assignment *res;
+};
+
+static int eval_pair(void *ctx, struct hb_worker *w, unsigned long i)
+{
+	struct pairs *x = ctx;
+	unsigned int d = i / x->res->nmanf, m = i % x->res->nmanf;
+	const struct bomber *b = x->designs + d;
+	struct hb_assign_pair *r = x->res->pair + i;
+
+	/* Refits stay with the type's manufacturer */
+	if (b->refit != REFIT_FRESH && b->manf != x->ent->manf[m])
+		return 0;
+	w->b = *b;
+	w->b.manf = x->ent->manf[m];
+	r->rc = calc_bomber(&w->b, x->tn);
+	if (r->rc || w->b.error)
+		return 0;
+	r->ok = true;
+	r->tproto = w->b.tproto;
+	r->tprod = w->b.tprod;
+	r->cost = w->b.cproto + w->b.cprod;
+	r->days = x->direct ? max(r->tproto, r->tprod) : r->tproto + r->tprod;
+	return 0;
+}
+
+struct search {
+	unsigned int n, m;
+	bool direct;
+	const bool *refit; /* [n]: a Mark or Mod, which goes first */
+	double *least; /* [n]: a design's days where it's quickest */
+	unsigned int *opts; /* [n]: manufacturers it can go to */
+	unsigned int *order; /* designs: those with one place, then longest */
+	double *rest; /* [k * 2]: least tproto and tprod of order[k..n-1] */
+	unsigned int *cand; /* [k * m]: manufacturers to try at depth k */
+	double *finish; /* [k * m]: when each would be done with it */
+	unsigned int *queue; /* [m * n]: each manufacturer's designs in turn */
+	unsigned int *len; /* [m]: how many it has */
+	double *busy; /* [m * 2]: its days of prototyping and tooling */
+	double *span; /* [m]: when it would be done with them */
+	unsigned int *manf; /* [n]: current placement */
+	unsigned long nodes;
+	bool found;
+};
+
+static const struct hb_assign_pair *pair_of(const struct hb_assignment *res,
+					    unsigned int d, unsigned int m)
+{
+	return res->pair + d * res->nmanf + m;
+}
+
+/* The order in which a manufacturer takes its designs: refits first, as
+ * hb_schedule() puts them, then by Johnson's rule, which gets a run of
+ * prototyping then tooling done soonest: those quicker to prototype than
+ * to tool first, quickest to prototype first, then the rest, slowest to
+ * tool first
+ */
+static bool takes_before(const struct search *s,
+			 const struct hb_assignment *res, unsigned int m,
+			 unsigned int x, unsigned int y)
+{
+	const struct hb_assign_pair *a = pair_of(res, x, m),
+				    *b = pair_of(res, y, m);
+	bool ax = a->tproto <= a->tprod, by = b->tproto <= b->tprod;
+
+	if (s->refit[x] != s->refit[y])
+		return s->refit[x];
+	if (ax != by)
+		return ax;
+	return ax ? a->tproto < b->tproto : a->tprod > b->tprod;
+}
+
+static void enqueue(struct search *s, const struct hb_assignment *res,
+		    unsigned int m, unsigned int d)
+{
+	unsigned int *q = s->queue + m * s->n, j;
+
+	for (j = s->len[m]++; j && takes_before(s, res, m, d, q[j - 1]); j--)
+		q[j] = q[j - 1];
+	q[j] = d;
+}
+
+static void dequeue(struct search *s, unsigned int m, unsigned int d)
+{
+	unsigned int *q = s->queue + m * s->n, j;
+
+	for (j = 0; q[j] != d; j++)
+		;
+	memmove(q + j, q + j + 1, (--s->len[m] - j) * sizeof(*q));
+}
+
+/* When manufacturer m would be done with its queue, with one prototype
+ * and one tooling job at a time; fills in start[] if it's given
+ */
+static double run(const struct search *s, const struct hb_assignment *res,
+		  unsigned int m, double *start)
+{
+	const unsigned int *q = s->queue + m * s->n;
+	const struct hb_assign_pair *a;
+	double proto = 0, tool = 0;
+	unsigned int j;
+
+	for (j = 0; j < s->len[m]; j++) {
+		a = pair_of(res, q[j], m);
+		if (start)
+			start[q[j]] = proto;
+		proto += a->tproto;
+		/* Off the drawing board, tooling needn't wait for the prototype */
+		tool = s->direct ? tool + a->tprod
+				 : max(tool, proto) + a->tprod;
+	}
+	return max(proto, tool);
+}
+
+/* The soonest m could be done if it took d as well: not before it's done
+ * with what it has, nor before it has prototyped and tooled everything.
+ * Prototyping first, the last design's tooling comes after all of the
+ * prototyping, and the first design's prototype before all the tooling.
+ */
+static double soonest(const struct search *s, const struct hb_assignment *res,
+		      unsigned int m, unsigned int d)
+{
+	const struct hb_assign_pair *a = pair_of(res, d, m), *b;
+	const unsigned int *q = s->queue + m * s->n;
+	double proto = s->busy[m * 2] + a->tproto;
+	double tool = s->busy[m * 2 + 1] + a->tprod;
+	double first = a->tproto, last = a->tprod;
+	unsigned int j;
+
+	if (s->direct)
+		return max(s->span[m], max(proto, tool));
+	for (j = 0; j < s->len[m]; j++) {
+		b = pair_of(res, q[j], m);
+		first = min(first, b->tproto);
+		last = min(last, b->tprod);
+	}
+	return max(s->span[m], max(proto + last, first + tool));
+}
+
+/* Whether placing the designs from order[k] on could beat the best so far.
+ * The span is no less than the busiest manufacturer's, the soonest any
+ * design left could be done, or the prototyping or tooling left spread
+ * evenly; a design left adds at least its least time with a manufacturer
+ * that could still take it within the best span
+ */
+static bool promising(const struct search *s,
+		      const struct hb_assignment *res, unsigned int k,
+		      double span, double total)
+{
+	double proto = s->rest[k * 2], tool = s->rest[k * 2 + 1];
+	double finish, least, t;
+	unsigned int j, d, m;
+
+	for (m = 0; m < s->m; m++) {
+		proto += s->busy[m * 2];
+		tool += s->busy[m * 2 + 1];
+	}
+	span = max(span, max(proto, tool) / s->m);
+	for (j = k; j < s->n; j++) {
+		d = s->order[j];
+		finish = least = INFINITY;
+		for (m = 0; m < s->m; m++) {
+			if (!pair_of(res, d, m)->ok)
+				continue;
+			t = soonest(s, res, m, d);
+			finish = min(finish, t);
+			if (t <= res->makespan)
+				least = min(least, pair_of(res, d, m)->days);
+		}
+		span = max(span, finish);
+		total += least;
+		if (span > res->makespan || isinf(least))
+			return false;
+	}
+	return span < res->makespan || total < res->total;
+}
+
+static void branch(struct search *s, struct hb_assignment *res,
+		   unsigned int k, double span, double total)
+{
+	unsigned int d, m, j, len, *cand = s->cand + k * s->m;
+	double t, was, *finish = s->finish + k * s->m;
+	const struct hb_assign_pair *a;
+
+	if (s->nodes >= HB_ASSIGN_NODES)
+		return;
+	s->nodes++;
+	if (k == s->n) {
+		if (s->found && (span > res->makespan ||
+				 (span == res->makespan && total >= res->total)))
+			return;
+		memcpy(res->manf, s->manf, s->n * sizeof(*res->manf));
+		res->makespan = span;
+		res->total = total;
+		s->found = true;
+		return;
+	}
+	d = s->order[k];
+	if (s->found && !promising(s, res, k, span, total))
+		return;
+
+	/* Soonest finish first */
+	for (m = 0, len = 0; m < s->m; m++) {
+		if (!pair_of(res, d, m)->ok)
+			continue;
+		enqueue(s, res, m, d);
+		finish[m] = run(s, res, m, NULL);
+		dequeue(s, m, d);
+		if (s->found && finish[m] > res->makespan)
+			continue;
+		for (j = len++; j && finish[cand[j - 1]] > finish[m]; j--)
+			cand[j] = cand[j - 1];
+		cand[j] = m;
+	}
+	for (j = 0; j < len; j++) {
+		m = cand[j];
+		a = pair_of(res, d, m);
+		t = a->days;
+		s->manf[d] = m;
+		enqueue(s, res, m, d);
+		s->busy[m * 2] += a->tproto;
+		s->busy[m * 2 + 1] += a->tprod;
+		was = s->span[m];
+		s->span[m] = finish[m];
+		branch(s, res, k + 1, max(span, finish[m]), total + t);
+		s->span[m] = was;
+		s->busy[m * 2] -= a->tproto;
+		s->busy[m * 2 + 1] -= a->tprod;
+		dequeue(s, m, d);
+	}
+}
+
+/* Designs that can only go one way go first, so their manufacturers'
+ * loads count from the start; then the longest, which are hardest to fit
+ */
+static bool before(const struct search *s, unsigned int x, unsigned int y)
+{
+	if ((s->opts[x] == 1) != (s->opts[y] == 1))
+		return s->opts[x] == 1;
+	return s->least[x] > s->least[y];
+}
+
+int hb_assign(struct hb_pool *p, const struct entities *ent,
+	      const struct tech_numbers *tn, const struct bomber *designs,
+	      unsigned int n, bool direct, struct hb_assignment *res)
+{
+	unsigned int m = ent->nmanf, np = n * m, d, e, i, j, k;
+	struct pairs x = {.ent = ent, .tn = tn, .designs = designs,
+			  .direct = direct, .res = res};
+	struct search s = {.n = n, .m = m, .direct = direct};
+	const struct hb_assign_pair *a;
+	double least[2];
+	bool *refit;
+	int rc = -ENOMEM;
+
+	memset(res, 0, sizeof(*res));
+	if (!n)
+		return -EINVAL;
+	res->n = n;
+	res->nmanf = m;
+	res->pair = calloc(np, sizeof(*res->pair));
+	res->manf = calloc(n, sizeof(*res->manf));
+	res->start = calloc(n, sizeof(*res->start));
+	res->seq = malloc(n * sizeof(*res->seq));
+	s.refit = refit = malloc(n * sizeof(*refit));
+	s.least = malloc(n * sizeof(*s.least));
+	s.opts = calloc(n, sizeof(*s.opts));
+	s.order = malloc(n * sizeof(*s.order));
+	s.rest = malloc((n + 1) * 2 * sizeof(*s.rest));
+	s.cand = malloc(np * sizeof(*s.cand));
+	s.finish = malloc(np * sizeof(*s.finish));
+	s.queue = malloc(np * sizeof(*s.queue));
+	s.len = calloc(m, sizeof(*s.len));
+	s.busy = calloc(m * 2, sizeof(*s.busy));
+	s.span = calloc(m, sizeof(*s.span));
+	s.manf = calloc(n, sizeof(*s.manf));
+	if (!res->pair || !res->manf || !res->start || !res->seq || !refit ||
+	    !s.least || !s.opts || !s.order || !s.rest || !s.cand ||
+	    !s.finish || !s.queue || !s.len || !s.busy || !s.span || !s.manf)
+		goto out;
+	rc = hb_parallel_for(p, np, 0, eval_pair, &x);
+	if (rc)
+		goto out;
+
+	for (d = 0; d < n; d++) {
+		refit[d] = designs[d].refit != REFIT_FRESH;
+		s.least[d] = INFINITY;
+		for (i = 0; i < m; i++)
+			if (pair_of(res, d, i)->ok) {
+				s.least[d] = min(s.least[d],
+						 pair_of(res, d, i)->days);
+				s.opts[d]++;
+			}
+		if (!s.opts[d]) {
+			rc = -ENOENT;
+			goto out;
+		}
+		for (j = d; j && before(&s, d, s.order[j - 1]); j--)
+			s.order[j] = s.order[j - 1];
+		s.order[j] = d;
+	}
+	s.rest[n * 2] = s.rest[n * 2 + 1] = 0;
+	for (j = n; j--; ) {
+		least[0] = least[1] = INFINITY;
+		for (i = 0; i < m; i++) {
+			a = pair_of(res, s.order[j], i);
+			if (a->ok) {
+				least[0] = min(least[0], a->tproto);
+				least[1] = min(least[1], a->tprod);
+			}
+		}
+		s.rest[j * 2] = s.rest[j * 2 + 2] + least[0];
+		s.rest[j * 2 + 1] = s.rest[j * 2 + 3] + least[1];
+	}
+	branch(&s, res, 0, 0, 0);
+	res->exact = s.nodes < HB_ASSIGN_NODES;
+	for (d = 0; d < n; d++)
+		enqueue(&s, res, res->manf[d], d);
+	/* By start, keeping each manufacturer's in turn where they tie */
+	for (i = 0, d = 0; i < m; i++) {
+		run(&s, res, i, res->start);
+		for (k = 0; k < s.len[i]; k++, d++) {
+			e = s.queue[i * n + k];
+			for (j = d; j && res->start[res->seq[j - 1]] >
+					 res->start[e]; j--)
+				res->seq[j] = res->seq[j - 1];
+			res->seq[j] = e;
+		}
+	}
+	rc = 0;
+out:
+	free(s.manf);
+	free(s.span);
+	free(s.busy);
+	free(s.len);
+	free(s.queue);
+	free(s.finish);
+	free(s.cand);
+	free(s.rest);
+	free(s.order);
+	free(s.opts);
+	free(s.least);
+	free(refit);
+	if (rc && rc != -ENOENT)
+		hb_assign_free(res);
+	return rc;
+}
+
+void hb_assign_free(struct hb_assignment *res)
+{
+	free(res->seq);
+	free(res->start);
+	free(res->manf);
+	free(res->pair);
+	res->seq = NULL;
+	res->start = NULL;
+	res->manf = NULL;
+	res->pair = NULL;
+}
@@ -0,0 +1,64 @@
+#ifndef _ASSIGN_H
+#define _ASSIGN_H
+
+/* Which manufacturer should develop each design?
+ *
+ * Much of a design's cost and development time depends on who builds it.
+ * hb_assign() evaluates every design under every manufacturer, over the
+ * pool, and then shares the designs out among the manufacturers so that
+ * the last of them reaches service as soon as possible and, among the
+ * ways of doing that, the total of their times is least.  A design's
+ * time is tproto + tprod, or max(tproto, tprod) ordered off the drawing
+ * board.  A manufacturer has a prototype slot and a tooling slot, as in
+ * hb_schedule() (see programme.h): it prototypes its designs one after
+ * another, refits first and then in the order of Johnson's rule, which
+ * gets them all done soonest, and tools each as its prototype is done
+ * (or at once, off the drawing board) while it prototypes the next.
+ * Ordered all on one day in start order, hb_schedule() has the last in
+ * service makespan days later.  A design can't go to a manufacturer
+ * under which it has errors, and a refit can only go to its own.
+ *
+ * That is scheduling on unrelated two-stage flow shops, which is NP-hard,
+ * so it is found by branch and bound.  Designs with only one place to go
+ * are placed first, then the rest longest first, each with the
+ * manufacturer that would be done with it soonest tried first.  A branch
+ * is cut once the busiest manufacturer, the soonest some design left
+ * could be done, or the prototyping or tooling left spread evenly shows
+ * it can't beat the best so far, or the least each design left could
+ * add, where there's room for it, shows it can't beat the total.  The
+ * search gives up after HB_ASSIGN_NODES placements, keeping the best it
+ * has found.
+ */
+
+#include "hbuilder.h"
+#include "pool.h"
+
+#define HB_ASSIGN_NODES	10000000
+
+struct hb_assign_pair {
+	int rc;
+	bool ok; /* can go there */
+	float tproto, tprod, cost;
+	double days; /* to service */
+};
+
+struct hb_assignment {
+	unsigned int n, nmanf;
+	struct hb_assign_pair *pair; /* [design * nmanf + manf] */
+	unsigned int *manf; /* for each design */
+	double *start; /* days until its prototype is started */
+	unsigned int *seq; /* the designs by start, each manufacturer's in turn */
+	double makespan; /* days until the last is in service */
+	double total; /* days: the sum of their times */
+	bool exact; /* false if the search gave up */
+};
+
+/* -ENOENT if some design can't go anywhere, when pair[] still says which
+ * pairs could be used
+ */
+int hb_assign(struct hb_pool *p, const struct entities *ent,
+	      const struct tech_numbers *tn, const struct bomber *designs,
+	      unsigned int n, bool direct, struct hb_assignment *res);
+void hb_assign_free(struct hb_assignment *res);
+
+#endif // _ASSIGN_H
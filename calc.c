@@ -5,7 +5,105 @@
 #include <math.h>
 #include <errno.h>
 #include "calc.h"
-#include "edit.h"
+#include "fmath.h"
+
+const char *describe_bbg(enum bb_girth girth)
+{
+	switch (girth) {
+	case BB_SMALL:
+		return "small bombs";
+	case BB_MEDIUM:
+		return "medium bombs";
+	case BB_COOKIE:
+		return "large bombs";
+	default:
+		return "error!  unknown girth";
+	}
+}
+
+const char *describe_esl(enum elec_level esl)
+{
+	switch (esl) {
+	case ESL_LOW:
+		return "low power";
+	case ESL_HIGH:
+		return "high power";
+	case ESL_STABLE:
+		return "high power, stable voltage";
+	default:
+		return "error!  unknown electric supply level";
+	}
+}
+
+const char *describe_navaid(enum nav_aid na)
+{
+	switch (na) {
+	case NA_GEE:
+		return "GEE";
+	case NA_H2S:
+		return "H₂S";
+	case NA_OBOE:
+		return "OBOE";
+	default:
+		return "error!  unknown navaid";
+	}
+}
+
+const char *describe_refit(enum refit_level refit)
+{
+	switch (refit) {
+	case REFIT_FRESH:
+		return "Clean-sheet";
+	case REFIT_MARK:
+		return "Mark";
+	case REFIT_MOD:
+		return "Mod";
+	case REFIT_DOCTRINE:
+		return "Doctrine";
+	default:
+		return "error!  unknown refit";
+	}
+}
+
+char crew_to_letter(enum crewpos c)
+{
+	switch (c) {
+	case CCLASS_P:
+		return 'P';
+	case CCLASS_N:
+		return 'N';
+	case CCLASS_B:
+		return 'B';
+	case CCLASS_W:
+		return 'W';
+	case CCLASS_E:
+		return 'E';
+	case CCLASS_G:
+		return 'G';
+	default:
+		return '?';
+	}
+}
+
+enum crewpos letter_to_crew(char c)
+{
+	switch (c) {
+	case 'P':
+		return CCLASS_P;
+	case 'N':
+		return CCLASS_N;
+	case 'B':
+		return CCLASS_B;
+	case 'W':
+		return CCLASS_W;
+	case 'E':
+		return CCLASS_E;
+	case 'G':
+		return CCLASS_G;
+	default:
+		return CREW_CLASSES;
+	}
+}
 
 void init_bomber(struct bomber *b, struct manf *m, struct engine *e)
 {
@@ -74,7 +172,7 @@ static int calc_engines(struct bomber *b)
 	if (e->mou != e->typ && e->mou->u != e->typ)
 		design_error(b, "Mounts are for wrong engine type %s!\n",
 			     e->mou->name);
-	if (!e->typ->unlocked)
+	if (!test_bit(tn->eng, e->typ->idx))
 		design_error(b, "%s not developed yet!\n", e->typ->name);
 	if (b->refit >= REFIT_MOD && e->typ != b->parent->engines.typ &&
 	    e->typ != b->parent->engines.mou)
@@ -97,15 +195,15 @@ static int calc_engines(struct bomber *b)
 	}
 	e->power_factor = e->number - (e->odd ? 0.1f : 0.0f);
 	e->vuln = e->typ->vul / 100.0f;
-	e->rely1 = 1.0f - powf(1.0f - e->typ->fai / 1000.0f, e->number);
+	e->rely1 = 1.0f - fm_powi(1.0f - e->typ->fai / 1000.0f, e->number);
 	if (e->number > 1)
 		e->rely2 = e->rely1 - e->number * (e->typ->fai / 1000.0f) *
-				      powf(1.0f - (e->typ->fai / 1000.0f),
-					   e->number - 1);
+				      fm_powi(1.0f - (e->typ->fai / 1000.0f),
+					      e->number - 1);
 	else
 		e->rely2 = e->rely1;
-	e->serv = 1.0f - powf(1.0f - (e->typ->svc / 1000.0f) * ees,
-			      e->number);
+	e->serv = 1.0f - fm_powi(1.0f - (e->typ->svc / 1000.0f) * ees,
+				 e->number);
 	e->cost = e->number * e->typ->cos * eec +
 		  e->number * max(e->typ->cos, e->mou->cos) * eec * 0.5f * tn->emc / 100.0f;
 	if (e->number > 3) {
@@ -137,6 +235,21 @@ static int gcr[GC_COUNT] = {
 	[GC_BENEATH] = 3,
 };
 
+/* Fighter attack rate from each direction falls as coverage improves */
+void gun_rate(const float *gc, float *rate)
+{
+	unsigned int j;
+
+	rate[0] = rate[1] = 0;
+	for (j = 0; j < GC_COUNT; j++) {
+		float x = gcr[j] * 3.0f / (3.0f + gc[j] * gc[j]);
+
+		if (j != GC_BENEATH)
+			rate[0] += x;
+		rate[1] += x;
+	}
+}
+
 static int calc_turrets(struct bomber *b)
 {
 	const struct tech_numbers *tn = &b->tn;
@@ -174,7 +287,7 @@ static int calc_turrets(struct bomber *b)
 		if (g->twt > m->twt)
 			design_error(b, "%s too heavy for mounts!\n",
 				     g->name);
-		if (!g->unlocked)
+		if (!test_bit(tn->gun, g->idx))
 			design_error(b, "%s not developed yet!\n", g->name);
 		if (g->slb && b->fuse.typ != FT_SLABBY)
 			design_error(b, "%s requires slab-sided fuselage!\n",
@@ -195,14 +308,7 @@ static int calc_turrets(struct bomber *b)
 	if (t->need_gunners <= fixed_gunners && b->engines.number > tn->ubl)
 		design_error(b, "The Air Ministry will not allow an unarmed bomber of this size!\n");
 	t->serv = 1.0f - t->serv;
-	t->rate[0] = t->rate[1] = 0;
-	for (j = 0; j < GC_COUNT; j++) {
-		float x = gcr[j] * 3.0f / (3.0f + t->gc[j] * t->gc[j]);
-
-		if (j != GC_BENEATH)
-			t->rate[0] += x;
-		t->rate[1] += x;
-	}
+	gun_rate(t->gc, t->rate);
 	return 0;
 }
 
@@ -272,14 +378,37 @@ void count_crew(const struct crew *c, unsigned int *v)
 		v[c->men[i].pos]++;
 }
 
+/* Kuhn's augmenting path: finds crewman i a turret he can work (op[] is
+ * a bitmask of turrets per crew class), moving others along if need be.
+ */
+static bool dual_role(const struct crew *c, const unsigned int *op,
+		      int *owner, unsigned int i, unsigned int *seen)
+{
+	unsigned int avail, j;
+
+	while ((avail = op[c->men[i].pos] & ~*seen)) {
+		j = __builtin_ctz(avail);
+		*seen |= 1u << j;
+		if (owner[j] < 0 || dual_role(c, op, owner, owner[j], seen)) {
+			owner[j] = i;
+			return true;
+		}
+	}
+	return false;
+}
+
 static int calc_crew(struct bomber *b)
 {
 	const struct tech_numbers *tn = &b->tn;
+	struct turret *fixed = b->turrets.typ[LXN_FIXED];
 	unsigned int pcount[CREW_CLASSES];
 	unsigned int count[CREW_CLASSES];
+	unsigned int op[CREW_CLASSES] = {};
 	const struct crew *pc = NULL;
 	struct crew *c = &b->crew;
-	unsigned int i, j;
+	int owner[LXN_COUNT];
+	unsigned int i, j, seen;
+	int fp = -1;
 
 	count_crew(c, count);
 	pc = &mod_ancestor(b)->crew;
@@ -295,7 +424,29 @@ static int calc_crew(struct bomber *b)
 	c->gunners = 0;
 	c->dc = 0;
 	c->bn = 0;
-	memset(b->turrets.gas, 0, sizeof(b->turrets.gas));
+	/* A pilot works the fixed guns; preferably one not starred, so
+	 * that any starred pilot stays free for another turret.
+	 */
+	for (i = 0; fixed && i < c->n; i++)
+		if (c->men[i].pos == CCLASS_P && (fp < 0 || !c->men[i].gun)) {
+			fp = i;
+			if (!c->men[i].gun)
+				break;
+		}
+	/* Which turrets each class can dual-role */
+	for (j = LXN_NOSE; j < LXN_COUNT; j++) {
+		const struct turret *t = b->turrets.typ[j];
+
+		owner[j] = -1;
+		if (!t || j == LXN_FIXED)
+			continue;
+		if (t->ocp == 1)
+			op[CCLASS_P] |= 1u << j;
+		if (t->ocn)
+			op[CCLASS_N] |= 1u << j;
+		if (t->ocb)
+			op[CCLASS_B] |= 1u << j;
+	}
 	for (i = 0; i < c->n; i++) {
 		struct crewman *m = c->men + i;
 
@@ -303,54 +454,39 @@ static int calc_crew(struct bomber *b)
 			c->bn += m->gun ? 0.75f : 1.0f;
 		if (m->pos == CCLASS_B)
 			c->bn += m->gun ? 0.45f : 0.6f;
-		if (m->pos == CCLASS_P && b->turrets.typ[LXN_FIXED] && !b->turrets.gas[LXN_FIXED]) {
-			if (b->turrets.typ[LXN_FIXED]->ocp != 2) {
+		if (i == fp) {
+			if (fixed->ocp != 2) {
 				design_warning(b, "Bad turret %s, LXN_FIXED but OCP=%d\n",
-					       b->turrets.typ[LXN_FIXED]->ident,
-					       b->turrets.typ[LXN_FIXED]->ocp);
+					       fixed->ident, fixed->ocp);
 			}
 			c->gunners++;
-			b->turrets.gas[LXN_FIXED] = true;
 		} else if (m->pos == CCLASS_G) {
 			c->gunners++;
 		} else if (m->gun) {
-			if (m->pos == CCLASS_W) {
+			switch (m->pos) {
+			case CCLASS_W:
 				c->gunners++;
-			} else if (m->pos == CCLASS_E) {
+				break;
+			case CCLASS_E:
 				design_error(b, "Engineer cannot dual-role as gunner\n");
-			} else {
-				for (j = LXN_NOSE; j < LXN_COUNT; j++) {
-					struct turret *t = b->turrets.typ[j];
-
-					if (!t)
-						continue;
-					if (b->turrets.gas[j])
-						continue;
-					switch (m->pos) {
-					case CCLASS_P:
-						if (t->ocp != 1)
-							continue;
-						break;
-					case CCLASS_N:
-						if (!t->ocn)
-							continue;
-						break;
-					case CCLASS_B:
-						if (!t->ocb)
-							continue;
-						break;
-					default: /* can't happen */
-						design_error(b, "Unknown crewpos %d at %d\n",
-							     m->pos, i + 1);
-						return -EINVAL;
-					}
+				break;
+			case CCLASS_P:
+			case CCLASS_N:
+			case CCLASS_B:
+				/* A man left out now can never be fitted in
+				 * later, so warn straight away.
+				 */
+				seen = 0;
+				if (dual_role(c, op, owner, i, &seen))
 					c->gunners++;
-					b->turrets.gas[j] = true;
-					break;
-				}
-				if (j >= LXN_COUNT)
+				else
 					design_warning(b, "No turrets found for %s to dual-role operate\n",
 						       crew_name(m->pos));
+				break;
+			default: /* can't happen */
+				design_error(b, "Unknown crewpos %d at %d\n",
+					     m->pos, i + 1);
+				return -EINVAL;
 			}
 		}
 		if (m->pos == CCLASS_E)
@@ -364,6 +500,8 @@ static int calc_crew(struct bomber *b)
 				c->bn += m->gun ? 0.15f : 0.2f;
 		}
 	}
+	for (j = LXN_NOSE; j < LXN_COUNT; j++)
+		b->turrets.gas[j] = owner[j] >= 0 || (j == LXN_FIXED && fp >= 0);
 	if (!count[CCLASS_P])
 		design_error(b, "Crew must include a pilot!\n");
 	if (!count[CCLASS_N])
@@ -536,29 +674,23 @@ static int calc_tanks(struct bomber *b)
 	return 0;
 }
 
-/* altitude in thousands ft */
+/* altitude in thousands ft; interpolates between the steps of the
+ * engine's power table
+ */
 static float engine_power(const struct engines *e, float alt)
 {
-	float ffth = 16.0f, mfth = 10.25, scp = 0.02f;
-	float msp, fsp = 0;
-
-	switch (e->scl) {
-	case 3:
-		ffth = 21.0f;
-		mfth = 12.0f;
-		scp = 0.06f;
-		/* fallthrough */
-	case 2:
-		fsp = expf(min(ffth - alt, 0.0f) / 25.1f) - scp;
-		/* fallthrough */
-	case 1:
-		msp = expf(min(mfth - alt, 0.0f) / 25.1f);
-		break;
-	default: /* bad data */
-		return 0.0f;
-	}
+	const float *p = e->typ->power;
+	float x = min(max(alt * (1e3f / POWER_STEP), 0.0f), POWER_POINTS - 1);
+	unsigned int i = min((unsigned int)x, POWER_POINTS - 2);
 
-	return e->power_factor * e->typ->bhp * max(msp, fsp);
+	return e->power_factor * e->typ->bhp *
+	       (p[i] + (p[i + 1] - p[i]) * (x - i));
+}
+
+/* at i * POWER_STEP ft */
+static float engine_power_at(const struct engines *e, unsigned int i)
+{
+	return e->power_factor * e->typ->bhp * e->typ->power[i];
 }
 
 float wing_lift(const struct wing *w, float v)
@@ -576,21 +708,18 @@ static float wing_minv(const struct wing *w, float lift, float alt)
 	return sqrt(lift * 2.0f / (w->cl * rho * w->area)) * 15.0f / 22.0f;
 }
 
-/* altitude in thousands ft */
-static float climb_rate(const struct bomber *b, float alt)
+/* power in bhp, v in mph */
+static float climb_at(const struct bomber *b, float pwr, float v)
 {
-	float v = wing_minv(&b->wing, b->gross, alt);
-	float lpwr = b->drag * v / 375.0f, pwr, cpwr;
+	float lpwr = b->drag * v / 375.0f, cpwr;
 
-	pwr = engine_power(&b->engines, alt);
 	cpwr = (pwr - lpwr) * 0.52f;
 	return cpwr * 33e3f / b->gross;
 }
 
-/* altitude in thousands ft */
-static float airspeed(const struct bomber *b, float alt)
+/* power in bhp */
+static float speed_at(const struct bomber *b, float pwr)
 {
-	float pwr = engine_power(&b->engines, alt);
 	float nwd, a, c, m;
 
 	/* drag (other than wing) scales with v², and is normalised
@@ -609,24 +738,60 @@ static float airspeed(const struct bomber *b, float alt)
 	return (m - b->wing.drag) / (2.0f * a);
 }
 
-#define ALTITUDE_STEP	200	// feet
+/* altitude in thousands ft */
+float airspeed(const struct bomber *b, float alt)
+{
+	return speed_at(b, engine_power(&b->engines, alt));
+}
+
+static float profile_alt(unsigned int i)
+{
+	return i * (ALTITUDE_STEP * 1e-3);
+}
+
+/* at i * ALTITUDE_STEP ft.  The ceiling search doesn't need the speed, so
+ * that is left to the caller.
+ */
+static void perf_point(const struct bomber *b, unsigned int i,
+		       struct perf_point *p)
+{
+	p->power = engine_power_at(&b->engines,
+				   i * (ALTITUDE_STEP / POWER_STEP));
+	p->minv = wing_minv(&b->wing, b->gross, profile_alt(i));
+	p->climb = climb_at(b, p->power, p->minv);
+}
+
+unsigned int perf_envelope(const struct bomber *b, struct perf_point *prof)
+{
+	unsigned int i;
+
+	for (i = 0; i < PROFILE_POINTS; i++) {
+		perf_point(b, i, prof + i);
+		prof[i].speed = speed_at(b, prof[i].power);
+		if (prof[i].climb <= 0.0f)
+			return i + 1;
+	}
+	return i;
+}
 
-static int calc_ceiling(struct bomber *b)
+/* Fills prof[] as far as the service ceiling, which is *top steps up */
+static int calc_ceiling(struct bomber *b, struct perf_point *prof,
+			unsigned int *top)
 {
 	const struct tech_numbers *tn = &b->tn;
 	unsigned int alt; // units of ALTITUDE_STEP ft
 	float tim = 0; // minutes
 
 	for (alt = 0; alt * ALTITUDE_STEP < 35000; alt++) {
-		float c = climb_rate(b, alt * (ALTITUDE_STEP * 1e-3));
-
-		if (c < 480.0f)
+		perf_point(b, alt, prof + alt);
+		if (prof[alt].climb < 480.0f)
 			break;
 		if (tim > tn->clt)
 			break;
-		tim += ALTITUDE_STEP / c;
+		tim += ALTITUDE_STEP / prof[alt].climb;
 	}
-	b->ceiling = alt * (ALTITUDE_STEP * 1e-3);
+	b->ceiling = profile_alt(alt);
+	*top = alt;
 	return 0;
 }
 
@@ -634,6 +799,8 @@ static int calc_perf(struct bomber *b)
 {
 	const struct tech_numbers *tn = &b->tn;
 	bool concrete = tn->rcs;
+	struct perf_point prof[PROFILE_POINTS];
+	unsigned int top, ten = 10000 / POWER_STEP;
 	int rc;
 
 	b->tare = b->core_tare + b->fuse.tare + b->tanks.tare +
@@ -671,18 +838,26 @@ static int calc_perf(struct bomber *b)
 		design_warning(b, "Gross weight too high for grass runways.\n");
 	else if (b->takeoff_spd - 0.1 > tn->rgs)
 		design_warning(b, "Take-off speed too high for grass runways.\n");
-	rc = calc_ceiling(b);
+	/* One climb from sea level gives the ceiling, and the deck
+	 * performance along the way
+	 */
+	rc = calc_ceiling(b, prof, &top);
 	if (rc)
 		return rc;
 	b->cruise_alt = min(b->ceiling, 10.0f) +
 			max(b->ceiling - 10.0f, 0) / 2.0f;
-	b->cruise_spd = airspeed(b, b->cruise_alt);
-	b->init_climb = climb_rate(b, 0.0f);
+	/* The same, in POWER_STEPs; as those are half an ALTITUDE_STEP, the
+	 * cruise altitude is always on one
+	 */
+	top *= ALTITUDE_STEP / POWER_STEP;
+	b->cruise_spd = speed_at(b, engine_power_at(&b->engines,
+			top > ten ? ten + (top - ten) / 2 : top));
+	b->init_climb = prof[0].climb;
 	if (b->init_climb < 540.0f)
 		design_error(b, "Design can barely take off!\n");
 	else if (b->init_climb < 640.0f)
 		design_warning(b, "Climb rate is very slow.\n");
-	b->deck_spd = airspeed(b, 0.0f);
+	b->deck_spd = speed_at(b, prof[0].power);
 	b->range = max(b->tanks.hours * 0.45f * b->cruise_spd - 20.0f, 0.0f);
 	if (b->range < 200.0f)
 		design_error(b, "Range is far too low!\n");
@@ -691,6 +866,24 @@ static int calc_perf(struct bomber *b)
 	return 0;
 }
 
+/* A heavier b, on the same fuel, has more drag at any power and a ceiling
+ * no higher, so cruises no faster than b would at the most power it has
+ * anywhere up to its own cruising altitude
+ */
+float range_bound(const struct bomber *b)
+{
+	unsigned int top = lroundf(b->ceiling * 1e3f / ALTITUDE_STEP) *
+			   (ALTITUDE_STEP / POWER_STEP);
+	unsigned int ten = 10000 / POWER_STEP, i;
+	float pwr = 0;
+
+	if (top > ten)
+		top = ten + (top - ten) / 2;
+	for (i = 0; i <= top; i++)
+		pwr = max(pwr, engine_power_at(&b->engines, i));
+	return max(b->tanks.hours * 0.45f * speed_at(b, pwr) - 20.0f, 0.0f);
+}
+
 static int calc_rely(struct bomber *b)
 {
 	b->serv = 1.0f - (b->engines.serv * 6.0f + b->turrets.serv +
@@ -707,7 +900,7 @@ static int calc_rely(struct bomber *b)
 static int calc_combat(struct bomber *b)
 {
 	unsigned int sch;
-	float sgf, lbb;
+	float sgf, lbb, evade;
 
 	b->roll_pen = powf(b->wing.ar, 0.8f) * 0.7f;
 	b->turn_pen = sqrt(max(b->wing.wl - b->manf->tpl, 0.0f));
@@ -726,8 +919,9 @@ static int calc_combat(struct bomber *b)
 	/* Looks backwards?  Lower is better for gunrate */
 	sgf = max((b->turrets.need_gunners + 1.0f) / (b->crew.gunners + 1.0f),
 		  1.0f);
+	evade = powf(b->evade_factor, 0.8f);
 	for (sch = 0; sch < 2; sch++) {
-		b->fight_factor[sch] = powf(b->evade_factor, 0.8f) *
+		b->fight_factor[sch] = evade *
 				       (b->vuln * 4.0f +
 					b->turrets.rate[sch] * sgf) /
 				       3.6f;
@@ -759,7 +953,7 @@ static int calc_cost(struct bomber *b)
 		       (b->engines.number > 2 ? 2.0f : 1.0f);
 	structure_cost = b->core_cost + b->bay.cost + b->fuse.cost +
 			 b->wing.cost;
-	b->stress_factor = powf(b->mtow * 0.5f / b->tare, 2);
+	b->stress_factor = fm_powi(b->mtow * 0.5f / b->tare, 2);
 	structure_cost *= b->stress_factor;
 	b->cost = b->engines.cost + b->turrets.cost + structure_cost +
 		  b->elec.cost + b->elec.ncost + b->tanks.cost;
@@ -768,14 +962,18 @@ static int calc_cost(struct bomber *b)
 
 static int calc_dev(struct bomber *b)
 {
-	float base_tproto = powf(b->overgross, 0.3f) * powf(b->cost, 0.2f);
-	float base_tprod = powf(b->overgross, 0.4f) * powf(b->cost, 0.2f);
+	float og[FM_MAX_STEPS], cost = powf(b->cost, 0.2f);
+	float et[FM_MAX_STEPS], ec, tw[FM_MAX_STEPS];
+	float base_tproto, base_tprod;
 	float add_tproto = 0.0f, add_tprod = 0.0f;
 	unsigned int pcount[CREW_CLASSES];
 	unsigned int count[CREW_CLASSES];
 	float bof = max(b->manf->bof, 1);
 	unsigned int i;
 
+	fm_pow_steps(b->overgross, 0.1f, og, 4);
+	base_tproto = og[2] * cost;
+	base_tprod = og[3] * cost;
 	count_crew(&b->crew, count);
 	switch (b->refit) {
 	case REFIT_FRESH:
@@ -790,10 +988,10 @@ static int calc_dev(struct bomber *b)
 		b->cproto = b->cost * 1.5f;
 		b->cprod = b->cost * 3.0f;
 		if (b->engines.typ != b->parent->engines.typ) {
-			add_tproto += powf(b->engines.tare, 0.6f) *
-				      powf(b->engines.cost, 0.4f) * 0.6f;
-			add_tprod += powf(b->engines.tare, 0.8f) *
-				    powf(b->engines.cost, 0.4f) * 0.32f;
+			fm_pow_steps(b->engines.tare, 0.2f, et, 4);
+			ec = powf(b->engines.cost, 0.4f);
+			add_tproto += et[2] * ec * 0.6f;
+			add_tprod += et[3] * ec * 0.32f;
 			if (b->engines.typ == b->parent->engines.mou) {
 				add_tproto *= 0.1f;
 				add_tprod *= 0.1f;
@@ -809,12 +1007,14 @@ static int calc_dev(struct bomber *b)
 
 				if (t) {
 					/* turret added or replaced */
-					add_tproto += powf(t->twt, 0.6f);
-					add_tprod += powf(t->twt, 0.8f) * 0.6f;
+					fm_pow_steps(t->twt, 0.2f, tw, 4);
+					add_tproto += tw[2];
+					add_tprod += tw[3] * 0.6f;
 				} else {
 					/* turret removed */
-					add_tproto += powf(p->twt, 0.6f) * 0.2f;
-					add_tprod += powf(p->twt, 0.8f) * 0.12f;
+					fm_pow_steps(p->twt, 0.2f, tw, 4);
+					add_tproto += tw[2] * 0.2f;
+					add_tprod += tw[3] * 0.12f;
 				}
 			}
 		count_crew(&b->parent->crew, pcount);
@@ -847,10 +1047,10 @@ static int calc_dev(struct bomber *b)
 		break;
 	case REFIT_MOD:
 		if (b->engines.typ != b->parent->engines.typ) {
-			add_tproto += powf(b->engines.tare, 0.6f) *
-				      powf(b->engines.cost, 0.4f) * 0.06f;
-			add_tprod += powf(b->engines.tare, 0.8f) *
-				    powf(b->engines.cost, 0.4f) * 0.032f;
+			fm_pow_steps(b->engines.tare, 0.2f, et, 4);
+			ec = powf(b->engines.cost, 0.4f);
+			add_tproto += et[2] * ec * 0.06f;
+			add_tprod += et[3] * ec * 0.032f;
 		}
 		if (b->engines.egg && b->parent->engines.egg) {
 			add_tproto *= 0.6f;
@@ -863,12 +1063,14 @@ static int calc_dev(struct bomber *b)
 
 				if (t) {
 					/* turret added or replaced */
-					add_tproto += powf(t->twt, 0.6f);
-					add_tprod += powf(t->twt, 0.8f) * 0.6f;
+					fm_pow_steps(t->twt, 0.2f, tw, 4);
+					add_tproto += tw[2];
+					add_tprod += tw[3] * 0.6f;
 				} else {
 					/* turret removed */
-					add_tproto += powf(p->twt, 0.6f) * 0.2f;
-					add_tprod += powf(p->twt, 0.8f) * 0.12f;
+					fm_pow_steps(p->twt, 0.2f, tw, 4);
+					add_tproto += tw[2] * 0.2f;
+					add_tprod += tw[3] * 0.12f;
 				}
 			}
 		if (b->bay.csbs && !b->parent->bay.csbs) {
@@ -898,7 +1100,7 @@ static int calc_dev(struct bomber *b)
 	return 0;
 }
 
-static int calc_refit(struct bomber *b, struct tech_numbers *tn)
+static int calc_refit(struct bomber *b, const struct tech_numbers *tn)
 {
 	size_t start;
 
@@ -930,113 +1132,232 @@ static int calc_refit(struct bomber *b, struct tech_numbers *tn)
 	return 0;
 }
 
-int calc_bomber(struct bomber *b, struct tech_numbers *tn)
+static int (*const calc_stages[CALC_STAGES])(struct bomber *b) = {
+	[CALC_ENGINES] = calc_engines,
+	[CALC_TURRETS] = calc_turrets,
+	[CALC_WING] = calc_wing,
+	[CALC_CREW] = calc_crew,
+	[CALC_BOMBBAY] = calc_bombbay,
+	[CALC_FUSELAGE] = calc_fuselage,
+	[CALC_ELECTRICS] = calc_electrics,
+	[CALC_TANKS] = calc_tanks,
+	[CALC_PERF] = calc_perf,
+	[CALC_RELY] = calc_rely,
+	[CALC_COMBAT] = calc_combat,
+	[CALC_COST] = calc_cost,
+	[CALC_DEV] = calc_dev,
+};
+
+int calc_bomber_from(struct bomber *b, const struct tech_numbers *tn,
+		     enum calc_stage from)
 {
+	unsigned int i;
 	int rc;
 
-	/* clear old errors and warnings */
-	b->error = false;
-	b->new = 0;
-
-	rc = calc_refit(b, tn);
-	if (rc)
-		return rc;
-
-	rc = calc_engines(b);
-	if (rc)
-		return rc;
-
-	rc = calc_turrets(b);
-	if (rc)
-		return rc;
-
-	rc = calc_wing(b);
-	if (rc)
-		return rc;
-
-	rc = calc_crew(b);
-	if (rc)
-		return rc;
+	/* Nothing to re-run */
+	if (from >= CALC_STAGES && b->stages_done == CALC_STAGES)
+		return 0;
+	if (from > b->stages_done)
+		from = CALC_REFIT;
+	/* A lone error may have overwritten an earlier stage's warning */
+	if (b->stage_new[from] >= MAX_EW && !b->stage_error[from])
+		from = CALC_REFIT;
+	if (from == CALC_REFIT) {
+		/* clear old errors and warnings */
+		b->error = false;
+		b->new = 0;
+	} else {
+		b->error = b->stage_error[from];
+		b->new = b->stage_new[from];
+	}
 
-	rc = calc_bombbay(b);
-	if (rc)
-		return rc;
+	for (i = from; i < CALC_STAGES; i++) {
+		b->stages_done = i;
+		b->stage_new[i] = b->new;
+		b->stage_error[i] = b->error;
+		if (i == CALC_REFIT)
+			rc = calc_refit(b, tn);
+		else
+			rc = calc_stages[i](b);
+		if (rc)
+			return rc;
+	}
+	b->stages_done = CALC_STAGES;
+	return 0;
+}
 
-	rc = calc_fuselage(b);
-	if (rc)
-		return rc;
+int calc_bomber(struct bomber *b, const struct tech_numbers *tn)
+{
+	return calc_bomber_from(b, tn, CALC_REFIT);
+}
 
-	rc = calc_electrics(b);
-	if (rc)
-		return rc;
+#define TN_READ(f, stage)	{offsetof(struct tech_numbers, f),	\
+				 sizeof(((struct tech_numbers *)0)->f), stage}
+
+/* Which stage first reads each tech number */
+static const struct {
+	size_t off, len;
+	enum calc_stage stage;
+} tn_readers[] = {
+	TN_READ(fwt, CALC_PERF),
+	TN_READ(wts, CALC_WING),
+	TN_READ(wtc, CALC_WING),
+	TN_READ(wtf, CALC_WING),
+	TN_READ(wcf, CALC_WING),
+	TN_READ(etf, CALC_PERF),
+	TN_READ(bt, CALC_BOMBBAY),
+	TN_READ(bbb, CALC_BOMBBAY),
+	TN_READ(bbf, CALC_BOMBBAY),
+	TN_READ(ubl, CALC_TURRETS),
+	TN_READ(ft, CALC_FUSELAGE),
+	TN_READ(fd, CALC_PERF),
+	TN_READ(fs, CALC_FUSELAGE),
+	TN_READ(ff, CALC_FUSELAGE),
+	TN_READ(fv, CALC_FUSELAGE),
+	TN_READ(cc, CALC_COST),
+	TN_READ(fc, CALC_FUSELAGE),
+	TN_READ(wld, CALC_WING),
+	TN_READ(g4t, CALC_ENGINES),
+	TN_READ(g4c, CALC_ENGINES),
+	TN_READ(fut, CALC_TANKS),
+	TN_READ(fuv, CALC_TANKS),
+	TN_READ(fuc, CALC_TANKS),
+	TN_READ(fgv, CALC_TANKS),
+	TN_READ(edf, CALC_ENGINES),
+	TN_READ(emc, CALC_ENGINES),
+	TN_READ(ees, CALC_ENGINES),
+	TN_READ(eet, CALC_ENGINES),
+	TN_READ(eec, CALC_ENGINES),
+	TN_READ(gtf, CALC_TURRETS),
+	TN_READ(gdf, CALC_TURRETS),
+	TN_READ(gcf, CALC_TURRETS),
+	TN_READ(esl, CALC_ELECTRICS),
+	TN_READ(sft, CALC_TANKS),
+	TN_READ(sfv, CALC_TANKS),
+	TN_READ(sfc, CALC_TANKS),
+	TN_READ(cmi, CALC_CREW),
+	TN_READ(ces, CALC_CREW),
+	TN_READ(ccc, CALC_CREW),
+	TN_READ(gam, CALC_TURRETS),
+	TN_READ(gac, CALC_TURRETS),
+	TN_READ(csb, CALC_BOMBBAY),
+	TN_READ(na, CALC_ELECTRICS),
+	TN_READ(clt, CALC_PERF),
+	TN_READ(bmc, CALC_BOMBBAY),
+	TN_READ(rgs, CALC_PERF),
+	TN_READ(rgg, CALC_PERF),
+	TN_READ(rcs, CALC_PERF),
+	TN_READ(rcg, CALC_PERF),
+	TN_READ(eng, CALC_ENGINES),
+	TN_READ(gun, CALC_TURRETS),
+};
 
-	rc = calc_tanks(b);
-	if (rc)
-		return rc;
+enum calc_stage calc_tn_stage(const struct tech_numbers *a,
+			      const struct tech_numbers *b)
+{
+	enum calc_stage from = CALC_STAGES;
+	unsigned int i;
 
-	rc = calc_perf(b);
-	if (rc)
-		return rc;
+	for (i = 0; i < ARRAY_SIZE(tn_readers); i++)
+		if (tn_readers[i].stage < from &&
+		    memcmp((const char *)a + tn_readers[i].off,
+			   (const char *)b + tn_readers[i].off,
+			   tn_readers[i].len))
+			from = tn_readers[i].stage;
+	return from;
+}
 
-	rc = calc_rely(b);
-	if (rc)
-		return rc;
+int calc_bomber_retech(struct bomber *b, const struct tech_numbers *tn,
+		       enum calc_stage from)
+{
+	/* calc_refit() is cheap, but picks out which of tn a refit sees */
+	if (from == CALC_REFIT || b->stages_done < CALC_STAGES ||
+	    calc_refit(b, tn))
+		return calc_bomber(b, tn);
+	return calc_bomber_from(b, tn, from);
+}
 
-	rc = calc_combat(b);
-	if (rc)
-		return rc;
+/* SplitMix64, used as a counter-based generator: the idx'th number for a
+ * key is just a hash of the two, so any roll can be replayed on its own,
+ * and any number of threads can roll without sharing state.
+ */
+unsigned long long dice_roll(unsigned long long key, unsigned long long idx)
+{
+	unsigned long long z = key + (idx + 1) * 0x9e3779b97f4a7c15ull;
 
-	rc = calc_cost(b);
-	if (rc)
-		return rc;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
 
-	rc = calc_dev(b);
-	if (rc)
-		return rc;
+unsigned long long dice_bound(double p)
+{
+	return min(max(p, 0.0), 1.0) * 4294967296.0;
+}
 
-	return 0;
+static int irandu(unsigned long long key, unsigned int idx, int n)
+{
+	if (!n)
+		return 0;
+	return ((dice_roll(key, idx) >> 32) * n) >> 32;
 }
 
-/* Copied from Harris rand.c */
-static int irandu(int n)
+/* Each roll adds -n..n to a die (after zeroing it, for a clean sheet) */
+const int die_spread[REFIT_LEVELS][DIE_COUNT] = {
+	[REFIT_FRESH] = {5, 4, 10, 5, 4},
+	[REFIT_MARK] = {2, 3, 5, 2, 1},
+	[REFIT_MOD] = {[DIE_SERV] = 2, [DIE_VULN] = 2},
+};
+/* ...and the result is clamped to -limit..limit */
+const int die_limit[DIE_COUNT] = {5, 4, 10, 5, 4};
+
+int *die_value(struct randomisation *r, enum die d)
 {
-	if(!n) return(0);
-	// This is poor quality randomness, but that doesn't really matter here
-	return(rand()%n);
+	switch (d) {
+	case DIE_DRAG:
+		return &r->drag;
+	case DIE_SERV:
+		return &r->serv;
+	case DIE_VULN:
+		return &r->vuln;
+	case DIE_MANU:
+		return &r->manu;
+	case DIE_ACCU:
+		return &r->accu;
+	default: /* can't happen */
+		return NULL;
+	}
 }
 
-/* Sets the random factors, to be picked up by subsequent recalcs */
-int do_randomise(struct bomber *b)
+/* Sets the random factors, to be picked up by subsequent recalcs.  The
+ * rolls depend only on b->dice.seed, so rolling again replays them.
+ */
+int do_randomise(struct bomber *b, unsigned int *seed)
 {
-	switch (b->refit) {
-	case REFIT_FRESH:
-		b->dice.drag = irandu(11) - 5;
-		b->dice.serv = irandu(9) - 4;
-		b->dice.vuln = irandu(21) - 10;
-		b->dice.manu = irandu(11) - 5;
-		b->dice.accu = irandu(9) - 4;
-		break;
-	case REFIT_MARK:
-		b->dice.drag += irandu(5) - 2;
-		b->dice.serv += irandu(7) - 3;
-		b->dice.vuln += irandu(11) - 5;
-		b->dice.manu += irandu(5) - 2;
-		b->dice.accu += irandu(3) - 1;
-		break;
-	case REFIT_MOD:
-		b->dice.serv += irandu(5) - 2;
-		b->dice.vuln += irandu(5) - 2;
-		break;
-	default:
-		break;
+	enum die d;
+
+	if (b->refit >= REFIT_LEVELS)
+		return -EINVAL;
+	/* A design without a key of its own draws one from the caller.  The
+	 * caller's seed steps by an odd constant, so it takes all 2^32 values
+	 * before it repeats; being far from 1, the step also keeps pool
+	 * workers, seeded seed + i, from replaying each other's keys.
+	 */
+	if (!b->dice.seed) {
+		b->dice.seed = dice_roll(*seed, 0) | 1;
+		*seed += 0x9e3779b9u;
+	}
+	for (d = 0; d < DIE_COUNT; d++) {
+		int *v = die_value(&b->dice, d);
+		int n = die_spread[b->refit][d];
+
+		if (b->refit == REFIT_FRESH)
+			*v = 0;
+		if (n)
+			*v += irandu(b->dice.seed, b->refit * DIE_COUNT + d,
+				     n * 2 + 1) - n;
+		*v = min(max(*v, -die_limit[d]), die_limit[d]);
 	}
-	#define CLAMP(f, v)	b->dice.f = min(max(b->dice.f, -v), v)
-	CLAMP(drag, 5);
-	CLAMP(serv, 4);
-	CLAMP(vuln, 10);
-	CLAMP(manu, 5);
-	CLAMP(accu, 4);
-	#undef CLAMP
 	b->dice.rolled = true;
 	return 0;
 }
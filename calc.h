@@ -163,10 +163,46 @@ struct randomisation {
 	int vuln;
 	int manu;
 	int accu;
+	unsigned long long seed; /* keys the rolls; 0 if not yet chosen */
 };
 
 #define MAX_EW	16
 #define EW_LEN	80
+/* calc_bomber() stages, in order; each reads only inputs and the outputs of
+ * earlier stages.
+ */
+enum calc_stage {
+	CALC_REFIT,
+	CALC_ENGINES,
+	CALC_TURRETS,
+	CALC_WING,
+	CALC_CREW,
+	CALC_BOMBBAY,
+	CALC_FUSELAGE,
+	CALC_ELECTRICS,
+	CALC_TANKS,
+	CALC_PERF,
+	CALC_RELY,
+	CALC_COMBAT,
+	CALC_COST,
+	CALC_DEV,
+
+	CALC_STAGES
+};
+
+#define ALTITUDE_STEP	200	// feet, two POWER_STEPs
+#define PROFILE_POINTS	(35000 / ALTITUDE_STEP + 1)
+
+/* Fully-laden performance at one altitude; a profile has one of these
+ * every ALTITUDE_STEP ft from sea level
+ */
+struct perf_point {
+	float power; /* bhp */
+	float minv; /* mph, minimum flying speed */
+	float climb; /* fpm */
+	float speed; /* mph, maximum */
+};
+
 struct bomber {
 	/* Inputs */
 	const struct bomber *parent;
@@ -186,6 +222,12 @@ struct bomber {
 	bool error;
 	unsigned int new;
 	char ew[MAX_EW][EW_LEN];
+	/* Errors and warnings so far as each stage began, and how many
+	 * stages last ran to completion; for calc_bomber_from()
+	 */
+	unsigned int stages_done;
+	unsigned int stage_new[CALC_STAGES];
+	bool stage_error[CALC_STAGES];
 	float serv;
 	float fail;
 	float core_tare;
@@ -216,12 +258,68 @@ struct bomber {
 	float cprod;
 };
 
+const char *describe_bbg(enum bb_girth girth);
+const char *describe_esl(enum elec_level esl);
+const char *describe_navaid(enum nav_aid na);
+const char *describe_refit(enum refit_level refit);
+char crew_to_letter(enum crewpos c);
+enum crewpos letter_to_crew(char c);
+
 const struct bomber *mod_ancestor(const struct bomber *b);
 void count_crew(const struct crew *c, unsigned int *v);
 
 void init_bomber(struct bomber *b, struct manf *m, struct engine *e);
-int calc_bomber(struct bomber *b, struct tech_numbers *tn);
-int do_randomise(struct bomber *b);
+int calc_bomber(struct bomber *b, const struct tech_numbers *tn);
+/* Re-runs the stages from 'from' onwards, after a change to inputs that
+ * only those stages read.  tn is only used if that means starting over
+ * (as it does if the last calculation stopped short of 'from').  With
+ * from == CALC_STAGES, a design that last ran to completion is left as
+ * it is.
+ */
+int calc_bomber_from(struct bomber *b, const struct tech_numbers *tn,
+		     enum calc_stage from);
+/* The first stage that reads a word in which a and b differ, or
+ * CALC_STAGES if no stage does
+ */
+enum calc_stage calc_tn_stage(const struct tech_numbers *a,
+			      const struct tech_numbers *b);
+/* Re-evaluates b under a new tech state tn, which differs from the last
+ * one only in words read by the stages from 'from' onwards
+ */
+int calc_bomber_retech(struct bomber *b, const struct tech_numbers *tn,
+		       enum calc_stage from);
+/* Rolls b's dice, keyed by b->dice.seed; if that is 0, picks a new key
+ * using (and updating) *seed.
+ */
+int do_randomise(struct bomber *b, unsigned int *seed);
+unsigned long long dice_roll(unsigned long long key, unsigned long long idx);
+/* A probability as a bound on 32 bits of a roll, which pass if below it */
+unsigned long long dice_bound(double p);
+/* The dice, in the order do_randomise() rolls them */
+enum die {
+	DIE_DRAG,
+	DIE_SERV,
+	DIE_VULN,
+	DIE_MANU,
+	DIE_ACCU,
+
+	DIE_COUNT
+};
+extern const int die_spread[REFIT_LEVELS][DIE_COUNT];
+extern const int die_limit[DIE_COUNT];
+int *die_value(struct randomisation *r, enum die d);
+/* rate[2] from gc[GC_COUNT], as turrets.rate[] from turrets.gc[] */
+void gun_rate(const float *gc, float *rate);
 
 float wing_lift(const struct wing *w, float v);
+/* altitude in thousands ft; needs calc_bomber() to have run */
+float airspeed(const struct bomber *b, float alt);
+/* The most range b could have with the same fuel and more load; needs
+ * calc_bomber() to have run
+ */
+float range_bound(const struct bomber *b);
+/* Fills in b's profile up to its absolute ceiling (or 35,000ft), and
+ * returns the number of points; needs calc_bomber() to have run
+ */
+unsigned int perf_envelope(const struct bomber *b, struct perf_point *prof);
 #endif // _CALC_H
@@ -0,0 +1,252 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "crews.h"
+
+/* What the crew stage sees of the rest of the design */
+struct crew_ctx {
+	unsigned char op[LXN_COUNT]; /* OP_* bits per location */
+	unsigned char esl;
+};
+
+#define OP_FITTED	1
+#define OP_P		2 /* ocp == 1: a starred pilot can work it */
+#define OP_FIXED	4 /* ocp == 2: the pilot works it anyway */
+#define OP_N		8
+#define OP_B		16
+
+struct hb_crews {
+	struct bomber base;
+	const struct tech_numbers *tn;
+	struct crew_ctx ctx;
+	unsigned int n, cap;
+	struct hb_crew_result *res;
+	/* Open-addressed index into res[], by key */
+	unsigned int hmask;
+	unsigned int *hash; /* i + 1, or 0 for empty */
+};
+
+bool hb_crew_key(const struct crew *c, struct hb_crew_key *k)
+{
+	unsigned int i;
+
+	memset(k, 0, sizeof(*k));
+	if (c->n > MAX_CREW)
+		return false;
+	for (i = 0; i < c->n; i++) {
+		const struct crewman *m = c->men + i;
+
+		if (m->pos >= CREW_CLASSES || (m->gun && m->pos == CCLASS_E))
+			return false;
+		k->n[m->pos]++;
+		if (m->gun && m->pos != CCLASS_G)
+			k->gun[m->pos]++;
+	}
+	return true;
+}
+
+void hb_crew_apply(const struct hb_crew_key *k, struct crew *c)
+{
+	unsigned int i, j;
+
+	c->n = 0;
+	for (i = 0; i < CREW_CLASSES; i++)
+		for (j = 0; j < k->n[i]; j++)
+			c->men[c->n++] = (struct crewman){
+				.pos = i,
+				.gun = j < k->gun[i],
+			};
+}
+
+void hb_crew_format(const struct hb_crew_key *k, char *buf, size_t len)
+{
+	struct crew c;
+	unsigned int i;
+	size_t o = 0;
+
+	hb_crew_apply(k, &c);
+	for (i = 0; i < c.n && o + 3 < len; i++) {
+		buf[o++] = crew_to_letter(c.men[i].pos);
+		if (c.men[i].gun)
+			buf[o++] = '*';
+	}
+	if (len)
+		buf[o] = 0;
+}
+
+static void crew_ctx(const struct bomber *b, struct crew_ctx *x)
+{
+	unsigned int i;
+
+	memset(x, 0, sizeof(*x));
+	for (i = LXN_NOSE; i < LXN_COUNT; i++) {
+		const struct turret *t = b->turrets.typ[i];
+
+		if (!t)
+			continue;
+		x->op[i] = OP_FITTED | (t->ocp == 1 ? OP_P : 0) |
+			   (t->ocp == 2 ? OP_FIXED : 0) |
+			   (t->ocn ? OP_N : 0) | (t->ocb ? OP_B : 0);
+	}
+	x->esl = b->elec.esl;
+}
+
+static unsigned int key_hash(const struct hb_crew_key *k)
+{
+	const unsigned char *p = (const unsigned char *)k;
+	unsigned int h = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < sizeof(*k); i++)
+		h = (h ^ p[i]) * 16777619u;
+	return h;
+}
+
+static int add(struct hb_crews *m, const struct hb_crew_key *k)
+{
+	if (m->n == m->cap) {
+		unsigned int cap = m->cap ? m->cap * 2 : 1024;
+		void *res = realloc(m->res, cap * sizeof(*m->res));
+
+		if (!res)
+			return -ENOMEM;
+		m->res = res;
+		m->cap = cap;
+	}
+	memset(m->res + m->n, 0, sizeof(*m->res));
+	m->res[m->n++].key = *k;
+	return 0;
+}
+
+/* All compositions of classes c onwards, with up to left more men */
+static int enumerate(struct hb_crews *m, struct hb_crew_key *k,
+		     unsigned int c, unsigned int left)
+{
+	unsigned int n, g;
+	int rc;
+
+	if (c == CREW_CLASSES)
+		return add(m, k);
+	/* A pilot and a navigator are compulsory */
+	for (n = c == CCLASS_P || c == CCLASS_N; n <= left; n++) {
+		if (c == CCLASS_P && left - n < 1)
+			break;
+		k->n[c] = n;
+		/* Engineers cannot be starred; for gunners it means nothing */
+		for (g = 0; g <= (c == CCLASS_E || c == CCLASS_G ? 0 : n); g++) {
+			k->gun[c] = g;
+			rc = enumerate(m, k, c + 1, left - n);
+			if (rc)
+				return rc;
+		}
+	}
+	k->n[c] = k->gun[c] = 0;
+	return 0;
+}
+
+static int build_index(struct hb_crews *m)
+{
+	unsigned int size = 1, i, h;
+
+	while (size < m->n * 2)
+		size <<= 1;
+	m->hash = calloc(size, sizeof(*m->hash));
+	if (!m->hash)
+		return -ENOMEM;
+	m->hmask = size - 1;
+	for (i = 0; i < m->n; i++) {
+		h = key_hash(&m->res[i].key) & m->hmask;
+		while (m->hash[h])
+			h = (h + 1) & m->hmask;
+		m->hash[h] = i + 1;
+	}
+	return 0;
+}
+
+int hb_crews_create(const struct bomber *b, const struct tech_numbers *tn,
+		    unsigned int max_crew, struct hb_crews **mp)
+{
+	struct hb_crew_key k = {};
+	struct hb_crews *m;
+	int rc;
+
+	if (max_crew > MAX_CREW)
+		return -EINVAL;
+	m = calloc(1, sizeof(*m));
+	if (!m)
+		return -ENOMEM;
+	m->base = *b;
+	m->tn = tn;
+	/* Everything up to the crew stage is the same for all of them */
+	rc = calc_bomber(&m->base, tn);
+	if (!rc)
+		rc = enumerate(m, &k, 0, max_crew);
+	if (!rc)
+		rc = build_index(m);
+	if (rc) {
+		hb_crews_destroy(m);
+		return rc;
+	}
+	crew_ctx(&m->base, &m->ctx);
+	*mp = m;
+	return 0;
+}
+
+void hb_crews_destroy(struct hb_crews *m)
+{
+	free(m->hash);
+	free(m->res);
+	free(m);
+}
+
+static int eval_one(void *ctx, struct hb_worker *w, unsigned long i)
+{
+	struct hb_crews *m = ctx;
+	struct hb_crew_result *r = m->res + i;
+	struct bomber *b = &w->b;
+
+	*b = m->base;
+	hb_crew_apply(&r->key, &b->crew);
+	r->rc = calc_bomber_from(b, m->tn, CALC_CREW);
+	if (r->rc)
+		return 0;
+	r->error = b->error;
+	r->accu = b->accu;
+	r->vuln = b->vuln;
+	r->fail = b->fail;
+	r->defn[0] = b->defn[0];
+	r->defn[1] = b->defn[1];
+	return 0;
+}
+
+int hb_crews_fill(struct hb_pool *p, struct hb_crews *m)
+{
+	return hb_parallel_for(p, m->n, 0, eval_one, m);
+}
+
+unsigned int hb_crews_size(const struct hb_crews *m)
+{
+	return m->n;
+}
+
+const struct hb_crew_result *hb_crews_get(const struct hb_crews *m,
+					  unsigned int i)
+{
+	return m->res + i;
+}
+
+const struct hb_crew_result *hb_crews_find(const struct hb_crews *m,
+					   const struct bomber *b)
+{
+	struct hb_crew_key k;
+	struct crew_ctx x;
+	unsigned int h;
+
+	crew_ctx(b, &x);
+	if (memcmp(&x, &m->ctx, sizeof(x)) || !hb_crew_key(&b->crew, &k))
+		return NULL;
+	for (h = key_hash(&k) & m->hmask; m->hash[h]; h = (h + 1) & m->hmask)
+		if (!memcmp(&m->res[m->hash[h] - 1].key, &k, sizeof(k)))
+			return m->res + m->hash[h] - 1;
+	return NULL;
+}
@@ -0,0 +1,58 @@
+#ifndef _CREWS_H
+#define _CREWS_H
+
+/* Crew composition survey.
+ *
+ * For a given airframe and turret set, the crew stage (calc_crew()) sees
+ * only how many men there are of each class, how many of them are starred
+ * (dual-role gunners), which turrets each class can operate, and the
+ * electrics level.  A struct hb_crews enumerates every such composition up
+ * to a crew size, evaluates each once (re-running only the crew stage and
+ * what follows it), and keeps the results keyed on the composition, so
+ * that any crew list for the airframe can be looked up directly.
+ */
+
+#include "hbuilder.h"
+#include "pool.h"
+
+struct hb_crew_key {
+	unsigned char n[CREW_CLASSES]; /* men of each class */
+	unsigned char gun[CREW_CLASSES]; /* how many of them starred */
+};
+
+struct hb_crew_result {
+	struct hb_crew_key key;
+	int rc;
+	bool error;
+	float accu, vuln, fail, defn[2];
+};
+
+struct hb_crews;
+
+/* Reduces a crew list to its key; returns false if it can't be one (an
+ * engineer is starred, or there are too many men).
+ */
+bool hb_crew_key(const struct crew *c, struct hb_crew_key *k);
+/* A crew list with the key's composition */
+void hb_crew_apply(const struct hb_crew_key *k, struct crew *c);
+/* Writes the key as in a save file, e.g. "PN*B*WG" */
+void hb_crew_format(const struct hb_crew_key *k, char *buf, size_t len);
+
+/* b is the airframe; its own crew is ignored, and it is not changed.
+ * Every crew of 2 to max_crew men with a pilot and a navigator is listed.
+ */
+int hb_crews_create(const struct bomber *b, const struct tech_numbers *tn,
+		    unsigned int max_crew, struct hb_crews **m);
+void hb_crews_destroy(struct hb_crews *m);
+/* Evaluates every composition, in parallel */
+int hb_crews_fill(struct hb_pool *p, struct hb_crews *m);
+unsigned int hb_crews_size(const struct hb_crews *m);
+const struct hb_crew_result *hb_crews_get(const struct hb_crews *m,
+					  unsigned int i);
+/* NULL if c is not among the compositions, or its turrets or electrics
+ * differ from the airframe's in a way that matters to the crew stage.
+ */
+const struct hb_crew_result *hb_crews_find(const struct hb_crews *m,
+					   const struct bomber *b);
+
+#endif // _CREWS_H
@@ -7,6 +7,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <stdio.h>
+#include <math.h>
 #include "data.h"
 #include "parse.h"
 
@@ -80,9 +81,9 @@ out:
 	return rc;
 }
 
-int load_guns(struct list_head *head)
+int load_guns(int dirfd, struct list_head *head)
 {
-	int fd = open("guns", O_RDONLY), rc;
+	int fd = openat(dirfd, "guns", O_RDONLY), rc;
 
 	if (fd < 0)
 		return -errno;
@@ -105,22 +106,34 @@ int free_guns(struct list_head *head)
 	return 0;
 }
 
+/* The keys setting the power curve, whose defaults depend on SCL */
+static const char *const curve_keys[] = {"FT1", "FT2", "FL2"};
+
 struct engine_loader {
 	struct engine *eng;
 	struct list_head *engines;
+	unsigned int given; /* bit i: curve_keys[i] was set */
 };
 
 static int load_engine_word(const char *key, const char *value, void *data)
 {
 	struct engine_loader *loader = data;
 	struct engine *eng = loader->eng;
+	unsigned int i;
 
+	/* As 0 is a value they can be given, note which are */
+	for (i = 0; i < ARRAY_SIZE(curve_keys); i++)
+		if (!strcmp(key, curve_keys[i]))
+			loader->given |= 1u << i;
 	INT_KEY(eng, "BHP", bhp);
 	INT_KEY(eng, "VUL", vul);
 	INT_KEY(eng, "FAI", fai);
 	INT_KEY(eng, "SVC", svc);
 	INT_KEY(eng, "COS", cos);
 	INT_KEY(eng, "SCL", scl);
+	INT_KEY(eng, "FT1", ft1);
+	INT_KEY(eng, "FT2", ft2);
+	INT_KEY(eng, "FL2", fl2);
 	INT_KEY(eng, "TWT", twt);
 	INT_KEY(eng, "DRG", drg);
 	if (!strcmp(key, "m")) {
@@ -158,6 +171,43 @@ static int load_engine_word(const char *key, const char *value, void *data)
 	return -EINVAL;
 }
 
+/* Each gear gives full power up to its full-throttle height, falling off
+ * with air density above it; the engine runs in whichever gear gives more.
+ * given says which of curve_keys[] the entry set.
+ */
+static int engine_curve(struct engine *eng, unsigned int given)
+{
+	/* ft1, ft2, fl2 by SCL: single-speed, two-speed, two-stage */
+	static const unsigned int scl_curve[4][3] = {
+		[1] = {10250, 0, 0},
+		[2] = {10250, 16000, 20},
+		[3] = {12000, 21000, 60},
+	};
+	const unsigned int *d = scl_curve[eng->scl < 4 ? eng->scl : 0];
+	unsigned int *v[] = {&eng->ft1, &eng->ft2, &eng->fl2};
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(v); i++)
+		if (!(given & 1u << i))
+			*v[i] = d[i];
+	if (!(given & 1u) && !d[0]) {
+		fprintf(stderr, "engine_curve: %s has no FT1 and SCL %u\n",
+			eng->ident, eng->scl);
+		return -EINVAL;
+	}
+	for (i = 0; i < POWER_POINTS; i++) {
+		float alt = i * (POWER_STEP * 1e-3); /* thousands ft */
+		float p = expf(fminf(eng->ft1 / 1000.0f - alt, 0.0f) / 25.1f);
+
+		if (eng->ft2)
+			p = fmaxf(p, expf(fminf(eng->ft2 / 1000.0f - alt,
+						0.0f) / 25.1f) -
+				     eng->fl2 / 1000.0f);
+		eng->power[i] = p;
+	}
+	return 0;
+}
+
 static int load_engine(const char *line, void *data)
 {
 	struct engine *eng = calloc(1, sizeof(*eng));
@@ -174,7 +224,10 @@ static int load_engine(const char *line, void *data)
 	eng->ident[4] = 0;
 	loader.eng = eng;
 	loader.engines = head;
+	loader.given = 0;
 	rc = for_each_word(line + 5, load_engine_word, &loader);
+	if (!rc)
+		rc = engine_curve(eng, loader.given);
 out:
 	if (rc) {
 		fprintf(stderr, "load_engine: failed to load %s\n", eng->ident);
@@ -188,9 +241,9 @@ out:
 	return rc;
 }
 
-int load_engines(struct list_head *head)
+int load_engines(int dirfd, struct list_head *head)
 {
-	int fd = open("eng", O_RDONLY), rc;
+	int fd = openat(dirfd, "eng", O_RDONLY), rc;
 
 	if (fd < 0)
 		return -errno;
@@ -315,9 +368,9 @@ out:
 	return rc;
 }
 
-int load_manfs(struct list_head *head)
+int load_manfs(int dirfd, struct list_head *head)
 {
-	int fd = open("manu", O_RDONLY), rc;
+	int fd = openat(dirfd, "manu", O_RDONLY), rc;
 	struct manf_loader loader;
 
 	if (fd < 0)
@@ -545,10 +598,10 @@ out:
 	return rc;
 }
 
-int load_techs(struct list_head *head, struct list_head *engines,
+int load_techs(int dirfd, struct list_head *head, struct list_head *engines,
 	       struct list_head *guns)
 {
-	int fd = open("tech", O_RDONLY), rc;
+	int fd = openat(dirfd, "tech", O_RDONLY), rc;
 	struct tech_loader loader;
 
 	loader.head = head;
@@ -599,6 +652,10 @@ int populate_entities(struct entities *ent, struct list_head *guns,
 		ent->nmanf++;
 	list_for_each_entry(tech, techs)
 		ent->ntech++;
+	/* Unlocks are tracked in fixed-size bitsets in struct tech_numbers */
+	if (ent->ngun > MAX_GUNS || ent->neng > MAX_ENGINES ||
+	    ent->ntech > MAX_TECHS)
+		return -ENOBUFS;
 	/* Allocate the arrays of pointers */
 	ent->gun = calloc(ent->ngun, sizeof(gun));
 	if (!ent->gun)
@@ -614,56 +671,118 @@ int populate_entities(struct entities *ent, struct list_head *guns,
 		return -errno;
 	/* Fill in the arrays */
 	i = 0;
-	list_for_each_entry(gun, guns)
+	list_for_each_entry(gun, guns) {
+		gun->idx = i;
 		ent->gun[i++] = gun;
+	}
 	i = 0;
-	list_for_each_entry(eng, engines)
+	list_for_each_entry(eng, engines) {
+		eng->idx = i;
 		ent->eng[i++] = eng;
+	}
 	i = 0;
-	list_for_each_entry(manf, manfs)
+	list_for_each_entry(manf, manfs) {
+		manf->idx = i;
 		ent->manf[i++] = manf;
+	}
 	i = 0;
-	list_for_each_entry(tech, techs)
+	list_for_each_entry(tech, techs) {
+		tech->idx = i;
 		ent->tech[i++] = tech;
+	}
 	return 0;
 }
 
+void free_entities(struct entities *ent)
+{
+	free(ent->gun);
+	free(ent->eng);
+	free(ent->manf);
+	free(ent->tech);
+	memset(ent, 0, sizeof(*ent));
+}
+
+bool tech_have_reqs(const struct tech *tech, const struct tech_numbers *tn)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(tech->req); i++)
+		if (tech->req[i] && !test_bit(tn->tech, tech->req[i]->idx))
+			return false;
+	return true;
+}
+
+/* Adds tech j to a state computed by apply_techs(), touching only the
+ * words tech j sets; as there, a word comes from the highest-numbered
+ * researched tech that sets it.  Returns the number of words changed.
+ */
+int add_tech(const struct entities *ent, struct tech_numbers *tn,
+	     unsigned int j)
+{
+	unsigned int *q = (unsigned int *)tn, i, k;
+	const unsigned int *p;
+	const struct tech *tech;
+	int changed = 0;
+
+	if (j >= ent->ntech)
+		return -EINVAL;
+	tech = ent->tech[j];
+	p = (const unsigned int *)&tech->num;
+	set_bit(tn->tech, j);
+	for (i = 0; i * sizeof(*p) < offsetof(struct tech_numbers, unlock_block); i++) {
+		if (!p[i] || q[i] == p[i])
+			continue;
+		for (k = j + 1; k < ent->ntech; k++)
+			if (test_bit(tn->tech, k) &&
+			    ((const unsigned int *)&ent->tech[k]->num)[i])
+				break;
+		if (k < ent->ntech)
+			continue;
+		q[i] = p[i];
+		changed++;
+	}
+	for (i = 0; i < ARRAY_SIZE(tech->eng); i++)
+		if (tech->eng[i] && !test_bit(tn->eng, tech->eng[i]->idx)) {
+			set_bit(tn->eng, tech->eng[i]->idx);
+			changed++;
+		}
+	for (i = 0; i < ARRAY_SIZE(tech->gun); i++)
+		if (tech->gun[i] && !test_bit(tn->gun, tech->gun[i]->idx)) {
+			set_bit(tn->gun, tech->gun[i]->idx);
+			changed++;
+		}
+	return changed;
+}
+
+/* Computes the tech numbers and unlocks for the set of techs in tn->tech.
+ * Only writes to *tn, so callers may build tech states concurrently.
+ */
 int apply_techs(const struct entities *ent, struct tech_numbers *tn)
 {
+	unsigned int techs[BITSET_WORDS(MAX_TECHS)];
 	struct tech *tech;
 	unsigned int j;
 
-	for (j = 0; j < ent->neng; j++)
-		ent->eng[j]->unlocked = false;
-	for (j = 0; j < ent->ngun; j++)
-		ent->gun[j]->unlocked = false;
-	for (j = 0; j < ent->ntech; j++) {
-		unsigned int i;
-
-		tech = ent->tech[j];
-		tech->have_reqs = true;
-		for (i = 0; i < ARRAY_SIZE(tech->req); i++)
-			if (tech->req[i] && !tech->req[i]->unlocked)
-				tech->have_reqs = false;
-	}
+	memcpy(techs, tn->tech, sizeof(techs));
 	memset(tn, 0, sizeof(*tn));
+	memcpy(tn->tech, techs, sizeof(techs));
 	for (j = 0; j < ent->ntech; j++) {
 		unsigned int *p, *q, i;
 
 		tech = ent->tech[j];
-		if (!tech->unlocked)
+		if (!test_bit(techs, j))
 			continue;
 		p = (unsigned int *)&tech->num;
 		q = (unsigned int *)tn;
-		for (i = 0; i * sizeof(*p) < sizeof(*tn); i++)
+		for (i = 0; i * sizeof(*p) < offsetof(struct tech_numbers, unlock_block); i++)
 			if (p[i])
 				q[i] = p[i];
 		for (i = 0; i < ARRAY_SIZE(tech->eng); i++)
 			if (tech->eng[i])
-				tech->eng[i]->unlocked = true;
+				set_bit(tn->eng, tech->eng[i]->idx);
 		for (i = 0; i < ARRAY_SIZE(tech->gun); i++)
 			if (tech->gun[i])
-				tech->gun[i]->unlocked = true;
+				set_bit(tn->gun, tech->gun[i]->idx);
 	}
 	return 0;
 }
@@ -6,6 +6,32 @@
 
 #define ARRAY_SIZE(x)	(sizeof(x) / sizeof(*x))
 
+/* Fixed-size bitsets, stored in `unsigned int` words so that they can
+ * live inside struct tech_numbers.
+ */
+#define BITS_PER_WORD	(8 * sizeof(unsigned int))
+#define BITSET_WORDS(n)	(((n) + BITS_PER_WORD - 1) / BITS_PER_WORD)
+
+static inline bool test_bit(const unsigned int *set, unsigned int i)
+{
+	return set[i / BITS_PER_WORD] & (1u << (i % BITS_PER_WORD));
+}
+
+static inline void set_bit(unsigned int *set, unsigned int i)
+{
+	set[i / BITS_PER_WORD] |= 1u << (i % BITS_PER_WORD);
+}
+
+static inline void clear_bit(unsigned int *set, unsigned int i)
+{
+	set[i / BITS_PER_WORD] &= ~(1u << (i % BITS_PER_WORD));
+}
+
+/* Limits on entity counts, for sizing the unlock bitsets */
+#define MAX_GUNS	64
+#define MAX_ENGINES	64
+#define MAX_TECHS	128
+
 enum turret_location {
 	LXN_UNSPEC,
 	LXN_NOSE,
@@ -32,6 +58,7 @@ enum coverage_direction {
 
 struct turret {
 	struct list_head list;
+	unsigned int idx; /* index into struct entities */
 	char ident[5];
 	unsigned int srv;
 	unsigned int twt;
@@ -44,14 +71,17 @@ struct turret {
 	unsigned int esl;
 	char *name;
 	char *desc;
-	bool unlocked;
 };
 
-int load_guns(struct list_head *head);
+int load_guns(int dirfd, struct list_head *head);
 int free_guns(struct list_head *head);
 
+#define POWER_STEP	100	/* feet */
+#define POWER_POINTS	(35000 / POWER_STEP + 1)
+
 struct engine {
 	struct list_head list;
+	unsigned int idx; /* index into struct entities */
 	char ident[5];
 	unsigned int bhp;
 	unsigned int vul;
@@ -59,16 +89,22 @@ struct engine {
 	unsigned int svc;
 	unsigned int cos;
 	unsigned int scl;
+	/* Full-throttle heights in ft of the low and high supercharger gears
+	 * (0 for none), and the power lost in high gear, in tenths of a
+	 * percent.  Those not given are as usual for the SCL.
+	 */
+	unsigned int ft1, ft2, fl2;
 	unsigned int twt;
 	unsigned int drg;
 	struct engine *u; /* can mod to us with overbuilt mounts */
 	char *manu;
 	char *name;
 	char *desc;
-	bool unlocked;
+	/* Fraction of bhp available every POWER_STEP ft from sea level */
+	float power[POWER_POINTS];
 };
 
-int load_engines(struct list_head *head);
+int load_engines(int dirfd, struct list_head *head);
 int free_engines(struct list_head *head);
 
 enum bb_girth {
@@ -90,6 +126,7 @@ enum fuse_type {
 
 struct manf {
 	struct list_head list;
+	unsigned int idx; /* index into struct entities */
 	char ident[3];
 	unsigned int wap, wld, bt[BB_COUNT], bbb;
 	unsigned int wcf, wcp, wc4, wt4, acc, act, geo;
@@ -99,7 +136,7 @@ struct manf {
 	char *desc;
 };
 
-int load_manfs(struct list_head *head);
+int load_manfs(int dirfd, struct list_head *head);
 int free_manfs(struct list_head *head);
 
 enum nav_aid {
@@ -181,10 +218,18 @@ struct tech_numbers {
 	unsigned int rgg; // Max gross take-off weight, grass
 	unsigned int rcs; // Max take-off speed, concrete
 	unsigned int rcg; // Max gross take-off weight, concrete
+	/* Unlock block.  Not read from tech data; apply_techs() fills in
+	 * eng and gun from the techs set in tech.
+	 */
+	unsigned int unlock_block[0];
+	unsigned int tech[BITSET_WORDS(MAX_TECHS)]; // researched techs
+	unsigned int eng[BITSET_WORDS(MAX_ENGINES)]; // unlocked engines
+	unsigned int gun[BITSET_WORDS(MAX_GUNS)]; // unlocked turrets
 };
 
 struct tech {
 	struct list_head list;
+	unsigned int idx; /* index into struct entities */
 	char ident[4];
 	unsigned int year, month;
 	struct tech_numbers num;
@@ -193,12 +238,11 @@ struct tech {
 	struct turret *gun[16];
 	char *name;
 	char *desc;
-	bool unlocked, have_reqs;
 };
 
 int try_load_tn_word(const char *key, const char *value,
 		     struct tech_numbers *tn);
-int load_techs(struct list_head *head, struct list_head *engines,
+int load_techs(int dirfd, struct list_head *head, struct list_head *engines,
 	       struct list_head *guns);
 int free_techs(struct list_head *head);
 
@@ -213,7 +257,11 @@ struct entities {
 int populate_entities(struct entities *ent, struct list_head *guns,
 		      struct list_head *engines, struct list_head *manfs,
 		      struct list_head *techs);
+void free_entities(struct entities *ent);
 
 int apply_techs(const struct entities *ent, struct tech_numbers *tn);
+int add_tech(const struct entities *ent, struct tech_numbers *tn,
+	     unsigned int j);
+bool tech_have_reqs(const struct tech *tech, const struct tech_numbers *tn);
 
 #endif // _DATA_H
@@ -0,0 +1,252 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "dice.h"
+
+const char *const hb_dice_names[HB_DICE_METRICS] = {
+	[HB_DICE_CRS] = "CRS",
+	[HB_DICE_RNG] = "RNG",
+	[HB_DICE_SRV] = "SRV",
+	[HB_DICE_DF0] = "DF0",
+	[HB_DICE_DF1] = "DF1",
+	[HB_DICE_ACC] = "ACC",
+};
+
+/* The first stage that reads each die */
+static const enum calc_stage die_stage[DIE_COUNT] = {
+	[DIE_DRAG] = CALC_PERF,
+	[DIE_SERV] = CALC_RELY,
+	[DIE_VULN] = CALC_COMBAT,
+	[DIE_MANU] = CALC_COMBAT,
+	[DIE_ACCU] = CALC_COMBAT,
+};
+
+#define DIE(d)	(1u << (d))
+
+/* Which dice each result depends on.  Nothing after calc_rely() reads
+ * serv, and in calc_combat() the accu die only feeds accu, vuln and manu
+ * only feed defn.
+ */
+static const unsigned int metric_dice[HB_DICE_METRICS] = {
+	[HB_DICE_CRS] = DIE(DIE_DRAG),
+	[HB_DICE_RNG] = DIE(DIE_DRAG),
+	[HB_DICE_SRV] = DIE(DIE_SERV),
+	[HB_DICE_DF0] = DIE(DIE_DRAG) | DIE(DIE_VULN) | DIE(DIE_MANU),
+	[HB_DICE_DF1] = DIE(DIE_DRAG) | DIE(DIE_VULN) | DIE(DIE_MANU),
+	[HB_DICE_ACC] = DIE(DIE_DRAG) | DIE(DIE_ACCU),
+};
+
+#define MAX_FACES	21
+
+/* The values a die can end up with, after clamping */
+struct faces {
+	unsigned int n;
+	int v[MAX_FACES];
+	double p[MAX_FACES];
+};
+
+struct walk {
+	struct bomber *s;
+	const struct tech_numbers *tn;
+	struct faces faces[DIE_COUNT];
+	enum die dice[DIE_COUNT];
+	unsigned int ndice;
+	enum hb_dice_metric m;
+	enum calc_stage from; /* earliest stage whose dice have changed */
+	unsigned long evals;
+	unsigned int n, cap;
+	struct hb_dist_point *pt;
+};
+
+static void roll_faces(const struct bomber *b, enum die d, struct faces *f)
+{
+	int n = die_spread[b->refit][d], base = 0, k, v;
+
+	if (b->refit != REFIT_FRESH)
+		base = *die_value((struct randomisation *)&b->dice, d);
+	f->n = 0;
+	for (k = -n; k <= n; k++) {
+		v = min(max(base + k, -die_limit[d]), die_limit[d]);
+		/* Clamping can only merge neighbours */
+		if (f->n && f->v[f->n - 1] == v) {
+			f->p[f->n - 1] += 1.0 / (n * 2 + 1);
+			continue;
+		}
+		f->v[f->n] = v;
+		f->p[f->n++] = 1.0 / (n * 2 + 1);
+	}
+}
+
+static float metric_value(const struct bomber *b, enum hb_dice_metric m)
+{
+	switch (m) {
+	case HB_DICE_CRS:
+		return b->cruise_spd;
+	case HB_DICE_RNG:
+		return b->range;
+	case HB_DICE_SRV:
+		return b->serv;
+	case HB_DICE_DF0:
+		return b->defn[0];
+	case HB_DICE_DF1:
+		return b->defn[1];
+	case HB_DICE_ACC:
+		return b->accu;
+	default: /* can't happen */
+		return 0;
+	}
+}
+
+static int add_point(struct walk *w, float v, double p)
+{
+	if (w->n == w->cap) {
+		unsigned int cap = w->cap ? w->cap * 2 : 64;
+		void *pt = realloc(w->pt, cap * sizeof(*w->pt));
+
+		if (!pt)
+			return -ENOMEM;
+		w->pt = pt;
+		w->cap = cap;
+	}
+	w->pt[w->n++] = (struct hb_dist_point){.v = v, .p = p};
+	return 0;
+}
+
+/* Dice are taken in stage order, so the innermost loop re-runs least */
+static int walk(struct walk *w, unsigned int k, double p)
+{
+	const struct faces *f;
+	unsigned int i;
+	int rc;
+
+	if (k == w->ndice) {
+		if (w->from < CALC_STAGES) {
+			rc = calc_bomber_from(w->s, w->tn, w->from);
+			if (rc)
+				return rc;
+			w->evals++;
+			w->from = CALC_STAGES;
+		}
+		return add_point(w, metric_value(w->s, w->m), p);
+	}
+	f = &w->faces[w->dice[k]];
+	for (i = 0; i < f->n; i++) {
+		*die_value(&w->s->dice, w->dice[k]) = f->v[i];
+		w->from = min(w->from, die_stage[w->dice[k]]);
+		rc = walk(w, k + 1, p * f->p[i]);
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
+
+static int point_cmp(const void *a, const void *b)
+{
+	const struct hb_dist_point *x = a, *y = b;
+
+	return (x->v > y->v) - (x->v < y->v);
+}
+
+/* Sorts and merges w's points into d, leaving w empty */
+static void make_dist(struct walk *w, struct hb_dist *d)
+{
+	unsigned int i, n = 0;
+
+	qsort(w->pt, w->n, sizeof(*w->pt), point_cmp);
+	for (i = 0; i < w->n; i++)
+		if (n && w->pt[n - 1].v == w->pt[i].v)
+			w->pt[n - 1].p += w->pt[i].p;
+		else
+			w->pt[n++] = w->pt[i];
+	d->n = n;
+	d->pt = w->pt;
+	w->pt = NULL;
+	w->n = w->cap = 0;
+}
+
+int hb_dice_enumerate(const struct bomber *b, const struct tech_numbers *tn,
+		      struct hb_dice *out)
+{
+	struct walk w = {.tn = tn};
+	enum hb_dice_metric m;
+	enum die d;
+	int rc = 0;
+
+	if (b->refit >= REFIT_LEVELS)
+		return -EINVAL;
+	memset(out, 0, sizeof(*out));
+	w.s = malloc(sizeof(*w.s));
+	if (!w.s)
+		return -ENOMEM;
+	*w.s = *b;
+	w.s->dice.rolled = true;
+	out->outcomes = 1;
+	for (d = 0; d < DIE_COUNT; d++) {
+		roll_faces(b, d, &w.faces[d]);
+		out->outcomes *= die_spread[b->refit][d] * 2 + 1;
+		*die_value(&w.s->dice, d) = w.faces[d].v[0];
+	}
+	w.from = CALC_REFIT;
+	for (m = 0; !rc && m < HB_DICE_METRICS; m++) {
+		w.m = m;
+		w.ndice = 0;
+		for (d = 0; d < DIE_COUNT; d++)
+			if (metric_dice[m] & DIE(d))
+				w.dice[w.ndice++] = d;
+		rc = walk(&w, 0, 1.0);
+		if (!rc)
+			make_dist(&w, &out->d[m]);
+	}
+	out->evals = w.evals;
+	free(w.pt);
+	free(w.s);
+	if (rc)
+		hb_dice_free(out);
+	return rc;
+}
+
+enum calc_stage hb_dice_from(enum refit_level refit)
+{
+	enum calc_stage from = CALC_STAGES;
+	enum die d;
+
+	for (d = 0; d < DIE_COUNT; d++)
+		if (refit < REFIT_LEVELS && die_spread[refit][d])
+			from = min(from, die_stage[d]);
+	return from;
+}
+
+void hb_dice_free(struct hb_dice *d)
+{
+	unsigned int i;
+
+	for (i = 0; i < HB_DICE_METRICS; i++) {
+		free(d->d[i].pt);
+		d->d[i].pt = NULL;
+		d->d[i].n = 0;
+	}
+}
+
+float hb_dist_mean(const struct hb_dist *d)
+{
+	double s = 0;
+	unsigned int i;
+
+	for (i = 0; i < d->n; i++)
+		s += d->pt[i].v * d->pt[i].p;
+	return s;
+}
+
+float hb_dist_quantile(const struct hb_dist *d, double q)
+{
+	double c = 0;
+	unsigned int i;
+
+	for (i = 0; i + 1 < d->n; i++) {
+		c += d->pt[i].p;
+		/* allow for rounding in the probabilities */
+		if (c >= q - 1e-9)
+			break;
+	}
+	return d->n ? d->pt[i].v : 0;
+}
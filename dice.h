@@ -0,0 +1,62 @@
+#ifndef _DICE_H
+#define _DICE_H
+
+/* Exact prototype risk.
+ *
+ * When a prototype flies, do_randomise() rolls the dice that nudge its
+ * drag, serviceability, vulnerability, manoeuvrability and accuracy.
+ * hb_dice_enumerate() works through every way the dice could fall, and
+ * gives the exact distribution of the results that matter to a player.
+ * Each result only depends on some of the dice (range only on drag, for
+ * instance), so each is enumerated over just those, and each throw only
+ * re-runs the calculation from the first stage its dice feed into.
+ */
+
+#include "hbuilder.h"
+
+enum hb_dice_metric {
+	HB_DICE_CRS, /* cruise_spd */
+	HB_DICE_RNG, /* range */
+	HB_DICE_SRV, /* serv */
+	HB_DICE_DF0, /* defn[0] */
+	HB_DICE_DF1, /* defn[1] */
+	HB_DICE_ACC, /* accu */
+
+	HB_DICE_METRICS
+};
+
+extern const char *const hb_dice_names[HB_DICE_METRICS];
+
+struct hb_dist_point {
+	float v;
+	double p;
+};
+
+/* Distinct values, in increasing order, with their probabilities */
+struct hb_dist {
+	unsigned int n;
+	struct hb_dist_point *pt;
+};
+
+struct hb_dice {
+	struct hb_dist d[HB_DICE_METRICS];
+	unsigned long outcomes; /* of all the dice together */
+	unsigned long evals; /* partial recalculations done */
+};
+
+/* b is not changed.  For a Mark or Mod the dice in b are taken as those it
+ * inherited, before its own roll; a clean sheet rolls from scratch.
+ */
+int hb_dice_enumerate(const struct bomber *b, const struct tech_numbers *tn,
+		      struct hb_dice *out);
+void hb_dice_free(struct hb_dice *d);
+/* The first calculation stage that the dice rolled for a refit level can
+ * change; re-running from there is enough after a roll.
+ */
+enum calc_stage hb_dice_from(enum refit_level refit);
+
+float hb_dist_mean(const struct hb_dist *d);
+/* Smallest value v with P(X <= v) >= q */
+float hb_dist_quantile(const struct hb_dist *d, double q);
+
+#endif // _DICE_H
@@ -3,10 +3,15 @@
 #include <string.h>
 #include <unistd.h>
 #include <termios.h>
+#include <time.h>
 #include <errno.h>
 #include <math.h>
 #include "edit.h"
 #include "save.h"
+#include "solve.h"
+
+/* The editor is single-threaded, so it can keep its dice state here */
+static unsigned int rng_seed;
 
 static int enable_cbreak_mode(struct termios *old)
 {
@@ -44,105 +49,6 @@ static const char *describe_ftype(enum fuse_type ft)
 	}
 }
 
-const char *describe_bbg(enum bb_girth girth)
-{
-	switch (girth) {
-	case BB_SMALL:
-		return "small bombs";
-	case BB_MEDIUM:
-		return "medium bombs";
-	case BB_COOKIE:
-		return "large bombs";
-	default:
-		return "error!  unknown girth";
-	}
-}
-
-const char *describe_esl(enum elec_level esl)
-{
-	switch (esl) {
-	case ESL_LOW:
-		return "low power";
-	case ESL_HIGH:
-		return "high power";
-	case ESL_STABLE:
-		return "high power, stable voltage";
-	default:
-		return "error!  unknown electric supply level";
-	}
-}
-
-const char *describe_navaid(enum nav_aid na)
-{
-	switch (na) {
-	case NA_GEE:
-		return "GEE";
-	case NA_H2S:
-		return "H₂S";
-	case NA_OBOE:
-		return "OBOE";
-	default:
-		return "error!  unknown navaid";
-	}
-}
-
-const char *describe_refit(enum refit_level refit)
-{
-	switch (refit) {
-	case REFIT_FRESH:
-		return "Clean-sheet";
-	case REFIT_MARK:
-		return "Mark";
-	case REFIT_MOD:
-		return "Mod";
-	case REFIT_DOCTRINE:
-		return "Doctrine";
-	default:
-		return "error!  unknown refit";
-	}
-}
-
-
-char crew_to_letter(enum crewpos c)
-{
-	switch (c) {
-	case CCLASS_P:
-		return 'P';
-	case CCLASS_N:
-		return 'N';
-	case CCLASS_B:
-		return 'B';
-	case CCLASS_W:
-		return 'W';
-	case CCLASS_E:
-		return 'E';
-	case CCLASS_G:
-		return 'G';
-	default:
-		return '?';
-	}
-}
-
-enum crewpos letter_to_crew(char c)
-{
-	switch (c) {
-	case 'P':
-		return CCLASS_P;
-	case 'N':
-		return CCLASS_N;
-	case 'B':
-		return CCLASS_B;
-	case 'W':
-		return CCLASS_W;
-	case 'E':
-		return CCLASS_E;
-	case 'G':
-		return CCLASS_G;
-	default:
-		return CREW_CLASSES;
-	}
-}
-
 static void dump_manf(struct bomber *b)
 {
 	printf("[M]anufacturer: %s\n", b->manf->name);
@@ -310,6 +216,26 @@ static void dump_limits(struct bomber *b, struct tech_numbers *tn)
 		       tn->rcg, tn->rcs);
 }
 
+static void dump_envelope(const struct bomber *b)
+{
+	struct perf_point prof[PROFILE_POINTS];
+	unsigned int n = perf_envelope(b, prof), i;
+
+	/* Every thousand feet, and the top */
+	for (i = 0; i < n; i++) {
+		if (i % (1000 / ALTITUDE_STEP) && i + 1 < n)
+			continue;
+		printf("%5uft: speed %.1fmph (min. %.1fmph); climb %.0ffpm; %.0fbhp\n",
+		       i * ALTITUDE_STEP, prof[i].speed, prof[i].minv,
+		       prof[i].climb, prof[i].power);
+	}
+	if (prof[n - 1].climb > 0.0f)
+		printf("Absolute ceiling above %uft", (n - 1) * ALTITUDE_STEP);
+	else
+		printf("Absolute ceiling %uft", (n - 1) * ALTITUDE_STEP);
+	printf("; service ceiling %.0fft\n", b->ceiling * 1000.0f);
+}
+
 static int edit_manf(struct bomber *b, struct tech_numbers *tn,
 		     const struct entities *ent)
 {
@@ -409,7 +335,7 @@ static int edit_eng(struct bomber *b, struct tech_numbers *tn,
 	for (i = 0; i < ent->neng; i++) {
 		const struct engine *e = ent->eng[i];
 
-		if (e->unlocked && (b->refit < REFIT_MOD ||
+		if (test_bit(tn->eng, i) && (b->refit < REFIT_MOD ||
 				    p->engines.typ == e ||
 				    p->engines.mou == e))
 			printf("[%c] %s %s\n", i + 'A', e->manu, e->name);
@@ -446,7 +372,7 @@ static int edit_eng(struct bomber *b, struct tech_numbers *tn,
 			return 0;
 		}
 		i = c - 'A';
-		if (i < 0 || i >= ent->neng || !ent->eng[i]->unlocked ||
+		if (i < 0 || i >= ent->neng || !test_bit(tn->eng, i) ||
 		    (b->refit == REFIT_MOD &&
 		     p->engines.typ != ent->eng[i] &&
 		     p->engines.mou != ent->eng[i])) {
@@ -543,7 +469,7 @@ static int edit_guns(struct bomber *b, struct tech_numbers *tn,
 
 	printf(">Select turret to add, number to remove, @ for mounts, or 0 to cancel\n");
 	for (i = 0; i < ent->ngun; i++)
-		if (ent->gun[i]->unlocked && !gun_conflict(b, ent->gun[i]))
+		if (test_bit(tn->gun, i) && !gun_conflict(b, ent->gun[i]))
 			printf("[%c] %s\n", i + 'A', ent->gun[i]->name);
 	for (i = LXN_NOSE; i < LXN_COUNT; i++)
 		if (b->turrets.typ[i])
@@ -580,7 +506,7 @@ static int edit_guns(struct bomber *b, struct tech_numbers *tn,
 			return 0;
 		}
 		i = c - 'A';
-		if (i < 0 || i >= ent->ngun || !ent->gun[i]->unlocked ||
+		if (i < 0 || i >= ent->ngun || !test_bit(tn->gun, i) ||
 		    gun_conflict(b, ent->gun[i])) {
 			putchar('?');
 			continue;
@@ -1342,7 +1268,10 @@ static int edit_techyear(struct tech_numbers *tn, const struct entities *ent)
 	putchar('>');
 	if (v) {
 		for (i = 0; i < ent->ntech; i++)
-			ent->tech[i]->unlocked = ent->tech[i]->year <= v;
+			if (ent->tech[i]->year <= v)
+				set_bit(tn->tech, i);
+			else
+				clear_bit(tn->tech, i);
 		return apply_techs(ent, tn);
 	}
 	return 0;
@@ -1356,6 +1285,7 @@ static int edit_tech(struct tech_numbers *tn, const struct entities *ent)
 
 	printf(">Select tech to toggle, @ for year, or 0 to cancel\n");
 	for (i = 0; i < ent->ntech; i++) {
+		bool unlocked, have_reqs;
 		char l, s;
 
 		t = ent->tech[i];
@@ -1363,7 +1293,9 @@ static int edit_tech(struct tech_numbers *tn, const struct entities *ent)
 			j = i + 1;
 			continue;
 		}
-		if (!t->have_reqs && !t->unlocked)
+		unlocked = test_bit(tn->tech, i);
+		have_reqs = tech_have_reqs(t, tn);
+		if (!have_reqs && !unlocked)
 			continue;
 		if (i - j < 26)
 			l = (i - j) + 'A';
@@ -1372,8 +1304,8 @@ static int edit_tech(struct tech_numbers *tn, const struct entities *ent)
 		else
 			l = (i - j - 56) + '!';
 		s = ' ';
-		if (t->unlocked) {
-			if (t->have_reqs)
+		if (unlocked) {
+			if (have_reqs)
 				s = '*';
 			else
 				s = '!';
@@ -1411,7 +1343,10 @@ static int edit_tech(struct tech_numbers *tn, const struct entities *ent)
 				t = ent->tech[i + j + 26];
 			}
 		}
-		t->unlocked = !t->unlocked;
+		if (test_bit(tn->tech, t->idx))
+			clear_bit(tn->tech, t->idx);
+		else
+			set_bit(tn->tech, t->idx);
 		putchar('>');
 		return apply_techs(ent, tn);
 	} while (1);
@@ -1430,6 +1365,7 @@ static int edit_refit(const struct bomber *b, struct tech_numbers *tn,
 
 	b2.parent = b;
 	b2.dice.rolled = false;
+	b2.dice.seed = 0;
 	printf(">Select refit level (mar[K], m[O]d, [D]octrine) or 0 to cancel\n");
 
 	do {
@@ -1503,12 +1439,16 @@ static int do_save(const struct bomber *b)
 
 static int do_load(struct bomber *b, const struct entities *ent)
 {
-	char fn[80];
+	unsigned int n = 1;
+	char fn[80], *h;
 	FILE *fp;
 	size_t l;
 	int rc;
 
-	printf(">Enter filename, or empty string to cancel\n>");
+	/* FILE#N loads the Nth design from a file of several, such as a
+	 * Pareto front written by `hbuilder pareto`
+	 */
+	printf(">Enter filename[#N], or empty string to cancel\n>");
 	if (!fgets(fn, sizeof(fn), stdin))
 		return -EIO;
 	if (!*fn)
@@ -1517,13 +1457,22 @@ static int do_load(struct bomber *b, const struct entities *ent)
 	l = strlen(fn);
 	if (fn[l - 1] == '\n')
 		fn[l - 1] = 0;
+	h = strrchr(fn, '#');
+	if (h) {
+		*h++ = 0;
+		n = atoi(h);
+		if (!n)
+			return -EINVAL;
+	}
 	fp = fopen(fn, "r");
 	if (!fp) {
 		rc = -errno;
 		perror("fopen");
 		return rc;
 	}
-	rc = load_design(fp, b, ent);
+	do
+		rc = load_design(fp, b, ent);
+	while (!rc && --n);
 	fclose(fp);
 	if (rc < 0)
 		fprintf(stderr, "Load failed: %s\n",
@@ -1539,6 +1488,42 @@ static int do_unrandomise(struct bomber *b)
 	return 0;
 }
 
+static int do_solve(struct bomber *b, struct tech_numbers *tn)
+{
+	struct hb_query q;
+	unsigned int evals, i;
+	char buf[80];
+	size_t l;
+	int rc;
+
+	printf(">Enter min:INPUT or max:INPUT and a goal, e.g. min:fill range>=600, or empty string to cancel\n>");
+	if (!fgets(buf, sizeof(buf), stdin))
+		return -EIO;
+	/* kill trailing newline */
+	l = strlen(buf);
+	if (l && buf[l - 1] == '\n')
+		buf[l - 1] = 0;
+	if (!*buf)
+		return 0; /* cancelled */
+	rc = hb_parse_query(buf, &q);
+	if (rc) {
+		for (i = 0; i < hb_nknobs; i++)
+			printf("%s: %s\n", hb_knobs[i].name, hb_knobs[i].desc);
+		return rc;
+	}
+	rc = hb_solve(b, tn, &q, &evals);
+	if (rc == -EPERM)
+		fprintf(stderr, "%s refit cannot change %s.\n",
+			describe_refit(b->refit), q.k->name);
+	else if (rc == -ERANGE)
+		printf("No %s meets %s%s%g\n", q.k->name, q.goal.m->name,
+		       q.goal.le ? "<=" : ">=", q.goal.value);
+	else if (!rc)
+		printf(">%s %u gives %s %g (%u recalculations)\n", q.k->name,
+		       q.k->get(b), q.goal.m->name, q.goal.m->get(b), evals);
+	return rc;
+}
+
 static int edit_loop(struct bomber *b, struct tech_numbers *tn,
 		     const struct entities *ent)
 {
@@ -1665,10 +1650,20 @@ static int edit_loop(struct bomber *b, struct tech_numbers *tn,
 			putchar('\n');
 			dump_limits(b, tn);
 			continue;
+		case 'p':
+		case 'P':
+			putchar('>');
+			putchar('\n');
+			dump_envelope(b);
+			continue;
 		case 'a':
 		case 'A':
 			rc = auto_doctrine(b, tn);
 			break;
+		case 'n':
+		case 'N':
+			rc = do_solve(b, tn);
+			break;
 		case 'x':
 		case 'X':
 			/* Redisplay errors/warnings */
@@ -1678,7 +1673,10 @@ static int edit_loop(struct bomber *b, struct tech_numbers *tn,
 			continue;
 		case 'y':
 		case 'Y':
-			rc = do_randomise(b);
+			/* Rolling again is a fresh roll, not a replay */
+			if (b->dice.rolled)
+				b->dice.seed = 0;
+			rc = do_randomise(b, &rng_seed);
 			if (!rc)
 				putchar('>');
 			break;
@@ -1713,6 +1711,7 @@ int editor(struct bomber *b, struct tech_numbers *tn,
 	struct termios cooked;
 	int rc;
 
+	rng_seed = time(NULL);
 	rc = enable_cbreak_mode(&cooked);
 	if (rc) {
 		fprintf(stderr, "Failed to enable cbreak mode on tty\n");
@@ -0,0 +1,22 @@
+#include "fmath.h"
+
+float fm_fast_powi(float x, unsigned int n)
+{
+	float r = 1.0f;
+
+	for (; n; n >>= 1, x *= x)
+		if (n & 1)
+			r *= x;
+	return r;
+}
+
+void fm_fast_pow_steps(float x, float unit, float *out, unsigned int n)
+{
+	unsigned int i;
+
+	if (!n)
+		return;
+	out[0] = powf(x, unit);
+	for (i = 1; i < n; i++)
+		out[i] = out[i - 1] * out[0];
+}
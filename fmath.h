@@ -0,0 +1,58 @@
+#ifndef _FMATH_H
+#define _FMATH_H
+
+/* Power kernels for the design calculation.
+ *
+ * The calculation raises positive quantities (weights, costs, overgross)
+ * to fractional powers that are small multiples of one unit exponent,
+ * often the same quantity to several of them (x^0.3 and x^0.4, x^0.6 and
+ * x^0.8), and raises probabilities to small integer powers.  Rather than
+ * a powf() call for each, fm_pow_steps() makes one call for the unit and
+ * multiplies up, and fm_powi() multiplies by squaring.
+ * Up to four steps, results are within FM_STEPS_ULP (a part in a
+ * million) of powf()'s, and fm_powi() within FM_POWI_ULP; fmathcheck
+ * (`make check`) measures both.  fmath.o is built optimised whatever
+ * CFLAGS says.
+ *
+ * There are only scalar forms: the calculation works on one design at a
+ * time, each power feeding branches before the next is taken, so there
+ * is no array of like quantities to vectorise over.  Batches get their
+ * speed from the pool's threads instead.
+ *
+ * Building with HB_LIBM defined (make HB_LIBM=1) makes fm_pow_steps()
+ * and fm_powi() call powf() for every power instead, reproducing the
+ * plain libm results as a reference.
+ */
+
+#include <math.h>
+
+/* Largest step count fm_pow_steps() is characterised for */
+#define FM_MAX_STEPS	4
+/* Worst errors, in ulp */
+#define FM_STEPS_ULP	8
+#define FM_POWI_ULP	2
+
+float fm_fast_powi(float x, unsigned int n);
+/* out[i] = x ** (unit * (i + 1)), for i < n */
+void fm_fast_pow_steps(float x, float unit, float *out, unsigned int n);
+
+#ifdef HB_LIBM
+static inline float fm_powi(float x, unsigned int n)
+{
+	return powf(x, n);
+}
+
+static inline void fm_pow_steps(float x, float unit, float *out,
+				unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		out[i] = powf(x, unit * (i + 1));
+}
+#else
+#define fm_powi		fm_fast_powi
+#define fm_pow_steps	fm_fast_pow_steps
+#endif
+
+#endif // _FMATH_H
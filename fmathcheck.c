@@ -0,0 +1,104 @@
+/* fmathcheck [-n SAMPLES]: the fmath.h kernels against libm.
+ *
+ * Prints each kernel's worst error, in ulp, and its cost per call beside
+ * powf()'s, and fails if any error is over the bound fmath.h documents.
+ * Run by `make check`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fmath.h"
+
+#define ARRAY_SIZE(x)	(sizeof(x) / sizeof(*x))
+
+/* Distance between two floats, in units of the last place of ref */
+static float ulps(float x, float ref)
+{
+	return fabsf(x - ref) / (nextafterf(fabsf(ref), INFINITY) - fabsf(ref));
+}
+
+static double seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	static const struct {
+		float unit;
+		unsigned int steps;
+	} fam[] = {{0.1f, 4}, {0.2f, 4}};
+	unsigned int n = 1000000, i, j, k;
+	float worst[FM_MAX_STEPS], out[FM_MAX_STEPS], x;
+	volatile float sink;
+	double t0, t1, t2;
+	int rc = 0;
+
+	if (argc == 3 && !strcmp(argv[1], "-n"))
+		n = strtoul(argv[2], NULL, 0);
+	if ((argc != 1 && argc != 3) || !n) {
+		fprintf(stderr, "Usage: fmathcheck [-n SAMPLES]\n");
+		return 2;
+	}
+	/* Quantities from 1e-3 to 1e7, evenly in the logarithm */
+	for (j = 0; j < ARRAY_SIZE(fam); j++) {
+		memset(worst, 0, sizeof(worst));
+		for (i = 0; i < n; i++) {
+			x = expf(-6.9f + 23.0f * i / n);
+			fm_fast_pow_steps(x, fam[j].unit, out, fam[j].steps);
+			for (k = 0; k < fam[j].steps; k++)
+				worst[k] = fmaxf(worst[k],
+						 ulps(out[k], powf(x, fam[j].unit * (k + 1))));
+		}
+		t0 = seconds();
+		for (i = 0; i < n; i++) {
+			x = 1.0f + i;
+			for (k = 0; k < fam[j].steps; k++)
+				sink = powf(x, fam[j].unit * (k + 1));
+		}
+		t1 = seconds();
+		for (i = 0; i < n; i++) {
+			fm_fast_pow_steps(1.0f + i, fam[j].unit, out, fam[j].steps);
+			sink = out[0];
+		}
+		t2 = seconds();
+		for (k = 0; k < fam[j].steps; k++) {
+			printf("POW=%g:ULP=%.2f\n", fam[j].unit * (k + 1), worst[k]);
+			if (worst[k] > FM_STEPS_ULP)
+				rc = 1;
+		}
+		printf("STEPS=%g*%u:LIBM_NS=%.1f:FAST_NS=%.1f\n", fam[j].unit,
+		       fam[j].steps, (t1 - t0) * 1e9 / n, (t2 - t1) * 1e9 / n);
+	}
+	/* Probabilities, to integer powers */
+	memset(worst, 0, sizeof(worst));
+	for (i = 0; i < n; i++) {
+		x = (i + 1.0f) / n;
+		for (k = 0; k < FM_MAX_STEPS; k++)
+			worst[k] = fmaxf(worst[k], ulps(fm_fast_powi(x, k + 1),
+							powf(x, k + 1)));
+	}
+	t0 = seconds();
+	for (i = 0; i < n; i++)
+		sink = powf((i + 1.0f) / n, 3);
+	t1 = seconds();
+	for (i = 0; i < n; i++)
+		sink = fm_fast_powi((i + 1.0f) / n, 3);
+	t2 = seconds();
+	for (k = 0; k < FM_MAX_STEPS; k++) {
+		printf("POWI=%u:ULP=%.2f\n", k + 1, worst[k]);
+		if (worst[k] > FM_POWI_ULP)
+			rc = 1;
+	}
+	printf("POWI=3:LIBM_NS=%.1f:FAST_NS=%.1f\n", (t1 - t0) * 1e9 / n,
+	       (t2 - t1) * 1e9 / n);
+	(void)sink;
+	if (rc)
+		fprintf(stderr, "fmathcheck: error over the bound\n");
+	return rc;
+}
@@ -0,0 +1,321 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "hbuilder.h"
+#include "save.h"
+
+int hb_load(struct hb_data *d, const char *dir)
+{
+	int dirfd, rc;
+
+	memset(d, 0, sizeof(*d));
+	INIT_LIST_HEAD(&d->guns);
+	INIT_LIST_HEAD(&d->engines);
+	INIT_LIST_HEAD(&d->manfs);
+	INIT_LIST_HEAD(&d->techs);
+
+	dirfd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (dirfd < 0)
+		return -errno;
+	rc = load_guns(dirfd, &d->guns);
+	if (rc >= 0)
+		rc = load_engines(dirfd, &d->engines);
+	if (rc >= 0)
+		rc = load_manfs(dirfd, &d->manfs);
+	if (rc >= 0)
+		rc = load_techs(dirfd, &d->techs, &d->engines, &d->guns);
+	close(dirfd);
+	if (rc >= 0)
+		rc = populate_entities(&d->ent, &d->guns, &d->engines,
+				       &d->manfs, &d->techs);
+	if (rc >= 0 && (!d->ent.nmanf || !d->ent.neng))
+		rc = -ENOENT;
+	if (rc < 0) {
+		hb_free(d);
+		return rc;
+	}
+	return 0;
+}
+
+void hb_free(struct hb_data *d)
+{
+	free_entities(&d->ent);
+	free_techs(&d->techs);
+	free_guns(&d->guns);
+	free_engines(&d->engines);
+	free_manfs(&d->manfs);
+}
+
+int hb_tech_base(const struct entities *ent, struct tech_numbers *tn)
+{
+	unsigned int i;
+
+	memset(tn, 0, sizeof(*tn));
+	for (i = 0; i < ent->ntech; i++)
+		if (!ent->tech[i]->year)
+			set_bit(tn->tech, i);
+	return apply_techs(ent, tn);
+}
+
+int hb_tech_set(const struct entities *ent, const unsigned int *techs,
+		struct tech_numbers *tn)
+{
+	memset(tn, 0, sizeof(*tn));
+	memcpy(tn->tech, techs, sizeof(tn->tech));
+	return apply_techs(ent, tn);
+}
+
+int hb_tech_date(const struct entities *ent, unsigned int year,
+		 unsigned int month, struct tech_numbers *tn)
+{
+	unsigned int i;
+
+	memset(tn, 0, sizeof(*tn));
+	for (i = 0; i < ent->ntech; i++) {
+		const struct tech *t = ent->tech[i];
+
+		if (t->year < year || (t->year == year &&
+				       (!month || t->month <= month)))
+			set_bit(tn->tech, i);
+	}
+	return apply_techs(ent, tn);
+}
+
+int hb_tech_hex(const struct entities *ent, const char *hex,
+		struct tech_numbers *tn)
+{
+	size_t len = strlen(hex), i;
+
+	memset(tn, 0, sizeof(*tn));
+	if (!len)
+		return -EINVAL;
+	for (i = 0; i < len; i++) {
+		char c = hex[len - 1 - i];
+		unsigned int v, j;
+
+		if (c >= '0' && c <= '9')
+			v = c - '0';
+		else if (c >= 'a' && c <= 'f')
+			v = c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			v = c - 'A' + 10;
+		else
+			return -EINVAL;
+		for (j = 0; j < 4; j++) {
+			if (!(v & (1u << j)))
+				continue;
+			if (i * 4 + j >= ent->ntech)
+				return -ERANGE;
+			set_bit(tn->tech, i * 4 + j);
+		}
+	}
+	return apply_techs(ent, tn);
+}
+
+int hb_tech_add(const struct entities *ent, struct tech_numbers *tn,
+		unsigned int idx)
+{
+	return add_tech(ent, tn, idx);
+}
+
+int hb_new_design(const struct entities *ent, struct bomber *b)
+{
+	if (!ent->nmanf || !ent->neng)
+		return -ENOENT;
+	init_bomber(b, ent->manf[0], ent->eng[0]);
+	return 0;
+}
+
+int hb_load_design(const struct entities *ent, FILE *f, struct bomber *b)
+{
+	return load_design(f, b, ent);
+}
+
+int hb_save_design(FILE *f, const struct bomber *b)
+{
+	return save_design(f, b);
+}
+
+int hb_evaluate(struct bomber *b, const struct tech_numbers *tn)
+{
+	return calc_bomber(b, tn);
+}
+
+int hb_randomise(struct bomber *b, unsigned int *seed)
+{
+	return do_randomise(b, seed);
+}
+
+void hb_outputs(const struct bomber *b, struct hb_outputs *o)
+{
+	o->error = b->error;
+	o->warnings = b->new;
+	o->tare = b->tare;
+	o->gross = b->gross;
+	o->mtow = b->mtow;
+	o->cost = b->cost;
+	o->takeoff_spd = b->takeoff_spd;
+	o->ceiling = b->ceiling;
+	o->cruise_alt = b->cruise_alt;
+	o->cruise_spd = b->cruise_spd;
+	o->init_climb = b->init_climb;
+	o->deck_spd = b->deck_spd;
+	o->range = b->range;
+	o->serv = b->serv;
+	o->fail = b->fail;
+	o->vuln = b->vuln;
+	o->fight_factor[0] = b->fight_factor[0];
+	o->fight_factor[1] = b->fight_factor[1];
+	o->flak_factor = b->flak_factor;
+	o->defn[0] = b->defn[0];
+	o->defn[1] = b->defn[1];
+	o->accu = b->accu;
+	o->tproto = b->tproto;
+	o->tprod = b->tprod;
+	o->cproto = b->cproto;
+	o->cprod = b->cprod;
+}
+
+int hb_design_pack(const struct bomber *b, struct hb_design_in *in)
+{
+	unsigned int i;
+
+	if (b->refit)
+		return -EINVAL;
+	memset(in, 0, sizeof(*in));
+	memcpy(in->tech, b->tn.tech, sizeof(in->tech));
+	in->manf = b->manf->idx;
+	in->eng_typ = b->engines.typ->idx;
+	in->eng_mou = b->engines.mou->idx;
+	in->eng_number = b->engines.number;
+	in->egg = b->engines.egg;
+	for (i = 0; i < LXN_COUNT; i++) {
+		in->tur_typ[i] = b->turrets.typ[i] ? b->turrets.typ[i]->idx
+						   : HB_NONE;
+		in->tur_mou[i] = b->turrets.mou[i] ? b->turrets.mou[i]->idx
+						   : HB_NONE;
+	}
+	in->crew_n = b->crew.n;
+	for (i = 0; i < b->crew.n; i++)
+		in->crew[i] = b->crew.men[i].pos |
+			      (b->crew.men[i].gun ? HB_CREW_GUN : 0);
+	in->girth = b->bay.girth;
+	in->csbs = b->bay.csbs;
+	in->fuse = b->fuse.typ;
+	in->esl = b->elec.esl;
+	for (i = 0; i < NA_COUNT; i++)
+		if (b->elec.navaid[i])
+			in->navaid |= 1 << i;
+	in->sst = b->tanks.sst;
+	in->user_mtow = b->user_mtow;
+	in->wing_area = b->wing.area;
+	in->wing_art = b->wing.art;
+	in->tank_hlb = b->tanks.hlb;
+	in->tank_pct = b->tanks.pct;
+	in->bay_cap = b->bay.cap;
+	in->bay_load = b->bay.load;
+	in->mtow = b->mtow;
+	in->drag = b->dice.drag;
+	in->serv = b->dice.serv;
+	in->vuln = b->dice.vuln;
+	in->manu = b->dice.manu;
+	in->accu = b->dice.accu;
+	return 0;
+}
+
+int hb_design_unpack(const struct entities *ent,
+		     const struct hb_design_in *in, struct bomber *b)
+{
+	unsigned int i;
+
+	if (in->manf >= ent->nmanf || in->eng_typ >= ent->neng ||
+	    in->eng_mou >= ent->neng || in->crew_n > MAX_CREW ||
+	    in->girth >= BB_COUNT || in->fuse >= FT_COUNT ||
+	    in->esl >= ESL_COUNT)
+		return -EINVAL;
+	init_bomber(b, ent->manf[in->manf], ent->eng[in->eng_typ]);
+	memcpy(b->tn.tech, in->tech, sizeof(b->tn.tech));
+	b->engines.mou = ent->eng[in->eng_mou];
+	b->engines.number = in->eng_number;
+	b->engines.egg = in->egg;
+	for (i = 0; i < LXN_COUNT; i++) {
+		if (in->tur_typ[i] != HB_NONE) {
+			if (in->tur_typ[i] >= ent->ngun)
+				return -EINVAL;
+			b->turrets.typ[i] = ent->gun[in->tur_typ[i]];
+		}
+		if (in->tur_mou[i] != HB_NONE) {
+			if (in->tur_mou[i] >= ent->ngun)
+				return -EINVAL;
+			b->turrets.mou[i] = ent->gun[in->tur_mou[i]];
+		}
+	}
+	b->crew.n = in->crew_n;
+	for (i = 0; i < in->crew_n; i++) {
+		b->crew.men[i].pos = in->crew[i] & ~HB_CREW_GUN;
+		b->crew.men[i].gun = in->crew[i] & HB_CREW_GUN;
+		if (b->crew.men[i].pos >= CREW_CLASSES)
+			return -EINVAL;
+	}
+	b->bay.girth = in->girth;
+	b->bay.csbs = in->csbs;
+	b->fuse.typ = in->fuse;
+	b->elec.esl = in->esl;
+	for (i = 0; i < NA_COUNT; i++)
+		b->elec.navaid[i] = in->navaid & (1 << i);
+	b->tanks.sst = in->sst;
+	b->user_mtow = in->user_mtow;
+	b->wing.area = in->wing_area;
+	b->wing.art = in->wing_art;
+	b->tanks.hlb = in->tank_hlb;
+	b->tanks.pct = in->tank_pct;
+	b->bay.cap = in->bay_cap;
+	b->bay.load = in->bay_load;
+	b->mtow = in->mtow;
+	b->dice.drag = in->drag;
+	b->dice.serv = in->serv;
+	b->dice.vuln = in->vuln;
+	b->dice.manu = in->manu;
+	b->dice.accu = in->accu;
+	b->dice.rolled = in->drag || in->serv || in->vuln || in->manu ||
+			 in->accu;
+	return 0;
+}
+
+void hb_eval_packed(const struct entities *ent, struct hb_worker *w,
+		    const struct hb_design_in *in, struct hb_result *res)
+{
+	res->tag = in->tag;
+	memset(&res->o, 0, sizeof(res->o));
+	/* Batches mostly share a tech state, so keep the last one */
+	if (!w->tn_valid || memcmp(w->tn.tech, in->tech, sizeof(w->tn.tech))) {
+		res->rc = hb_tech_set(ent, in->tech, &w->tn);
+		w->tn_valid = !res->rc;
+		if (res->rc)
+			return;
+	}
+	res->rc = hb_design_unpack(ent, in, &w->b);
+	if (!res->rc)
+		res->rc = hb_evaluate(&w->b, &w->tn);
+	if (!res->rc)
+		hb_outputs(&w->b, &res->o);
+}
+
+int hb_format_result(char *buf, size_t len, const char *tag, int rc,
+		     const struct hb_outputs *o)
+{
+	if (rc < 0 || !o)
+		return snprintf(buf, len, "RES=%s:RC=%d\n", tag, rc);
+	return snprintf(buf, len,
+			"RES=%s:RC=%d:ERR=%d:WRN=%u:TAR=%.1f:GRO=%.1f:MTW=%u:COS=%.1f:TOS=%.2f:CEI=%.2f:CRA=%.2f:CRS=%.2f:CLB=%.1f:DEK=%.2f:RNG=%.1f:SRV=%.4f:FAI=%.4f:VUL=%.4f:FF0=%.3f:FF1=%.3f:FLK=%.3f:DF0=%.3f:DF1=%.3f:ACC=%.4f:TPR=%.1f:TPD=%.1f:CPR=%.0f:CPD=%.0f\n",
+			tag, rc, o->error ? 1 : 0, o->warnings, o->tare,
+			o->gross, o->mtow, o->cost, o->takeoff_spd,
+			o->ceiling, o->cruise_alt, o->cruise_spd,
+			o->init_climb, o->deck_spd, o->range, o->serv,
+			o->fail, o->vuln, o->fight_factor[0],
+			o->fight_factor[1], o->flak_factor, o->defn[0],
+			o->defn[1], o->accu, o->tproto, o->tprod, o->cproto,
+			o->cprod);
+}
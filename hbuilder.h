@@ -0,0 +1,142 @@
+#ifndef _HBUILDER_H
+#define _HBUILDER_H
+
+/* libhbuilder - the design calculator, as a library.
+ *
+ * Typical use:
+ *	struct hb_data d;
+ *	struct tech_numbers tn;
+ *	struct bomber b;
+ *
+ *	hb_load(&d, "path/to/data");
+ *	hb_tech_date(&d.ent, 1941, 6, &tn);
+ *	hb_new_design(&d.ent, &b);	(or hb_load_design())
+ *	... set inputs in b ...
+ *	hb_evaluate(&b, &tn);
+ *	... read outputs from b, or via hb_outputs() ...
+ *	hb_free(&d);
+ *
+ * The library never touches stdin or stdout (load errors are reported on
+ * stderr) and keeps no global state.  Once loaded, the entities are never
+ * written to, so any number of threads may evaluate designs against the
+ * same entities at once, as long as each thread uses its own struct bomber
+ * (and its own dice seed for hb_randomise()).  A struct tech_numbers is a
+ * complete, self-contained tech state and may likewise be shared read-only.
+ */
+
+#include <stdio.h>
+#include "calc.h"
+
+struct hb_data {
+	struct list_head guns, engines, manfs, techs;
+	struct entities ent;
+};
+
+/* Loads the data files (guns, eng, manu, tech) from directory dir */
+int hb_load(struct hb_data *d, const char *dir);
+void hb_free(struct hb_data *d);
+
+/* Tech states.  Techs are identified by their index in ent->tech.
+ * The base state has only the year 0 techs.
+ */
+int hb_tech_base(const struct entities *ent, struct tech_numbers *tn);
+int hb_tech_set(const struct entities *ent, const unsigned int *techs,
+		struct tech_numbers *tn);
+/* All techs dated no later than month (1-12, or 0 for "any") of year */
+int hb_tech_date(const struct entities *ent, unsigned int year,
+		 unsigned int month, struct tech_numbers *tn);
+/* From a hex string, in which bit i is tech i (so the rightmost digit
+ * holds techs 0 to 3)
+ */
+int hb_tech_hex(const struct entities *ent, const char *hex,
+		struct tech_numbers *tn);
+/* Researches one more tech, updating only what it changes; returns the
+ * number of words of tn changed
+ */
+int hb_tech_add(const struct entities *ent, struct tech_numbers *tn,
+		unsigned int idx);
+
+/* Designs */
+int hb_new_design(const struct entities *ent, struct bomber *b);
+int hb_load_design(const struct entities *ent, FILE *f, struct bomber *b);
+int hb_save_design(FILE *f, const struct bomber *b);
+int hb_evaluate(struct bomber *b, const struct tech_numbers *tn);
+/* Rolls the prototype dice.  The rolls are keyed by b->dice.seed (saved
+ * with the design), so a loaded design replays its rolls; a design with no
+ * key yet is given one from *seed.
+ */
+int hb_randomise(struct bomber *b, unsigned int *seed);
+
+/* The headline outputs of an evaluated design, in a flat struct for
+ * callers that don't want to poke around in struct bomber.
+ */
+struct hb_outputs {
+	bool error;
+	unsigned int warnings;
+	float tare, gross;
+	unsigned int mtow;
+	float cost;
+	float takeoff_spd;
+	float ceiling; /* thousands ft */
+	float cruise_alt, cruise_spd;
+	float init_climb, deck_spd;
+	float range;
+	float serv, fail;
+	float vuln;
+	float fight_factor[2], flak_factor;
+	float defn[2];
+	float accu;
+	float tproto, tprod;
+	float cproto, cprod;
+};
+
+void hb_outputs(const struct bomber *b, struct hb_outputs *o);
+
+/* The inputs of a clean-sheet design as plain data, with entities given
+ * by their index into struct entities, for passing between processes.
+ */
+#define HB_CREW_GUN	0x80 /* or'd into crew[] for dual-rôle gunners */
+#define HB_NONE		0xff /* in tur_typ[] or tur_mou[], for no turret */
+
+struct hb_design_in {
+	unsigned int tag; /* for the caller's use */
+	unsigned int tech[BITSET_WORDS(MAX_TECHS)];
+	unsigned char manf;
+	unsigned char eng_typ, eng_mou, eng_number, egg;
+	unsigned char tur_typ[LXN_COUNT], tur_mou[LXN_COUNT];
+	unsigned char crew_n, crew[MAX_CREW];
+	unsigned char girth, csbs, fuse, esl, navaid, sst, user_mtow;
+	unsigned short wing_area, wing_art;
+	unsigned short tank_hlb, tank_pct;
+	unsigned int bay_cap, bay_load, mtow;
+	signed char drag, serv, vuln, manu, accu; /* dice */
+};
+
+int hb_design_pack(const struct bomber *b, struct hb_design_in *in);
+int hb_design_unpack(const struct entities *ent,
+		     const struct hb_design_in *in, struct bomber *b);
+
+struct hb_result {
+	unsigned int tag; /* from the hb_design_in */
+	int rc;
+	struct hb_outputs o;
+};
+
+/* Working space for one evaluation thread */
+struct hb_worker {
+	unsigned int id;
+	unsigned int seed; /* for hb_randomise() */
+	bool tn_valid; /* tn holds the last tech state applied */
+	struct tech_numbers tn;
+	struct bomber b;
+};
+
+/* Evaluates a packed design in w's scratch bomber */
+void hb_eval_packed(const struct entities *ent, struct hb_worker *w,
+		    const struct hb_design_in *in, struct hb_result *res);
+
+/* Writes the RES= line for a result (o may be NULL if rc < 0) */
+int hb_format_result(char *buf, size_t len, const char *tag, int rc,
+		     const struct hb_outputs *o);
+
+#endif // _HBUILDER_H
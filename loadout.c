@@ -0,0 +1,256 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "loadout.h"
+
+/* What fitting one turret adds */
+struct cand {
+	struct turret *t;
+	float weight, drag;
+	float gc[GC_COUNT];
+	float power; /* for ordering: coverage weighted as in gun_rate() */
+};
+
+struct search {
+	const struct hb_loadout *l;
+	const struct tech_numbers *tn;
+	struct bomber *s; /* scratch */
+	unsigned int ncand[LXN_COUNT];
+	struct cand cand[LXN_COUNT][MAX_GUNS];
+	/* Most coverage that locations i onwards could add */
+	float rest_gc[LXN_COUNT + 1][GC_COUNT];
+	/* Lower bounds from the bare airframe */
+	float evade, vuln, flak;
+	unsigned int max_gunners;
+	/* Current partial loadout */
+	struct turret *pick[LXN_COUNT];
+	struct hb_loadout_best *best;
+};
+
+static bool cand_ok(const struct bomber *b, const struct turret *t)
+{
+	if (t->lxn == LXN_NOSE && b->engines.odd)
+		return false;
+	if (t->lxn == LXN_VENTRAL && b->elec.navaid[NA_H2S])
+		return false;
+	if (t->slb && b->fuse.typ != FT_SLABBY)
+		return false;
+	return t->esl <= b->elec.esl;
+}
+
+static int cand_cmp(const void *a, const void *b)
+{
+	const struct cand *x = a, *y = b;
+
+	return (x->power < y->power) - (x->power > y->power);
+}
+
+static void find_cands(struct search *r, const struct entities *ent)
+{
+	const struct tech_numbers *tn = r->tn;
+	unsigned int i, j, k;
+
+	for (i = 0; i < ent->ngun; i++) {
+		struct turret *t = ent->gun[i];
+		struct cand *c;
+
+		if (!test_bit(tn->gun, i) || !cand_ok(r->s, t))
+			continue;
+		c = &r->cand[t->lxn][r->ncand[t->lxn]++];
+		c->t = t;
+		c->weight = t->twt * (1.0f + tn->gtf / 100.0f) +
+			    t->gun * tn->gam * (t->lxn == LXN_FIXED ? 0.25 : 1.0);
+		c->drag = t->drg * tn->gdf;
+		c->power = 0;
+		for (j = 0; j < GC_COUNT; j++) {
+			c->gc[j] = t->gc[j] / 10.0f;
+			c->power += c->gc[j];
+		}
+	}
+	/* Strongest first, so a good incumbent turns up early */
+	for (i = LXN_NOSE; i < LXN_COUNT; i++)
+		qsort(r->cand[i], r->ncand[i], sizeof(struct cand), cand_cmp);
+	memset(r->rest_gc, 0, sizeof(r->rest_gc));
+	for (i = LXN_COUNT - 1; i >= LXN_NOSE; i--)
+		for (j = 0; j < GC_COUNT; j++) {
+			r->rest_gc[i][j] = r->rest_gc[i + 1][j];
+			for (k = 0; k < r->ncand[i]; k++)
+				r->rest_gc[i][j] = max(r->rest_gc[i][j],
+						       r->rest_gc[i + 1][j] +
+						       r->cand[i][k].gc[j]);
+		}
+}
+
+/* Most gunners the crew could ever muster: every G and W*, every other
+ * starred man if there is a turret he can work, and a pilot for the
+ * fixed guns.
+ */
+static unsigned int max_gunners(const struct crew *c)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < c->n; i++)
+		if (c->men[i].pos == CCLASS_G || c->men[i].pos == CCLASS_P ||
+		    (c->men[i].gun && c->men[i].pos != CCLASS_E))
+			n++;
+	return n;
+}
+
+/* Adding turrets only adds weight and drag, which can only lower the
+ * ceiling, worsen manoeuvrability, and slow the aircraft at any given
+ * altitude.  But a lower ceiling means cruising lower down, where the
+ * engines give more power; so bound cruise speed by the bare airframe's
+ * speed at the cruise altitude of the most heavily armed one.
+ */
+static int bound_airframe(struct search *r)
+{
+	struct bomber *s = r->s;
+	struct turret heavy[LXN_COUNT];
+	float ceiling, alt, spd;
+	unsigned int i, k;
+	int rc;
+
+	for (i = LXN_NOSE; i < LXN_COUNT; i++) {
+		s->turrets.typ[i] = s->turrets.mou[i] = NULL;
+		if (!r->ncand[i])
+			continue;
+		heavy[i] = *r->cand[i][0].t;
+		heavy[i].slb = 0;
+		for (k = 1; k < r->ncand[i]; k++) {
+			const struct turret *t = r->cand[i][k].t;
+
+			heavy[i].twt = max(heavy[i].twt, t->twt);
+			heavy[i].drg = max(heavy[i].drg, t->drg);
+			heavy[i].gun = max(heavy[i].gun, t->gun);
+		}
+		s->turrets.typ[i] = s->turrets.mou[i] = &heavy[i];
+	}
+	rc = calc_bomber(s, r->tn);
+	if (rc)
+		return rc;
+	ceiling = s->ceiling;
+	alt = min(ceiling, 10.0f) + max(ceiling - 10.0f, 0) / 2.0f;
+
+	for (i = LXN_NOSE; i < LXN_COUNT; i++)
+		s->turrets.typ[i] = s->turrets.mou[i] = NULL;
+	rc = calc_bomber(s, r->tn);
+	if (rc)
+		return rc;
+	spd = airspeed(s, alt);
+	/* As calc_combat(), with the best of each term */
+	r->evade = (max(33.0f - s->ceiling, 2.0f) / 13.0f) *
+		   powf(max(350.0f - spd, 30.0f) / 1.2f, 0.45) *
+		   (1.0f - 0.3f / max(s->manu_pen - 4.5f, 0.5f));
+	r->evade = powf(r->evade, 0.8f);
+	r->vuln = s->vuln;
+	r->flak = s->vuln * 3.0f * sqrt(max(35.0f - s->ceiling, 2.0f) / 1.5f);
+	r->max_gunners = max_gunners(&s->crew);
+	return 0;
+}
+
+static float bound(const struct search *r, unsigned int lxn,
+		   const float *gc, unsigned int turrets)
+{
+	float rate[2], most[GC_COUNT], sgf, v;
+	unsigned int j;
+
+	for (j = 0; j < GC_COUNT; j++)
+		most[j] = gc[j] + r->rest_gc[lxn][j];
+	gun_rate(most, rate);
+	sgf = max((turrets + 1.0f) / (r->max_gunners + 1.0f), 1.0f);
+	v = r->evade * (r->vuln * 4.0f + rate[r->l->sch] * sgf) / 3.6f;
+	return r->l->defn ? v + r->flak : v;
+}
+
+static void leaf(struct search *r)
+{
+	struct bomber *s = r->s;
+	unsigned int i;
+	float v;
+
+	memcpy(s->turrets.typ, r->pick, sizeof(r->pick));
+	memcpy(s->turrets.mou, r->pick, sizeof(r->pick));
+	r->best->evals++;
+	if (calc_bomber(s, r->tn) || s->error)
+		return;
+	v = r->l->defn ? s->defn[r->l->sch] : s->fight_factor[r->l->sch];
+	if (v < r->best->value) {
+		r->best->value = v;
+		for (i = 0; i < LXN_COUNT; i++)
+			r->best->typ[i] = r->pick[i];
+	}
+}
+
+static void branch(struct search *r, unsigned int lxn, const float *gc,
+		   unsigned int turrets, float weight, float drag)
+{
+	const struct hb_loadout *l = r->l;
+	float ngc[GC_COUNT];
+	unsigned int j, k;
+
+	r->best->nodes++;
+	if (l->max_weight && weight > l->max_weight)
+		return;
+	if (l->max_drag && drag > l->max_drag)
+		return;
+	if (bound(r, lxn, gc, turrets) >= r->best->value)
+		return;
+	if (lxn == LXN_COUNT) {
+		leaf(r);
+		return;
+	}
+	for (k = 0; k < r->ncand[lxn]; k++) {
+		const struct cand *c = &r->cand[lxn][k];
+
+		for (j = 0; j < GC_COUNT; j++)
+			ngc[j] = gc[j] + c->gc[j];
+		r->pick[lxn] = c->t;
+		branch(r, lxn + 1, ngc, turrets + 1, weight + c->weight,
+		       drag + c->drag);
+	}
+	r->pick[lxn] = NULL;
+	branch(r, lxn + 1, gc, turrets, weight, drag);
+}
+
+int hb_loadout_search(const struct entities *ent, const struct bomber *b,
+		      const struct tech_numbers *tn,
+		      const struct hb_loadout *l, struct hb_loadout_best *best)
+{
+	float gc[GC_COUNT] = {0};
+	struct search *r;
+	int rc;
+
+	if (b->refit >= REFIT_MOD || l->sch > 1)
+		return -EINVAL;
+	r = calloc(1, sizeof(*r));
+	if (!r)
+		return -ENOMEM;
+	r->s = malloc(sizeof(*r->s));
+	if (!r->s) {
+		free(r);
+		return -ENOMEM;
+	}
+	*r->s = *b;
+	r->l = l;
+	r->tn = tn;
+	/* Conflicts depend on engines, fuselage and electrics, which the
+	 * turrets don't affect; so evaluate once to fill them in.
+	 */
+	rc = calc_bomber(r->s, tn);
+	if (!rc) {
+		find_cands(r, ent);
+		rc = bound_airframe(r);
+	}
+	if (!rc) {
+		memset(best, 0, sizeof(*best));
+		best->value = INFINITY;
+		r->best = best;
+		branch(r, LXN_NOSE, gc, 0, 0, 0);
+		if (isinf(best->value))
+			rc = -ENOENT;
+	}
+	free(r->s);
+	free(r);
+	return rc;
+}
@@ -0,0 +1,43 @@
+#ifndef _LOADOUT_H
+#define _LOADOUT_H
+
+/* Defensive armament search.
+ *
+ * hb_loadout_search() finds the turrets to fit, one or none in each
+ * location, that give a fixed airframe the best fighter defence (lowest
+ * fight_factor or defn) within a weight and/or drag budget.  Every turret
+ * is mounted in a mount of its own type, since a heavier mount would only
+ * add weight.
+ *
+ * The search is a depth-first branch-and-bound over the locations.  What
+ * each candidate turret adds (tare, ammo, drag, gun coverage) is worked
+ * out once up front; partial loadouts are then bounded from below using
+ * the best coverage the remaining locations could add, the most gunners
+ * the crew could provide, and the evade factor of the airframe with no
+ * turrets at all.  Only loadouts whose bound beats the best found so far
+ * are evaluated in full.
+ */
+
+#include "hbuilder.h"
+
+struct hb_loadout {
+	unsigned int sch; /* 0 or 1, as for fight_factor[] */
+	bool defn; /* minimise defn[sch], else fight_factor[sch] */
+	float max_weight; /* turret tare + ammo, lb; 0 for no limit */
+	float max_drag; /* turret drag; 0 for no limit */
+};
+
+struct hb_loadout_best {
+	struct turret *typ[LXN_COUNT];
+	float value;
+	unsigned long nodes, evals;
+};
+
+/* b is the airframe; its turrets are ignored, and it is not changed.
+ * Returns -ENOENT if no loadout in budget gives an error-free design.
+ */
+int hb_loadout_search(const struct entities *ent, const struct bomber *b,
+		      const struct tech_numbers *tn,
+		      const struct hb_loadout *l, struct hb_loadout_best *best);
+
+#endif // _LOADOUT_H
@@ -0,0 +1,202 @@
+/* loadoutcheck [-t YEAR] DESIGN...: hb_loadout_search() against every
+ * loadout.
+ *
+ * Evaluates each design with every choice of turret, or none, in every
+ * location (each turret in a mount of its own type, and none that needs
+ * more electrics than the design has), and keeps the error-free ones.
+ * Then for each objective, with no budget and with weight and drag
+ * budgets of half the most any of them has, fails if the best of those
+ * in budget isn't what hb_loadout_search() finds.  Run by `make check`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "loadout.h"
+#include "pool.h"
+
+#define ARRAY_SIZE(x)	(sizeof(x) / sizeof(*x))
+
+struct leaf {
+	bool ok;
+	float weight, drag;
+	float value[4]; /* ff0, ff1, defn0, defn1 */
+};
+
+struct loadouts {
+	const struct bomber *b;
+	const struct tech_numbers *tn;
+	/* The choices in each location; NULL for none */
+	unsigned int n[LXN_COUNT];
+	struct turret *opt[LXN_COUNT][MAX_GUNS + 1];
+	struct leaf *leaf;
+};
+
+static int eval_loadout(void *ctx, struct hb_worker *w, unsigned long i)
+{
+	struct loadouts *lo = ctx;
+	struct leaf *f = lo->leaf + i;
+	struct bomber *s = &w->b;
+	unsigned int lxn;
+
+	*s = *lo->b;
+	for (lxn = LXN_NOSE; lxn < LXN_COUNT; lxn++) {
+		s->turrets.typ[lxn] = lo->opt[lxn][i % lo->n[lxn]];
+		s->turrets.mou[lxn] = s->turrets.typ[lxn];
+		i /= lo->n[lxn];
+	}
+	f->ok = !calc_bomber(s, lo->tn) && !s->error;
+	f->weight = s->turrets.tare + s->turrets.ammo;
+	f->drag = s->turrets.drag;
+	f->value[0] = s->fight_factor[0];
+	f->value[1] = s->fight_factor[1];
+	f->value[2] = s->defn[0];
+	f->value[3] = s->defn[1];
+	return 0;
+}
+
+/* The best in budget, or INFINITY */
+static float best_of(const struct loadouts *lo, unsigned long n,
+		     const struct hb_loadout *l)
+{
+	float best = INFINITY;
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		const struct leaf *f = lo->leaf + i;
+
+		if (!f->ok || (l->max_weight && f->weight > l->max_weight) ||
+		    (l->max_drag && f->drag > l->max_drag))
+			continue;
+		best = min(best, f->value[l->defn * 2 + l->sch]);
+	}
+	return best;
+}
+
+static int check_design(struct hb_pool *pool, const struct entities *ent,
+			const struct tech_numbers *tn, const char *name)
+{
+	static const char *const objective[] = {"ff0", "ff1", "defn0", "defn1"};
+	struct hb_loadout_best best;
+	float heaviest = 0, most_drag = 0, want;
+	struct loadouts lo = {.tn = tn};
+	unsigned int bad = 0, lxn, i, j;
+	unsigned long n = 1, k;
+	struct hb_loadout l;
+	struct bomber *b;
+	FILE *f;
+	int rc;
+
+	b = malloc(sizeof(*b));
+	if (!b)
+		return -ENOMEM;
+	f = fopen(name, "r");
+	if (!f) {
+		rc = -errno;
+		goto out;
+	}
+	rc = hb_load_design(ent, f, b);
+	fclose(f);
+	if (rc)
+		goto out;
+	if (b->refit >= REFIT_MOD) {
+		printf("%s:REFIT\n", name);
+		goto out;
+	}
+	lo.b = b;
+	for (lxn = LXN_NOSE; lxn < LXN_COUNT; lxn++) {
+		lo.opt[lxn][lo.n[lxn]++] = NULL;
+		for (i = 0; i < ent->ngun; i++)
+			if (ent->gun[i]->lxn == lxn &&
+			    test_bit(tn->gun, i) &&
+			    ent->gun[i]->esl <= b->elec.esl)
+				lo.opt[lxn][lo.n[lxn]++] = ent->gun[i];
+		n *= lo.n[lxn];
+	}
+	lo.leaf = malloc(n * sizeof(*lo.leaf));
+	if (!lo.leaf) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	rc = hb_parallel_for(pool, n, 0, eval_loadout, &lo);
+	if (rc)
+		goto free;
+	for (k = 0; k < n; k++)
+		if (lo.leaf[k].ok) {
+			heaviest = max(heaviest, lo.leaf[k].weight);
+			most_drag = max(most_drag, lo.leaf[k].drag);
+		}
+	/* No budget, a weight budget, a drag budget, and both */
+	for (i = 0; i < 4; i++)
+		for (j = 0; j < ARRAY_SIZE(objective); j++) {
+			l = (struct hb_loadout){
+				.sch = j & 1, .defn = j & 2,
+				.max_weight = i & 1 ? heaviest / 2 : 0,
+				.max_drag = i & 2 ? most_drag / 2 : 0,
+			};
+			want = best_of(&lo, n, &l);
+			rc = hb_loadout_search(ent, b, tn, &l, &best);
+			if (rc && rc != -ENOENT)
+				goto free;
+			if (rc ? isinf(want) : want == best.value)
+				continue;
+			fprintf(stderr, "%s: %s", name, objective[j]);
+			if (l.max_weight)
+				fprintf(stderr, " -w %g", l.max_weight);
+			if (l.max_drag)
+				fprintf(stderr, " -d %g", l.max_drag);
+			fprintf(stderr, " is %g but hb_loadout_search() gives %g\n",
+				want, rc ? INFINITY : best.value);
+			bad++;
+		}
+	printf("%s:LOADOUTS=%lu:BAD=%u\n", name, n, bad);
+	rc = bad ? 1 : 0;
+free:
+	free(lo.leaf);
+out:
+	free(b);
+	return rc;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int year = 1943;
+	struct tech_numbers tn;
+	struct hb_pool *pool;
+	struct hb_data d;
+	int rc, i, bad = 0;
+
+	if (argc > 2 && !strcmp(argv[1], "-t")) {
+		year = strtoul(argv[2], NULL, 0);
+		argc -= 2;
+		argv += 2;
+	}
+	if (argc < 2) {
+		fprintf(stderr, "Usage: loadoutcheck [-t YEAR] DESIGN...\n");
+		return 2;
+	}
+	rc = hb_load(&d, ".");
+	if (rc)
+		return 2;
+	rc = hb_tech_date(&d.ent, year, 0, &tn);
+	if (!rc)
+		rc = hb_pool_create(0, 0, &pool);
+	if (rc) {
+		hb_free(&d);
+		return 2;
+	}
+	for (i = 1; i < argc; i++) {
+		rc = check_design(pool, &d.ent, &tn, argv[i]);
+		if (rc < 0)
+			fprintf(stderr, "%s: %s\n", argv[i], strerror(-rc));
+		if (rc)
+			bad = 1;
+	}
+	hb_pool_destroy(pool);
+	hb_free(&d);
+	if (bad)
+		fprintf(stderr, "loadoutcheck: hb_loadout_search() disagrees\n");
+	return bad;
+}
@@ -1,115 +1,1957 @@
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <math.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
-#include "data.h"
-#include "calc.h"
+#include "hbuilder.h"
+#include "assign.h"
+#include "crews.h"
+#include "dice.h"
 #include "edit.h"
+#include "loadout.h"
+#include "opt.h"
+#include "pareto.h"
+#include "payload.h"
+#include "plan.h"
+#include "pool.h"
+#include "programme.h"
+#include "proto.h"
+#include "research.h"
+#include "ring.h"
+#include "serve.h"
+#include "sortie.h"
+#include "squadron.h"
+#include "timeline.h"
 
 void error(const char *msg, int rc)
 {
 	fprintf(stderr, "%s: %s\n", msg, strerror(-rc));
 }
 
-void empty_guns(struct list_head *guns)
+static int cmd_serve(const struct entities *ent, int argc, char **argv)
 {
-	struct turret *gun;
+	return serve(ent, argc > 0 ? argv[0] : NULL);
+}
+
+struct ring_worker {
+	pthread_t thread;
+	struct hb_ring *ring;
+	const struct entities *ent;
+	int rc;
+};
+
+static void *ring_worker(void *data)
+{
+	struct ring_worker *w = data;
 
-	list_for_each_entry(gun, guns)
-		gun->unlocked = false;
+	w->rc = hb_ring_work(w->ring, w->ent);
+	return NULL;
 }
 
-void empty_engines(struct list_head *engines)
+/* ring NAME [ORDER]: serve a shared-memory ring, one worker per CPU */
+static int cmd_ring(const struct entities *ent, int argc, char **argv)
 {
-	struct engine *eng;
+	unsigned int order = 12, nw, i;
+	struct ring_worker *w;
+	struct hb_ring *ring;
+	long ncpu;
+	int rc;
 
-	list_for_each_entry(eng, engines)
-		eng->unlocked = false;
+	if (argc < 1) {
+		fprintf(stderr, "Usage: hbuilder ring NAME [ORDER]\n");
+		return -EINVAL;
+	}
+	if (argc > 1)
+		order = atoi(argv[1]);
+	rc = hb_ring_create(argv[0], order, &ring);
+	if (rc)
+		return rc;
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	nw = ncpu > 0 ? ncpu : 1;
+	w = calloc(nw, sizeof(*w));
+	if (!w) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	fprintf(stderr, "Serving ring %s with %u workers\n", argv[0], nw);
+	for (i = 0; i < nw; i++) {
+		w[i].ring = ring;
+		w[i].ent = ent;
+		rc = -pthread_create(&w[i].thread, NULL, ring_worker, w + i);
+		if (rc)
+			break;
+	}
+	nw = i;
+	/* Workers only return on error */
+	for (i = 0; i < nw; i++) {
+		pthread_join(w[i].thread, NULL);
+		if (w[i].rc)
+			rc = w[i].rc;
+	}
+	free(w);
+out:
+	hb_ring_close(ring);
+	hb_ring_unlink(argv[0]);
+	return rc;
 }
 
-void empty_techs(struct list_head *techs)
+struct batch {
+	const struct entities *ent;
+	const struct tech_numbers *tn;
+	char **files;
+	struct hb_result *res;
+};
+
+static int batch_one(void *ctx, struct hb_worker *w, unsigned long i)
 {
-	struct tech *tech;
+	struct batch *bt = ctx;
+	struct hb_result *res = bt->res + i;
+	FILE *f;
 
-	list_for_each_entry(tech, techs)
-		tech->unlocked = !tech->year;
+	f = fopen(bt->files[i], "r");
+	if (!f) {
+		res->rc = -errno;
+		return 0;
+	}
+	res->rc = hb_load_design(bt->ent, f, &w->b);
+	fclose(f);
+	if (!res->rc)
+		res->rc = hb_evaluate(&w->b, bt->tn);
+	if (!res->rc)
+		hb_outputs(&w->b, &res->o);
+	return 0;
 }
 
-int main(void)
+/* Takes a leading "-x VALUE" option off the arguments; returns x, or 0 */
+static int next_opt(int *argc, char ***argv, char **val)
+{
+	char **a = *argv;
+
+	if (*argc < 2 || a[0][0] != '-' || !a[0][1] || a[0][2])
+		return 0;
+	*val = a[1];
+	*argc -= 2;
+	*argv += 2;
+	return a[0][1];
+}
+
+/* YEAR[/MONTH], or NULL for the base tech state */
+static int parse_date(const struct entities *ent, const char *date,
+		      struct tech_numbers *tn)
+{
+	unsigned int year, month = 0;
+
+	if (!date)
+		return hb_tech_base(ent, tn);
+	if (sscanf(date, "%u/%u", &year, &month) < 1)
+		return -EINVAL;
+	return hb_tech_date(ent, year, month, tn);
+}
+
+static double seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int load_design(const struct entities *ent, const char *path,
+		       struct bomber *b)
+{
+	FILE *f = fopen(path, "r");
+	int rc;
+
+	if (!f)
+		return -errno;
+	rc = hb_load_design(ent, f, b);
+	fclose(f);
+	return rc;
+}
+
+static void free_names(char **names, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		free(names[i]);
+	free(names);
+}
+
+/* Adds path to *paths, or the files in it if it's a directory.  A path
+ * that can't be looked up goes in as it is, so that opening it says why.
+ */
+static int add_paths(const char *path, char ***paths, unsigned int *n)
+{
+	struct dirent **ents;
+	struct stat st;
+	char **p, *q;
+	int ne = 0, i, rc = 0, dir;
+
+	dir = !stat(path, &st) && S_ISDIR(st.st_mode);
+	if (dir) {
+		ne = scandir(path, &ents, NULL, alphasort);
+		if (ne < 0)
+			return -errno;
+	}
+	p = realloc(*paths, (*n + max(ne, 1)) * sizeof(*p));
+	if (!p) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	*paths = p;
+	if (!dir) {
+		p[(*n)++] = strdup(path);
+		return p[*n - 1] ? 0 : -ENOMEM;
+	}
+	for (i = 0; i < ne; i++) {
+		if (ents[i]->d_name[0] == '.')
+			continue;
+		q = malloc(strlen(path) + strlen(ents[i]->d_name) + 2);
+		if (!q) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		sprintf(q, "%s/%s", path, ents[i]->d_name);
+		if (stat(q, &st) || !S_ISREG(st.st_mode)) {
+			free(q);
+			continue;
+		}
+		p[(*n)++] = q;
+	}
+out:
+	for (i = 0; i < ne; i++)
+		free(ents[i]);
+	if (ne > 0)
+		free(ents);
+	return rc;
+}
+
+/* Loads the designs named, each DIR standing for the files in it, into
+ * *designs, with their paths in *names; returns how many.  A file named
+ * outright must load, but one in a directory that doesn't is left out.
+ */
+static int load_designs(const struct entities *ent, int argc, char **argv,
+			struct bomber **designs, char ***names)
+{
+	unsigned int n = 0, from, k;
+	struct bomber *d = NULL, *b;
+	char **paths = NULL;
+	int rc = 0, i;
+
+	for (i = 0; !rc && i < argc; i++) {
+		from = n;
+		rc = add_paths(argv[i], &paths, &n);
+		b = rc ? NULL : realloc(d, max(n, 1u) * sizeof(*d));
+		if (!b) {
+			rc = rc ? rc : -ENOMEM;
+			error(argv[i], rc);
+			break;
+		}
+		d = b;
+		for (k = from; k < n; ) {
+			memset(d + k, 0, sizeof(*d));
+			rc = load_design(ent, paths[k], d + k);
+			if (!rc) {
+				k++;
+				continue;
+			}
+			error(paths[k], rc);
+			/* Only what a directory turned up can be left out */
+			if (!strcmp(paths[k], argv[i]))
+				break;
+			free(paths[k]);
+			memmove(paths + k, paths + k + 1,
+				(--n - k) * sizeof(*paths));
+			rc = 0;
+		}
+	}
+	if (rc) {
+		free_names(paths, n);
+		free(d);
+		return rc;
+	}
+	*designs = d;
+	*names = paths;
+	return n;
+}
+
+/* batch [-t YEAR[/MONTH]] DESIGN|DIR...: evaluate saved designs, in
+ * parallel
+ */
+static int cmd_batch(const struct entities *ent, int argc, char **argv)
 {
-	struct list_head guns, engines, manfs, techs;
-	struct entities entities;
 	struct tech_numbers tn;
-	struct bomber b;
+	unsigned int n = 0, i;
+	struct hb_pool *pool;
+	char *date = NULL, *val, **paths = NULL;
+	struct batch bt;
+	char line[512];
 	int rc;
 
-	INIT_LIST_HEAD(&guns);
-	INIT_LIST_HEAD(&engines);
-	INIT_LIST_HEAD(&manfs);
-	INIT_LIST_HEAD(&techs);
+	while ((rc = next_opt(&argc, &argv, &val)))
+		if (rc == 't')
+			date = val;
+		else
+			return -EINVAL;
+	rc = parse_date(ent, date, &tn);
+	if (rc)
+		return rc;
+	/* Each file is loaded by a worker, so one that won't load gets an RC=
+	 * line like any other
+	 */
+	for (i = 0; !rc && i < argc; i++)
+		rc = add_paths(argv[i], &paths, &n);
+	if (rc)
+		goto out;
+	bt = (struct batch){.ent = ent, .tn = &tn, .files = paths};
+	bt.res = calloc(max(n, 1u), sizeof(*bt.res));
+	rc = bt.res ? hb_pool_create(0, 0, &pool) : -ENOMEM;
+	if (!rc) {
+		rc = hb_parallel_for(pool, n, 1, batch_one, &bt);
+		hb_pool_destroy(pool);
+	}
+	if (!rc)
+		for (i = 0; i < n; i++) {
+			hb_format_result(line, sizeof(line), paths[i],
+					 bt.res[i].rc, &bt.res[i].o);
+			fputs(line, stdout);
+		}
+	free(bt.res);
+out:
+	free_names(paths, n);
+	return rc;
+}
 
-	rc = load_guns(&guns);
-	if (rc < 0) {
-		error("Failed to load guns", rc);
-		return 1;
+static const struct manf *find_manf(const struct entities *ent,
+				    const char *ident)
+{
+	unsigned int i;
+
+	for (i = 0; i < ent->nmanf; i++)
+		if (!strcmp(ent->manf[i]->ident, ident))
+			return ent->manf[i];
+	return NULL;
+}
+
+static void opt_progress(void *ctx, const struct hb_opt_best *best)
+{
+	const struct hb_opt *o = ctx;
+
+	fprintf(stderr, "gen %u: %s %g%s (%u evaluated)\n", best->gen,
+		o->objective->name, best->value,
+		best->violation ? " INFEASIBLE" : "", best->evals);
+}
+
+/* Evaluates a packed design and writes it in save format */
+static int write_design(const struct entities *ent,
+			const struct tech_numbers *tn,
+			const struct hb_design_in *in, const char *path)
+{
+	struct bomber *b;
+	FILE *f = stdout;
+	int rc;
+
+	b = malloc(sizeof(*b));
+	if (!b)
+		return -ENOMEM;
+	rc = hb_design_unpack(ent, in, b);
+	if (!rc)
+		rc = hb_evaluate(b, tn);
+	if (!rc && path) {
+		f = fopen(path, "w");
+		if (!f)
+			rc = -errno;
 	}
-	fprintf(stderr, "Loaded %d guns\n", rc);
+	if (!rc)
+		rc = hb_save_design(f, b);
+	if (f && f != stdout)
+		fclose(f);
+	free(b);
+	return rc;
+}
 
-	rc = load_engines(&engines);
-	if (rc < 0) {
-		error("Failed to load engines", rc);
-		return 1;
+/* optimise [-t DATE] [-m MANF] [-p POP] [-g GENS] [-s SEED] [-o FILE]
+ *	  min:METRIC|max:METRIC [CONSTRAINT...]
+ */
+static int cmd_optimise(const struct entities *ent, int argc, char **argv)
+{
+	char *date = NULL, *out = NULL, *val;
+	struct hb_constraint *cons;
+	struct hb_opt_best best;
+	struct tech_numbers tn;
+	struct hb_pool *pool;
+	struct hb_space space;
+	struct hb_opt o = {
+		.pop = 128,
+		.gens = 200,
+		.progress = opt_progress,
+	};
+	const struct manf *manf = ent->manf[0];
+	int rc, i;
+
+	o.ctx = &o;
+	while ((rc = next_opt(&argc, &argv, &val)))
+		switch (rc) {
+		case 't':
+			date = val;
+			break;
+		case 'm':
+			manf = find_manf(ent, val);
+			if (!manf)
+				return -ENOENT;
+			break;
+		case 'p':
+			o.pop = atoi(val);
+			break;
+		case 'g':
+			o.gens = atoi(val);
+			break;
+		case 's':
+			o.seed = atoi(val);
+			break;
+		case 'o':
+			out = val;
+			break;
+		default:
+			return -EINVAL;
+		}
+	if (argc < 1) {
+		fprintf(stderr, "Usage: hbuilder optimise [-t YEAR[/MONTH]] [-m MANF] [-p POP] [-g GENS] [-s SEED] [-o FILE] min:METRIC|max:METRIC [CONSTRAINT...]\nMetrics:\n");
+		for (i = 0; i < hb_nmetrics; i++)
+			fprintf(stderr, "  %-8s %s\n", hb_metrics[i].name,
+				hb_metrics[i].desc);
+		return -EINVAL;
+	}
+	rc = parse_date(ent, date, &tn);
+	if (rc)
+		return rc;
+	rc = hb_parse_objective(argv[0], &o.objective, &o.maximise);
+	if (rc) {
+		fprintf(stderr, "Bad objective '%s'\n", argv[0]);
+		return rc;
 	}
-	fprintf(stderr, "Loaded %d engines\n", rc);
+	cons = calloc(argc, sizeof(*cons));
+	if (!cons)
+		return -ENOMEM;
+	for (i = 1; i < argc; i++) {
+		rc = hb_parse_constraint(argv[i], cons + o.ncons++);
+		if (rc) {
+			fprintf(stderr, "Bad constraint '%s'\n", argv[i]);
+			goto out;
+		}
+	}
+	o.cons = cons;
+	hb_space_init(&space, ent, &tn, manf);
+	o.space = &space;
+	rc = hb_pool_create(0, 0, &pool);
+	if (rc)
+		goto out;
+	rc = hb_optimise(pool, &o, &best);
+	hb_pool_destroy(pool);
+	if (rc)
+		goto out;
+	if (best.violation)
+		fprintf(stderr, "No design met the constraints; writing the closest\n");
+	rc = write_design(ent, &tn, &best.in, out);
+out:
+	free(cons);
+	return rc;
+}
 
-	rc = load_manfs(&manfs);
-	if (rc < 0) {
-		error("Failed to load manfs", rc);
-		return 1;
+static void explore_progress(void *ctx, unsigned int round,
+			     const struct hb_pareto *a)
+{
+	if (!(round % 10))
+		fprintf(stderr, "round %u: %u designs on the front\n", round,
+			hb_pareto_size(a));
+}
+
+static const char *default_objectives[] = {
+	"min:cost", "min:defn0", "min:defn1", "max:range", "max:load",
+	"max:accu", "min:tproto",
+};
+
+/* pareto [-t DATE] [-m MANF] [-r ROUNDS] [-b BATCH] [-s SEED] -o FILE
+ *	  [min:METRIC|max:METRIC...] [CONSTRAINT...]
+ */
+static int cmd_pareto(const struct entities *ent, int argc, char **argv)
+{
+	char *date = NULL, *out = NULL, *val;
+	struct hb_explore e = {
+		.rounds = 200,
+		.batch = 512,
+		.progress = explore_progress,
+	};
+	struct hb_constraint *cons;
+	const struct manf *manf = ent->manf[0];
+	struct tech_numbers tn;
+	struct hb_pareto *front;
+	struct hb_space space;
+	struct hb_pool *pool;
+	unsigned int i, j;
+	FILE *f;
+	int rc;
+
+	while ((rc = next_opt(&argc, &argv, &val)))
+		switch (rc) {
+		case 't':
+			date = val;
+			break;
+		case 'm':
+			manf = find_manf(ent, val);
+			if (!manf)
+				return -ENOENT;
+			break;
+		case 'r':
+			e.rounds = atoi(val);
+			break;
+		case 'b':
+			e.batch = atoi(val);
+			break;
+		case 's':
+			e.seed = atoi(val);
+			break;
+		case 'o':
+			out = val;
+			break;
+		default:
+			return -EINVAL;
+		}
+	if (!out) {
+		fprintf(stderr, "Usage: hbuilder pareto [-t YEAR[/MONTH]] [-m MANF] [-r ROUNDS] [-b BATCH] [-s SEED] -o FILE [min:METRIC|max:METRIC...] [CONSTRAINT...]\n");
+		return -EINVAL;
+	}
+	rc = parse_date(ent, date, &tn);
+	if (rc)
+		return rc;
+	cons = calloc(argc, sizeof(*cons));
+	if (!cons)
+		return -ENOMEM;
+	for (i = 0; i < argc; i++) {
+		if (!strncmp(argv[i], "min:", 4) || !strncmp(argv[i], "max:", 4)) {
+			if (e.nobj == HB_PARETO_MAX_OBJ)
+				rc = -E2BIG;
+			else
+				rc = hb_parse_objective(argv[i], &e.obj[e.nobj],
+							&e.maximise[e.nobj]);
+			e.nobj++;
+		} else {
+			rc = hb_parse_constraint(argv[i], cons + e.ncons++);
+		}
+		if (rc) {
+			fprintf(stderr, "Bad objective or constraint '%s'\n",
+				argv[i]);
+			goto out;
+		}
 	}
-	fprintf(stderr, "Loaded %d manfs\n", rc);
+	if (!e.nobj)
+		for (; e.nobj < ARRAY_SIZE(default_objectives); e.nobj++)
+			hb_parse_objective(default_objectives[e.nobj],
+					   &e.obj[e.nobj], &e.maximise[e.nobj]);
+	e.cons = cons;
+	hb_space_init(&space, ent, &tn, manf);
+	e.space = &space;
+	rc = hb_pareto_create(e.nobj, &front);
+	if (rc)
+		goto out;
+	rc = hb_pool_create(0, 0, &pool);
+	if (!rc) {
+		rc = hb_explore(pool, &e, front);
+		hb_pool_destroy(pool);
+	}
+	f = rc ? NULL : fopen(out, "w");
+	if (!rc && !f)
+		rc = -errno;
+	/* The designs go to the file, in order; a key to them to stdout */
+	for (i = 0; !rc && i < hb_pareto_size(front); i++) {
+		const struct hb_design_in *in;
+		struct bomber b;
+		const float *obj;
 
-	rc = load_techs(&techs, &engines, &guns);
-	if (rc < 0) {
-		error("Failed to load techs", rc);
-		return 1;
+		in = hb_pareto_get(front, i, &obj);
+		rc = hb_design_unpack(ent, in, &b);
+		if (!rc)
+			rc = hb_evaluate(&b, &tn);
+		if (!rc)
+			rc = hb_save_design(f, &b);
+		printf("%s#%u", out, i + 1);
+		for (j = 0; j < e.nobj; j++)
+			printf(":%s=%g", e.obj[j]->name,
+			       e.maximise[j] ? -obj[j] : obj[j]);
+		putchar('\n');
+	}
+	if (f)
+		fclose(f);
+	fprintf(stderr, "%u designs on the front\n", hb_pareto_size(front));
+	hb_pareto_destroy(front);
+out:
+	free(cons);
+	return rc;
+}
+
+/* turrets [-t DATE] [-w WEIGHT] [-d DRAG] [-o FILE] DESIGN [OBJECTIVE]:
+ * best defensive armament for a saved airframe
+ */
+static int cmd_turrets(const struct entities *ent, int argc, char **argv)
+{
+	static const char *objectives[] = {"ff0", "ff1", "defn0", "defn1"};
+	char *date = NULL, *out = NULL, *val;
+	struct hb_loadout l = {.defn = true};
+	struct hb_loadout_best best;
+	struct tech_numbers tn;
+	struct bomber *b;
+	unsigned int i;
+	const char *sep = "";
+	FILE *f;
+	int rc;
+
+	while ((rc = next_opt(&argc, &argv, &val)))
+		switch (rc) {
+		case 't':
+			date = val;
+			break;
+		case 'w':
+			l.max_weight = atof(val);
+			break;
+		case 'd':
+			l.max_drag = atof(val);
+			break;
+		case 'o':
+			out = val;
+			break;
+		default:
+			return -EINVAL;
+		}
+	if (argc > 1) {
+		for (i = 0; i < ARRAY_SIZE(objectives); i++)
+			if (!strcmp(argv[1], objectives[i]))
+				break;
+		if (i >= ARRAY_SIZE(objectives)) {
+			fprintf(stderr, "Bad objective '%s'\n", argv[1]);
+			return -EINVAL;
+		}
+		l.sch = i & 1;
+		l.defn = i & 2;
+	}
+	if (argc < 1 || argc > 2) {
+		fprintf(stderr, "Usage: hbuilder turrets [-t YEAR[/MONTH]] [-w WEIGHT] [-d DRAG] [-o FILE] DESIGN [ff0|ff1|defn0|defn1]\n");
+		return -EINVAL;
+	}
+	rc = parse_date(ent, date, &tn);
+	if (rc)
+		return rc;
+	b = malloc(sizeof(*b));
+	if (!b)
+		return -ENOMEM;
+	rc = load_design(ent, argv[0], b);
+	if (!rc)
+		rc = hb_loadout_search(ent, b, &tn, &l, &best);
+	if (rc)
+		goto out;
+	fprintf(stderr, "%lu nodes, %lu evaluated\n", best.nodes, best.evals);
+	printf("%s=%g:TUR=", objectives[l.defn * 2 + l.sch], best.value);
+	for (i = LXN_NOSE; i < LXN_COUNT; i++)
+		if (best.typ[i]) {
+			printf("%s%s", sep, best.typ[i]->ident);
+			sep = ",";
+		}
+	putchar('\n');
+	if (!out)
+		goto out;
+	memcpy(b->turrets.typ, best.typ, sizeof(best.typ));
+	memcpy(b->turrets.mou, best.typ, sizeof(best.typ));
+	rc = hb_evaluate(b, &tn);
+	f = rc ? NULL : fopen(out, "w");
+	if (!rc && !f)
+		rc = -errno;
+	if (!rc)
+		rc = hb_save_design(f, b);
+	if (f)
+		fclose(f);
+out:
+	free(b);
+	return rc;
+}
+
+static const struct crew_metric {
+	const char *name;
+	size_t offset;
+	bool maximise;
+} crew_metrics[] = {
+	{"ACC", offsetof(struct hb_crew_result, accu), true},
+	{"VUL", offsetof(struct hb_crew_result, vuln), false},
+	{"FAI", offsetof(struct hb_crew_result, fail), false},
+	{"DF0", offsetof(struct hb_crew_result, defn[0]), false},
+	{"DF1", offsetof(struct hb_crew_result, defn[1]), false},
+};
+
+static float crew_value(const struct hb_crew_result *r,
+			const struct crew_metric *cm)
+{
+	float v = *(const float *)((const char *)r + cm->offset);
+
+	return cm->maximise ? -v : v;
+}
+
+static void print_crew(const char *tag, const struct hb_crew_result *r)
+{
+	char crw[MAX_CREW * 2 + 1];
+
+	hb_crew_format(&r->key, crw, sizeof(crw));
+	printf("%s:CRW=%s:ERR=%d:ACC=%.4f:VUL=%.4f:FAI=%.4f:DF0=%.3f:DF1=%.3f\n",
+	       tag, crw, r->error, r->accu, r->vuln, r->fail, r->defn[0],
+	       r->defn[1]);
+}
+
+/* crews [-t DATE] [-n MAXCREW] [-k TOP] DESIGN: best crews for an airframe */
+static int cmd_crews(const struct entities *ent, int argc, char **argv)
+{
+	unsigned int max_crew = MAX_CREW, top = 5, i, j, n;
+	const struct hb_crew_result *r, **best;
+	char *date = NULL, *val, tag[16];
+	struct tech_numbers tn;
+	struct hb_crews *crews;
+	struct hb_pool *pool;
+	struct bomber *b;
+	int rc;
+
+	while ((rc = next_opt(&argc, &argv, &val)))
+		switch (rc) {
+		case 't':
+			date = val;
+			break;
+		case 'n':
+			max_crew = atoi(val);
+			break;
+		case 'k':
+			top = atoi(val);
+			break;
+		default:
+			return -EINVAL;
+		}
+	if (argc != 1) {
+		fprintf(stderr, "Usage: hbuilder crews [-t YEAR[/MONTH]] [-n MAXCREW] [-k TOP] DESIGN\n");
+		return -EINVAL;
+	}
+	rc = parse_date(ent, date, &tn);
+	if (rc)
+		return rc;
+	b = malloc(sizeof(*b));
+	best = calloc(top, sizeof(*best));
+	rc = b && best ? load_design(ent, argv[0], b) : -ENOMEM;
+	if (!rc)
+		rc = hb_crews_create(b, &tn, max_crew, &crews);
+	if (rc)
+		goto out;
+	rc = hb_pool_create(0, 0, &pool);
+	if (!rc) {
+		rc = hb_crews_fill(pool, crews);
+		hb_pool_destroy(pool);
+	}
+	if (rc)
+		goto out_crews;
+	fprintf(stderr, "%u crews evaluated\n", hb_crews_size(crews));
+	r = hb_crews_find(crews, b);
+	if (r)
+		print_crew("CUR", r);
+	/* Top few error-free crews by each metric, by repeated selection */
+	for (i = 0; i < ARRAY_SIZE(crew_metrics); i++) {
+		const struct crew_metric *cm = crew_metrics + i;
+
+		for (n = 0; n < top; n++) {
+			best[n] = NULL;
+			for (j = 0; j < hb_crews_size(crews); j++) {
+				r = hb_crews_get(crews, j);
+				if (r->rc || r->error)
+					continue;
+				if (n && (crew_value(r, cm) < crew_value(best[n - 1], cm) ||
+					  (crew_value(r, cm) == crew_value(best[n - 1], cm) &&
+					   r <= best[n - 1])))
+					continue;
+				if (!best[n] || crew_value(r, cm) < crew_value(best[n], cm))
+					best[n] = r;
+			}
+			if (!best[n])
+				break;
+			snprintf(tag, sizeof(tag), "%s#%u", cm->name, n + 1);
+			print_crew(tag, best[n]);
+		}
+	}
+out_crews:
+	hb_crews_destroy(crews);
+out:
+	free(best);
+	free(b);
+	return rc;
+}
+
+/* dice [-t DATE] DESIGN [METRIC]: exact spread of prototype outcomes */
+static int cmd_dice(const struct entities *ent, int argc, char **argv)
+{
+	int show = HB_DICE_METRICS;
+	struct tech_numbers tn;
+	char *date = NULL, *val;
+	struct hb_dice dice;
+	struct bomber *b;
+	unsigned int i;
+	int rc;
+
+	while ((rc = next_opt(&argc, &argv, &val)))
+		if (rc == 't')
+			date = val;
+		else
+			return -EINVAL;
+	if (argc == 2)
+		for (show = 0; show < HB_DICE_METRICS; show++)
+			if (!strcmp(argv[1], hb_dice_names[show]))
+				break;
+	if (argc < 1 || argc > 2 || (argc == 2 && show == HB_DICE_METRICS)) {
+		fprintf(stderr, "Usage: hbuilder dice [-t YEAR[/MONTH]] DESIGN [CRS|RNG|SRV|DF0|DF1|ACC]\n");
+		return -EINVAL;
 	}
-	fprintf(stderr, "Loaded %d techs\n", rc);
+	rc = parse_date(ent, date, &tn);
+	if (rc)
+		return rc;
+	b = malloc(sizeof(*b));
+	rc = b ? load_design(ent, argv[0], b) : -ENOMEM;
+	if (!rc)
+		rc = hb_dice_enumerate(b, &tn, &dice);
+	free(b);
+	if (rc)
+		return rc;
+	fprintf(stderr, "%lu outcomes, %lu partial recalculations\n",
+		dice.outcomes, dice.evals);
+	for (i = 0; i < HB_DICE_METRICS; i++) {
+		const struct hb_dist *d = &dice.d[i];
 
-	rc = populate_entities(&entities, &guns, &engines, &manfs, &techs);
+		printf("%s:N=%u:MEAN=%g:MIN=%g:P10=%g:P50=%g:P90=%g:MAX=%g\n",
+		       hb_dice_names[i], d->n, hb_dist_mean(d), d->pt[0].v,
+		       hb_dist_quantile(d, 0.1), hb_dist_quantile(d, 0.5),
+		       hb_dist_quantile(d, 0.9), d->pt[d->n - 1].v);
+	}
+	if (show < HB_DICE_METRICS)
+		for (i = 0; i < dice.d[show].n; i++)
+			printf("%s=%g:P=%.6f\n", hb_dice_names[show],
+			       dice.d[show].pt[i].v, dice.d[show].pt[i].p);
+	hb_dice_free(&dice);
+	return 0;
+}
+
+/* proto [-t DATE] [-n TRIALS] [-s SEED] DESIGN [CONSTRAINT...]: prototype
+ * first, or order off the drawing board?
+ */
+static int cmd_proto(const struct entities *ent, int argc, char **argv)
+{
+	struct hb_proto o = {.trials = 1000000};
+	struct hb_constraint *cons = NULL;
+	struct hb_proto_result r;
+	struct tech_numbers tn;
+	char *date = NULL, *val;
+	struct hb_pool *pool;
+	struct bomber *b;
+	int rc, i;
+
+	while ((rc = next_opt(&argc, &argv, &val)))
+		switch (rc) {
+		case 't':
+			date = val;
+			break;
+		case 'n':
+			o.trials = strtoul(val, NULL, 0);
+			break;
+		case 's':
+			o.seed = atoi(val);
+			break;
+		default:
+			return -EINVAL;
+		}
+	if (argc < 1) {
+		fprintf(stderr, "Usage: hbuilder proto [-t YEAR[/MONTH]] [-n TRIALS] [-s SEED] DESIGN [CONSTRAINT...]\n");
+		return -EINVAL;
+	}
+	rc = parse_date(ent, date, &tn);
+	if (rc)
+		return rc;
+	b = malloc(sizeof(*b));
+	cons = calloc(argc, sizeof(*cons));
+	rc = b && cons ? load_design(ent, argv[0], b) : -ENOMEM;
+	if (rc)
+		goto out;
+	for (i = 1; i < argc; i++) {
+		rc = hb_parse_constraint(argv[i], cons + o.ncons++);
+		if (rc) {
+			fprintf(stderr, "Bad constraint '%s'\n", argv[i]);
+			goto out;
+		}
+	}
+	o.cons = cons;
+	rc = hb_pool_create(0, 0, &pool);
+	if (rc)
+		goto out;
+	rc = hb_proto_simulate(pool, b, &tn, &o, &r);
+	hb_pool_destroy(pool);
+	if (rc)
+		goto out;
+	printf("LEMON=%.6f:SE=%.6f:TRIALS=%lu\n", r.p_lemon, r.stderr_lemon,
+	       r.trials);
+	printf("GOOD:DF0=%g:DF1=%g:RNG=%g:ACC=%g:SRV=%g\n", r.defn[0],
+	       r.defn[1], r.range, r.accu, r.serv);
+	printf("DIRECT:COST=%.0f:DAYS=%.0f:SERVICE=%.6f:LEMON=%.6f\n",
+	       r.direct.cost, r.direct.days, r.direct.service, r.direct.lemon);
+	printf("PROTO:COST=%.0f:DAYS=%.0f:SERVICE=%.6f:LEMON=%.6f\n",
+	       r.proto.cost, r.proto.days, r.proto.service, r.proto.lemon);
+out:
+	free(cons);
+	free(b);
+	return rc;
+}
+
+/* payload [-t DATE] [-r grass|concrete] [-s STEP] DESIGN [DISTANCE...]:
+ * bomb load against range
+ */
+static int cmd_payload(const struct entities *ent, int argc, char **argv)
+{
+	static const char *const by[] = {
+		[HB_PAYLOAD_MTOW] = "MTOW",
+		[HB_PAYLOAD_RUNWAY] = "RUNWAY",
+		[HB_PAYLOAD_WING] = "WING",
+	};
+	char *date = NULL, *runway = "concrete", *val;
+	struct hb_payload_point pt;
+	struct tech_numbers tn;
+	struct hb_payload pr;
+	unsigned int step = 100;
+	struct bomber *b;
+	float dist;
+	int rc, i;
+
+	while ((rc = next_opt(&argc, &argv, &val)))
+		switch (rc) {
+		case 't':
+			date = val;
+			break;
+		case 'r':
+			runway = val;
+			break;
+		case 's':
+			step = strtoul(val, NULL, 0);
+			break;
+		default:
+			return -EINVAL;
+		}
+	if (argc < 1 || !step || (strcmp(runway, "grass") &&
+				  strcmp(runway, "concrete"))) {
+		fprintf(stderr, "Usage: hbuilder payload [-t YEAR[/MONTH]] [-r grass|concrete] [-s STEP] DESIGN [DISTANCE...]\n");
+		return -EINVAL;
+	}
+	rc = parse_date(ent, date, &tn);
+	if (rc)
+		return rc;
+	b = malloc(sizeof(*b));
+	rc = b ? load_design(ent, argv[0], b) : -ENOMEM;
+	if (!rc)
+		rc = hb_payload_init(&pr, b, &tn, !strcmp(runway, "concrete"));
+	free(b);
+	if (rc)
+		return rc;
+	printf("LIMIT=%u:BY=%s:RUNWAY=%s\n", pr.limit, by[pr.by],
+	       pr.concrete ? "CONCRETE" : "GRASS");
+	printf("MAXLOAD:LOAD=%u:PCT=%u:RANGE=%.0f\n", pr.maxload.load,
+	       pr.maxload.pct, pr.maxload.range);
+	printf("FULLFUEL:LOAD=%u:PCT=%u:RANGE=%.0f\n", pr.fullfuel.load,
+	       pr.fullfuel.pct, pr.fullfuel.range);
+	printf("FERRY:LOAD=%u:PCT=%u:RANGE=%.0f\n", pr.ferry.load,
+	       pr.ferry.pct, pr.ferry.range);
+	/* The given distances, or the whole curve every STEP miles */
+	for (i = 1; argc > 1 ? i < argc : step * i <= pr.ferry.range; i++) {
+		dist = argc > 1 ? atof(argv[i]) : step * i;
+		rc = hb_payload_at(&pr, dist, &pt);
+		if (rc == -ERANGE) {
+			printf("DIST=%g:OUT_OF_RANGE\n", dist);
+			continue;
+		}
+		if (rc)
+			break;
+		printf("DIST=%g:LOAD=%u:PCT=%u:RANGE=%.0f\n", dist, pt.load,
+		       pt.pct, pt.range);
+	}
+	fprintf(stderr, "%lu recalculations\n", pr.evals);
+	hb_payload_free(&pr);
+	return rc == -ERANGE ? 0 : rc;
+}
+
+/* timeline DESIGN|DIR...: each design in every month of the war, showing the
+ * months in which anything changes
+ */
+static int cmd_timeline(const struct entities *ent, int argc, char **argv)
+{
+	char line[512], last[512], tag[300];
+	struct hb_timeline_eval *res = NULL;
+	struct bomber *designs = NULL;
+	struct tech_numbers *tn;
+	struct hb_pool *pool;
+	char **names = NULL;
+	unsigned int m, j;
+	int rc, i, n = 0, legal;
+
+	if (argc < 1) {
+		fprintf(stderr, "Usage: hbuilder timeline DESIGN|DIR...\n");
+		return -EINVAL;
+	}
+	tn = malloc(HB_TIMELINE_MONTHS * sizeof(*tn));
+	if (!tn)
+		return -ENOMEM;
+	rc = hb_timeline_techs(ent, tn);
+	if (rc)
+		goto out;
+	n = load_designs(ent, argc, argv, &designs, &names);
+	if (n <= 0) {
+		rc = n;
+		n = 0;
+		goto out;
+	}
+	res = calloc((size_t)n * HB_TIMELINE_MONTHS, sizeof(*res));
+	if (!res) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	rc = hb_pool_create(0, 0, &pool);
+	if (rc)
+		goto out;
+	rc = hb_timeline(pool, designs, n, tn, res);
+	hb_pool_destroy(pool);
+	if (rc)
+		goto out;
+	for (i = 0; i < n; i++) {
+		const struct hb_timeline_eval *r = res + i * HB_TIMELINE_MONTHS;
+
+		legal = -1;
+		*last = 0;
+		for (m = 0; m < HB_TIMELINE_MONTHS; m++, r++) {
+			if (legal < 0 && !r->rc && !r->o.error)
+				legal = m;
+			/* Only the months where something changes */
+			hb_format_result(line, sizeof(line), "", r->rc, &r->o);
+			for (j = 0; j < r->new; j++)
+				snprintf(line + strlen(line),
+					 sizeof(line) - strlen(line), "%s",
+					 r->ew[j]);
+			if (!strcmp(line, last))
+				continue;
+			strcpy(last, line);
+			snprintf(tag, sizeof(tag), "%s@%u/%02u", names[i],
+				 HB_TIMELINE_FIRST + m / 12, m % 12 + 1);
+			hb_format_result(line, sizeof(line), tag, r->rc, &r->o);
+			fputs(line, stdout);
+			for (j = 0; j < r->new; j++)
+				printf("EW=%s", r->ew[j]);
+		}
+		if (legal < 0)
+			printf("LEGAL=%s:NEVER\n", names[i]);
+		else
+			printf("LEGAL=%s:FROM=%u/%02u\n", names[i],
+			       HB_TIMELINE_FIRST + legal / 12, legal % 12 + 1);
+	}
+out:
+	free(res);
+	free_names(names, n);
+	free(designs);
+	free(tn);
+	return rc;
+}
+
+/* techvalue [-t DATE] DESIGN|DIR... [min:METRIC|max:METRIC...]: what each tech
+ * that could be researched next would do for the designs
+ */
+static int cmd_techvalue(const struct entities *ent, int argc, char **argv)
+{
+	struct hb_goal goals[HB_MAX_GOALS];
+	unsigned int ngoals = 0, nd = 0, g;
+	struct hb_tech_value *val = NULL;
+	struct bomber *designs = NULL;
+	char *date = NULL, **names = NULL;
+	unsigned long rerun = 0;
+	struct tech_numbers tn;
+	struct hb_pool *pool;
+	int rc, i, nc, nf = 0;
+
+	while ((rc = next_opt(&argc, &argv, &date)))
+		if (rc != 't')
+			return -EINVAL;
+	/* Goals out, designs to the front */
+	for (i = 0; i < argc; i++) {
+		if (!strncmp(argv[i], "min:", 4) || !strncmp(argv[i], "max:", 4)) {
+			if (ngoals == HB_MAX_GOALS)
+				rc = -E2BIG;
+			else
+				rc = hb_parse_objective(argv[i], &goals[ngoals].m,
+							&goals[ngoals].maximise);
+			ngoals++;
+			if (rc) {
+				fprintf(stderr, "Bad goal '%s'\n", argv[i]);
+				return rc;
+			}
+			continue;
+		}
+		argv[nf++] = argv[i];
+	}
+	rc = nf ? load_designs(ent, nf, argv, &designs, &names) : 0;
+	if (rc < 0)
+		return rc;
+	nd = rc;
+	if (!nd) {
+		fprintf(stderr, "Usage: hbuilder techvalue [-t YEAR[/MONTH]] DESIGN|DIR... [min:METRIC|max:METRIC...]\n");
+		rc = -EINVAL;
+		goto out;
+	}
+	if (!ngoals) {
+		hb_parse_objective("min:defn0", &goals[0].m, &goals[0].maximise);
+		ngoals = 1;
+	}
+	rc = parse_date(ent, date, &tn);
+	if (rc)
+		goto out;
+	val = calloc(ent->ntech, sizeof(*val));
+	if (!val) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	rc = hb_pool_create(0, 0, &pool);
+	if (rc)
+		goto out;
+	nc = hb_tech_values(pool, ent, &tn, designs, nd, goals, ngoals, val);
+	hb_pool_destroy(pool);
+	if (nc < 0) {
+		rc = nc;
+		goto out;
+	}
+	for (i = 0; i < nc; i++) {
+		const struct tech *t = ent->tech[val[i].tech];
+
+		printf("TECH=%s:NAME=%s:STAGES=%u:FIXED=%u:BROKEN=%u", t->ident,
+		       t->name, CALC_STAGES - val[i].from, val[i].fixed,
+		       val[i].broken);
+		for (g = 0; g < ngoals; g++)
+			printf(":%s=%+.2f%%", goals[g].m->name,
+			       val[i].gain[g] * 100.0);
+		putchar('\n');
+		rerun += CALC_STAGES - val[i].from;
+	}
+	fprintf(stderr, "%d candidates, %lu of %lu stages re-run\n", nc,
+		rerun * nd, (unsigned long)nc * nd * CALC_STAGES);
+	rc = 0;
+out:
+	free(val);
+	free_names(names, nd);
+	free(designs);
+	return rc;
+}
+
+/* YEAR/MONTH of campaign month m, or NEVER */
+static const char *campaign_date(char *buf, size_t len, int m)
+{
+	if (m >= HB_CAMPAIGN_MONTHS)
+		return "NEVER";
+	m += HB_CAMPAIGN_MONTH;
+	snprintf(buf, len, "%u/%02u", HB_CAMPAIGN_YEAR + m / 12, m % 12 + 1);
+	return buf;
+}
+
+/* research [-n CAMPAIGNS] [-s SEED] [-f SUPPORT%] [-m META%] [-p TYPES]
+ * [-o FILE]: when each tech gets researched, over many campaigns
+ */
+static int cmd_research(const struct entities *ent, int argc, char **argv)
+{
+	static const double quantile[] = {0.1, 0.5, 0.9};
+	struct hb_research_sim o = {.campaigns = 1000000, .support = 50};
+	struct hb_research_result r;
+	char *out = NULL, *val, buf[3][16];
+	struct hb_pool *pool;
+	unsigned long done, sum, *h;
+	unsigned int t, m, q;
+	double t0;
+	FILE *f;
+	int rc;
+
+	while ((rc = next_opt(&argc, &argv, &val)))
+		switch (rc) {
+		case 'n':
+			o.campaigns = strtoul(val, NULL, 0);
+			break;
+		case 's':
+			o.seed = atoi(val);
+			break;
+		case 'f':
+			o.support = atoi(val);
+			break;
+		case 'm':
+			o.meta = atoi(val);
+			break;
+		case 'p':
+			o.types = atoi(val);
+			break;
+		case 'o':
+			out = val;
+			break;
+		default:
+			return -EINVAL;
+		}
+	if (argc) {
+		fprintf(stderr, "Usage: hbuilder research [-n CAMPAIGNS] [-s SEED] [-f SUPPORT%%] [-m META%%] [-p TYPES] [-o FILE]\n");
+		return -EINVAL;
+	}
+	rc = hb_pool_create(0, 0, &pool);
+	if (rc)
+		return rc;
+	t0 = seconds();
+	rc = hb_research_simulate(pool, ent, &o, &r);
+	t0 = seconds() - t0;
+	hb_pool_destroy(pool);
+	if (rc)
+		return rc;
+	fprintf(stderr, "%lu campaigns in %.2fs\n", r.campaigns, t0);
+	for (t = 0; t < r.ntech; t++) {
+		const struct tech *tech = ent->tech[t];
+
+		if (test_bit(r.start, t))
+			continue;
+		h = r.hist + t * (HB_CAMPAIGN_MONTHS + 1);
+		done = r.campaigns - h[HB_CAMPAIGN_MONTHS];
+		printf("TECH=%s:NAME=%s:DATED=%s:DONE=%.4f", tech->ident,
+		       tech->name, campaign_date(buf[0], sizeof(buf[0]),
+						 hb_campaign_month(tech)),
+		       (double)done / r.campaigns);
+		/* Quantiles over all campaigns, so NEVER if it's missed often */
+		for (q = 0, m = 0, sum = h[0]; q < ARRAY_SIZE(quantile); q++) {
+			while (m < HB_CAMPAIGN_MONTHS &&
+			       sum < quantile[q] * r.campaigns)
+				sum += h[++m];
+			printf(":P%.0f=%s", quantile[q] * 100,
+			       campaign_date(buf[q], sizeof(buf[q]), m));
+		}
+		putchar('\n');
+	}
+	printf("CAMPAIGNS=%lu:MOTHBALL=%.3f:PRODENG=%.3f\n", r.campaigns,
+	       r.mothball, r.prodeng);
+	if (out) {
+		f = fopen(out, "w");
+		if (!f) {
+			rc = -errno;
+			goto done;
+		}
+		/* Raw counts, month by month, then never */
+		for (t = 0; t < r.ntech; t++) {
+			if (test_bit(r.start, t))
+				continue;
+			h = r.hist + t * (HB_CAMPAIGN_MONTHS + 1);
+			fprintf(f, "%s", ent->tech[t]->ident);
+			for (m = 0; m <= HB_CAMPAIGN_MONTHS; m++)
+				fprintf(f, "%c%lu", m ? ',' : ':', h[m]);
+			fputc('\n', f);
+		}
+		if (fclose(f))
+			rc = -errno;
+	}
+done:
+	hb_research_free(&r);
+	return rc;
+}
+
+/* plan -t DATE [-m MANF] [-p POP] [-g GENS] [-w WIDTH] [-s SEED] [-o FILE]
+ *	min:METRIC|max:METRIC [CONSTRAINT...]: the research order that gives
+ *	the best design by DATE
+ */
+static int cmd_plan(const struct entities *ent, int argc, char **argv)
+{
+	struct hb_plan o = {.manf = ent->manf[0], .pop = 64, .gens = 10,
+			    .width = 4};
+	char *date = NULL, *out = NULL, *val, buf[16];
+	struct hb_constraint *cons;
+	struct hb_plan_result *r;
+	unsigned int year, month = 0, m, t;
+	struct hb_pool *pool;
+	int rc, i;
+
+	while ((rc = next_opt(&argc, &argv, &val)))
+		switch (rc) {
+		case 't':
+			date = val;
+			break;
+		case 'm':
+			o.manf = find_manf(ent, val);
+			if (!o.manf)
+				return -ENOENT;
+			break;
+		case 'p':
+			o.pop = atoi(val);
+			break;
+		case 'g':
+			o.gens = atoi(val);
+			break;
+		case 'w':
+			o.width = atoi(val);
+			break;
+		case 's':
+			o.seed = atoi(val);
+			break;
+		case 'o':
+			out = val;
+			break;
+		default:
+			return -EINVAL;
+		}
+	if (argc < 1 || !date || sscanf(date, "%u/%u", &year, &month) < 1 ||
+	    month > 12) {
+		fprintf(stderr, "Usage: hbuilder plan -t YEAR[/MONTH] [-m MANF] [-p POP] [-g GENS] [-w WIDTH] [-s SEED] [-o FILE] min:METRIC|max:METRIC [CONSTRAINT...]\n");
+		return -EINVAL;
+	}
+	o.months = hb_plan_months(year, month);
+	rc = hb_parse_objective(argv[0], &o.objective, &o.maximise);
+	if (rc) {
+		fprintf(stderr, "Bad objective '%s'\n", argv[0]);
+		return rc;
+	}
+	cons = calloc(argc, sizeof(*cons));
+	r = malloc(sizeof(*r));
+	if (!cons || !r) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	for (i = 1; i < argc; i++) {
+		rc = hb_parse_constraint(argv[i], cons + o.ncons++);
+		if (rc) {
+			fprintf(stderr, "Bad constraint '%s'\n", argv[i]);
+			goto out;
+		}
+	}
+	o.cons = cons;
+	rc = hb_pool_create(0, 0, &pool);
+	if (rc)
+		goto out;
+	rc = hb_plan_research(pool, ent, &o, r);
+	hb_pool_destroy(pool);
+	if (rc)
+		goto out;
+	for (m = 0; m < o.months; m++) {
+		t = r->order[m];
+		printf("PLAN=%s:", campaign_date(buf, sizeof(buf), m));
+		if (t == HB_PLAN_NONE)
+			printf("NONE\n");
+		else
+			printf("TECH=%s:NAME=%s\n", ent->tech[t]->ident,
+			       ent->tech[t]->name);
+	}
+	printf("BEST=%s:%s=%g%s\n", date, o.objective->name, r->best.value,
+	       r->best.violation ? ":INFEASIBLE" : "");
+	fprintf(stderr, "%lu tech states, %lu searched, %lu evaluations\n",
+		r->states, r->searches, r->evals);
+	rc = write_design(ent, &r->tn, &r->best.in, out);
+out:
+	free(r);
+	free(cons);
+	return rc;
+}
+
+static const char *sched_date(char *buf, size_t len, double day)
+{
+	unsigned int y, m, d;
+
+	if (isnan(day))
+		return "NEVER";
+	hb_sched_date(day, &y, &m, &d);
+	snprintf(buf, len, "%u/%02u/%02u", y, m, d);
+	return buf;
+}
+
+/* programme PLAN: when a programme of designs reaches service, and what it
+ * costs month by month.  Each line of PLAN is
+ *	YEAR/MONTH[/DAY] direct|proto DESIGN
+ * for a design ordered on that day (and evaluated with the techs of that
+ * month), off the drawing board or prototype first.
+ */
+static int cmd_programme(const struct entities *ent, int argc, char **argv)
+{
+	unsigned int n = 0, cap = 0, year, month, mday, i;
+	char line[512], mode[16], path[400], buf[2][16];
+	struct hb_sched_result r;
+	struct hb_order *orders = NULL, *o;
+	struct tech_numbers tn;
+	char (*paths)[400] = NULL;
+	double total = 0, t0;
+	struct bomber *b;
+	void *p;
+	FILE *f;
+	int rc = 0;
+
+	if (argc != 1) {
+		fprintf(stderr, "Usage: hbuilder programme PLAN\n");
+		return -EINVAL;
+	}
+	f = fopen(argv[0], "r");
+	if (!f)
+		return -errno;
+	b = malloc(sizeof(*b));
+	if (!b) {
+		fclose(f);
+		return -ENOMEM;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (*line == '#' || !line[strspn(line, " \t\n")])
+			continue;
+		mday = 1;
+		if (sscanf(line, "%u/%u%*[/]%u", &year, &month, &mday) < 2 ||
+		    sscanf(line, "%*s %15s %399s", mode, path) != 2 ||
+		    !month || month > 12 || (strcmp(mode, "direct") &&
+					     strcmp(mode, "proto")) ||
+		    hb_sched_day(year, month, mday) < 0) {
+			fprintf(stderr, "Bad plan line: %s", line);
+			rc = -EINVAL;
+			break;
+		}
+		if (n == cap) {
+			cap = cap ? cap * 2 : 64;
+			p = realloc(orders, cap * sizeof(*orders));
+			if (p)
+				orders = p;
+			p = p ? realloc(paths, cap * sizeof(*paths)) : NULL;
+			if (!p) {
+				rc = -ENOMEM;
+				break;
+			}
+			paths = p;
+		}
+		rc = hb_tech_date(ent, year, month, &tn);
+		if (rc)
+			break;
+		rc = load_design(ent, path, b);
+		if (!rc)
+			rc = hb_evaluate(b, &tn);
+		if (rc)
+			break;
+		strcpy(paths[n], path);
+		orders[n++] = (struct hb_order){
+			.manf = b->manf->idx,
+			.refit = b->refit != REFIT_FRESH,
+			.direct = !strcmp(mode, "direct"),
+			.release = hb_sched_day(year, month, mday),
+			.time = {b->tproto, b->tprod},
+			.cost = {b->cproto, b->cprod},
+		};
+	}
+	fclose(f);
+	free(b);
+	if (rc)
+		goto out;
+	t0 = seconds();
+	rc = hb_schedule(orders, n, ent->nmanf, &r);
+	if (rc)
+		goto out;
+	fprintf(stderr, "%u orders, %lu events in %.3fs\n", n, r.events,
+		seconds() - t0);
+	for (i = 0; i < n; i++) {
+		o = orders + i;
+		printf("ORDER=%u:DESIGN=%s:MANF=%s:%s:%s:PROTO=%s:SERVICE=%s:PAUSED=%u\n",
+		       i + 1, paths[i], ent->manf[o->manf]->ident,
+		       o->refit ? "REFIT" : "FRESH",
+		       o->direct ? "DIRECT" : "PROTOFIRST",
+		       sched_date(buf[0], sizeof(buf[0]), o->done[HB_SLOT_PROTO]),
+		       sched_date(buf[1], sizeof(buf[1]), o->service),
+		       o->paused);
+	}
+	for (i = 0; i < r.months; i++) {
+		if (!r.cash[i])
+			continue;
+		total += r.cash[i];
+		month = HB_CAMPAIGN_MONTH - 1 + i;
+		printf("CASH=%u/%02u:SPENT=%.0f:TOTAL=%.0f\n",
+		       HB_CAMPAIGN_YEAR + month / 12, month % 12 + 1, r.cash[i],
+		       total);
+	}
+	printf("END=%s:SPENT=%.0f\n", sched_date(buf[0], sizeof(buf[0]), r.end),
+	       r.spent);
+	hb_sched_free(&r);
+out:
+	free(paths);
+	free(orders);
+	return rc;
+}
+
+/* assign [-t DATE] [-d direct|proto] DESIGN|DIR...: which manufacturer should
+ * develop each design, to get them all into service soonest
+ */
+static int cmd_assign(const struct entities *ent, int argc, char **argv)
+{
+	unsigned int m, year, month = 1, j;
+	struct hb_order *orders = NULL;
+	struct hb_assignment res;
+	const struct hb_assign_pair *a;
+	struct hb_sched_result r;
+	struct tech_numbers tn;
+	struct bomber *designs;
+	struct hb_pool *pool;
+	char *date = NULL, *mode = "proto", *val, buf[16], **names;
+	double t0, release = 0;
+	int rc, i, n;
+
+	while ((rc = next_opt(&argc, &argv, &val)))
+		switch (rc) {
+		case 't':
+			date = val;
+			break;
+		case 'd':
+			mode = val;
+			break;
+		default:
+			return -EINVAL;
+		}
+	if (!argc || (strcmp(mode, "direct") && strcmp(mode, "proto"))) {
+		fprintf(stderr, "Usage: hbuilder assign [-t YEAR[/MONTH]] [-d direct|proto] DESIGN|DIR...\n");
+		return -EINVAL;
+	}
+	rc = parse_date(ent, date, &tn);
+	if (rc)
+		return rc;
+	if (date && sscanf(date, "%u/%u", &year, &month) >= 1)
+		release = max(hb_sched_day(year, month, 1), 0.0);
+	n = load_designs(ent, argc, argv, &designs, &names);
+	if (n <= 0)
+		return n;
+	rc = hb_pool_create(0, 0, &pool);
+	if (rc)
+		goto out;
+	t0 = seconds();
+	rc = hb_assign(pool, ent, &tn, designs, n, !strcmp(mode, "direct"),
+		       &res);
+	hb_pool_destroy(pool);
+	if (rc && rc != -ENOENT)
+		goto out;
+	fprintf(stderr, "%u pairs in %.3fs\n", res.n * res.nmanf,
+		seconds() - t0);
+	for (i = 0; i < n; i++) {
+		printf("DAYS=%s", names[i]);
+		for (m = 0; m < res.nmanf; m++) {
+			a = res.pair + i * res.nmanf + m;
+			if (a->ok)
+				printf(":%s=%.0f", ent->manf[m]->ident, a->days);
+			else
+				printf(":%s=-", ent->manf[m]->ident);
+		}
+		putchar('\n');
+	}
+	if (rc) {
+		fprintf(stderr, "No way to place every design\n");
+		rc = 0;
+		goto done;
+	}
+	if (!res.exact)
+		fprintf(stderr, "Search cut short; the best share found is shown\n");
+
+	/* Order them on the date, each manufacturer's in turn, to see when
+	 * the programme rules have them in service
+	 */
+	orders = calloc(n, sizeof(*orders));
+	if (!orders) {
+		rc = -ENOMEM;
+		goto done;
+	}
+	for (j = 0; j < n; j++) {
+		i = res.seq[j];
+		a = res.pair + i * res.nmanf + res.manf[i];
+		orders[j] = (struct hb_order){
+			.manf = res.manf[i],
+			.refit = designs[i].refit != REFIT_FRESH,
+			.direct = !strcmp(mode, "direct"),
+			.release = release,
+			.time = {a->tproto, a->tprod},
+		};
+	}
+	rc = hb_schedule(orders, n, ent->nmanf, &r);
+	if (rc)
+		goto done;
+	for (j = 0; j < n; j++) {
+		i = res.seq[j];
+		a = res.pair + i * res.nmanf + res.manf[i];
+		printf("ASSIGN=%s:MANF=%s:TPROTO=%.0f:TPROD=%.0f:DAYS=%.0f:START=%.0f:SERVICE=%s:COST=%.0f\n",
+		       names[i], ent->manf[res.manf[i]]->ident, a->tproto,
+		       a->tprod, a->days, res.start[i],
+		       sched_date(buf, sizeof(buf), orders[j].service),
+		       a->cost);
+	}
+	printf("FLEET=%.0f:TOTAL=%.0f:END=%s\n", res.makespan, res.total,
+	       sched_date(buf, sizeof(buf), r.end));
+	hb_sched_free(&r);
+done:
+	hb_assign_free(&res);
+out:
+	free(orders);
+	free_names(names, n);
+	free(designs);
+	return rc;
+}
+
+/* sortie [-t DATE] [-n RAIDS] [-s SEED] [-d MILES] [-f FIGHTERS] [-k FLAK]
+ * [-u off|on] DESIGN|DIR[:COUNT]...: losses and tonnage over many raids
+ */
+static int cmd_sortie(const struct entities *ent, int argc, char **argv)
+{
+	static const double quantile[] = {0.1, 0.5, 0.9, 0.99};
+	struct hb_sortie_sim o = {.raids = 100000, .dist = HB_SORTIE_DIST,
+				  .fighters = 1, .flak = 1};
+	const struct hb_sortie_type *st;
+	struct hb_sortie_result r;
+	struct tech_numbers tn;
+	unsigned int *count = NULL, *cn, cnt, q, k, n = 0;
+	struct bomber *designs = NULL, *d, *dn;
+	char *date = NULL, *val, *c, **names = NULL, **nm, **nn;
+	struct hb_pool *pool;
+	double t0, mean;
+	int i;
+	int rc;
+
+	while ((rc = next_opt(&argc, &argv, &val)))
+		switch (rc) {
+		case 't':
+			date = val;
+			break;
+		case 'n':
+			o.raids = strtoul(val, NULL, 0);
+			break;
+		case 's':
+			o.seed = atoi(val);
+			break;
+		case 'd':
+			o.dist = atof(val);
+			break;
+		case 'f':
+			o.fighters = atof(val);
+			break;
+		case 'k':
+			o.flak = atof(val);
+			break;
+		case 'u':
+			if (strcmp(val, "on") && strcmp(val, "off"))
+				return -EINVAL;
+			o.schrage = !strcmp(val, "on");
+			break;
+		default:
+			return -EINVAL;
+		}
+	if (!argc) {
+		fprintf(stderr, "Usage: hbuilder sortie [-t YEAR[/MONTH]] [-n RAIDS] [-s SEED] [-d MILES] [-f FIGHTERS] [-k FLAK] [-u off|on] DESIGN|DIR[:COUNT]...\n");
+		return -EINVAL;
+	}
+	rc = parse_date(ent, date, &tn);
+	if (rc)
+		return rc;
+	/* One argument at a time, as each has its own count */
+	for (i = 0; i < argc; i++) {
+		cnt = 20;
+		c = strrchr(argv[i], ':');
+		if (c) {
+			*c++ = 0;
+			cnt = strtoul(c, NULL, 0);
+		}
+		rc = load_designs(ent, 1, argv + i, &d, &nm);
+		if (rc < 0)
+			goto out;
+		k = rc;
+		dn = realloc(designs, (n + k + 1) * sizeof(*designs));
+		if (dn)
+			designs = dn;
+		nn = realloc(names, (n + k + 1) * sizeof(*names));
+		if (nn)
+			names = nn;
+		cn = realloc(count, (n + k + 1) * sizeof(*count));
+		if (cn)
+			count = cn;
+		if (!dn || !nn || !cn) {
+			free_names(nm, k);
+			free(d);
+			rc = -ENOMEM;
+			goto out;
+		}
+		memcpy(designs + n, d, k * sizeof(*d));
+		memcpy(names + n, nm, k * sizeof(*nm));
+		free(nm);
+		free(d);
+		for (; k; k--)
+			count[n++] = cnt;
+	}
+	for (k = 0; k < n; k++) {
+		rc = hb_evaluate(designs + k, &tn);
+		if (rc)
+			goto out;
+		if (designs[k].error) {
+			fprintf(stderr, "%s has errors\n", names[k]);
+			rc = -EINVAL;
+			goto out;
+		}
+		if (designs[k].range < o.dist) {
+			fprintf(stderr, "%s can't reach %.0f miles\n", names[k],
+				o.dist);
+			rc = -EDOM;
+			goto out;
+		}
+	}
+	if (!n)
+		goto out;
+	rc = hb_pool_create(0, 0, &pool);
+	if (rc)
+		goto out;
+	t0 = seconds();
+	rc = hb_sortie_simulate(pool, designs, count, n, &o, &r);
+	t0 = seconds() - t0;
+	hb_pool_destroy(pool);
+	if (rc)
+		goto out;
+	fprintf(stderr, "%lu raids, %lu sorties in %.2fs\n", r.raids,
+		r.sorties, t0);
+	for (k = 0; k < n; k++) {
+		st = r.type + k;
+		printf("TYPE=%s:COUNT=%u:SORTIES=%lu", names[k], count[k],
+		       st->sorties);
+		if (st->sorties)
+			printf(":ABORT=%.2f%%:FIGHTER=%.2f%%:FLAK=%.2f%%:HIT=%.2f%%:TONS=%.3f",
+			       st->aborts * 100.0 / st->sorties,
+			       st->fighter * 100.0 / st->sorties,
+			       st->flak * 100.0 / st->sorties,
+			       st->hits * 100.0 / st->sorties,
+			       st->tons / st->sorties);
+		putchar('\n');
+	}
+	printf("LOSS=%.2f%%", r.sorties ? r.lost * 100.0 / r.sorties : 0.0);
+	for (q = 0; q < ARRAY_SIZE(quantile); q++)
+		printf(":P%g=%.1f%%", quantile[q] * 100,
+		       hb_hist_quantile(r.loss, HB_SORTIE_LOSS_BINS + 1,
+					quantile[q]) * 100.0 /
+		       HB_SORTIE_LOSS_BINS);
+	for (k = 0, mean = 0; k < n; k++)
+		mean += r.type[k].tons / r.raids;
+	printf("\nTONS=%.1f", mean);
+	for (q = 0; q < ARRAY_SIZE(quantile); q++)
+		printf(":P%g=%.1f", quantile[q] * 100,
+		       hb_hist_quantile(r.tons, r.ntons, quantile[q]) *
+		       HB_SORTIE_TON_LB / 2240.0);
+	putchar('\n');
+	hb_sortie_free(&r);
+out:
+	free(count);
+	free_names(names, n);
+	free(designs);
+	return rc;
+}
+
+/* squadron [-t DATE] [-n RUNS] [-s SEED] [-a AIRCRAFT] [-d DAYS] [-g CREWS]
+ * [-r RAID%] [-m REPAIR] DESIGN|DIR...: how many aircraft are ready to fly
+ */
+static int cmd_squadron(const struct entities *ent, int argc, char **argv)
+{
+	static const double quantile[] = {0.1, 0.5, 0.9};
+	struct hb_squadron o = {.runs = 10000, .aircraft = 20, .days = 90,
+				.crews = 4, .raid = 50, .repair = 3};
+	struct hb_squadron_result *res = NULL, *sr;
+	unsigned int nd = 0, i, j, q, *order = NULL;
+	struct bomber *designs = NULL;
+	char **paths = NULL, *date = NULL, *val;
+	struct tech_numbers tn;
+	struct hb_pool *pool;
+	double t0;
+	int rc, np = 0;
+
+	while ((rc = next_opt(&argc, &argv, &val)))
+		switch (rc) {
+		case 't':
+			date = val;
+			break;
+		case 'n':
+			o.runs = strtoul(val, NULL, 0);
+			break;
+		case 's':
+			o.seed = atoi(val);
+			break;
+		case 'a':
+			o.aircraft = atoi(val);
+			break;
+		case 'd':
+			o.days = atoi(val);
+			break;
+		case 'g':
+			o.crews = atoi(val);
+			break;
+		case 'r':
+			o.raid = atoi(val);
+			break;
+		case 'm':
+			o.repair = atof(val);
+			break;
+		default:
+			return -EINVAL;
+		}
+	if (!argc) {
+		fprintf(stderr, "Usage: hbuilder squadron [-t YEAR[/MONTH]] [-n RUNS] [-s SEED] [-a AIRCRAFT] [-d DAYS] [-g CREWS] [-r RAID%%] [-m REPAIR] DESIGN|DIR...\n");
+		return -EINVAL;
+	}
+	rc = parse_date(ent, date, &tn);
+	if (rc)
+		return rc;
+	np = load_designs(ent, argc, argv, &designs, &paths);
+	if (np < 0)
+		return np;
+	res = calloc(max(np, 1), sizeof(*res));
+	order = calloc(max(np, 1), sizeof(*order));
+	if (!res || !order) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	/* Leaving out any with errors */
+	for (i = 0; i < np; i++) {
+		rc = hb_evaluate(designs + i, &tn);
+		if (rc || designs[i].error) {
+			fprintf(stderr, "%s: %s\n", paths[i],
+				rc ? strerror(-rc) : "design has errors");
+			continue;
+		}
+		/* Keeping paths[] in step with designs[] */
+		designs[nd] = designs[i];
+		val = paths[nd];
+		paths[nd] = paths[i];
+		paths[i] = val;
+		nd++;
+	}
+	rc = 0;
+	if (!nd)
+		goto out;
+	rc = hb_pool_create(0, 0, &pool);
+	if (rc)
+		goto out;
+	t0 = seconds();
+	rc = hb_squadron_simulate(pool, designs, nd, &o, res);
+	t0 = seconds() - t0;
+	hb_pool_destroy(pool);
+	if (rc)
+		goto out;
+	fprintf(stderr, "%u designs, %lu campaigns in %.2fs\n", nd,
+		nd * o.runs, t0);
+	/* Most ready first */
+	for (i = 0; i < nd; i++) {
+		for (j = i; j && res[order[j - 1]].mean < res[i].mean; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+	for (i = 0; i < nd; i++) {
+		sr = res + order[i];
+		printf("SQUADRON=%s:SERV=%.4f:FAIL=%.4f:ENGINEERS=%u:READY=%.2f",
+		       paths[order[i]], designs[order[i]].serv,
+		       designs[order[i]].fail,
+		       designs[order[i]].crew.engineers, sr->mean);
+		for (q = 0; q < ARRAY_SIZE(quantile); q++)
+			printf(":P%.0f=%u", quantile[q] * 100,
+			       hb_hist_quantile(sr->ready, sr->aircraft + 1,
+						quantile[q]));
+		printf(":AVAIL=%.2f%%:SORTIES=%lu:FAULTS=%.2f%%\n",
+		       sr->mean * 100.0 / sr->aircraft, sr->sorties,
+		       sr->sorties ? sr->faults * 100.0 / sr->sorties : 0.0);
+	}
+	hb_squadron_free(res, nd);
+out:
+	free_names(paths, np);
+	free(order);
+	free(res);
+	free(designs);
+	return rc;
+}
+
+/* Non-interactive modes, selected by the first command-line argument */
+struct command {
+	const char *name;
+	int (*fn)(const struct entities *ent, int argc, char **argv);
+} commands[] = {
+	{"serve", cmd_serve},
+	{"ring", cmd_ring},
+	{"batch", cmd_batch},
+	{"optimise", cmd_optimise},
+	{"pareto", cmd_pareto},
+	{"turrets", cmd_turrets},
+	{"crews", cmd_crews},
+	{"dice", cmd_dice},
+	{"proto", cmd_proto},
+	{"payload", cmd_payload},
+	{"timeline", cmd_timeline},
+	{"techvalue", cmd_techvalue},
+	{"research", cmd_research},
+	{"plan", cmd_plan},
+	{"programme", cmd_programme},
+	{"assign", cmd_assign},
+	{"sortie", cmd_sortie},
+	{"squadron", cmd_squadron},
+};
+
+static int run_command(const struct entities *ent, int argc, char **argv)
+{
+	unsigned int i;
+	int rc;
+
+	for (i = 0; i < ARRAY_SIZE(commands); i++)
+		if (!strcmp(argv[0], commands[i].name)) {
+			rc = commands[i].fn(ent, argc - 1, argv + 1);
+			if (rc < 0)
+				error(argv[0], rc);
+			return rc < 0 ? 1 : 0;
+		}
+	fprintf(stderr, "Unknown command '%s'\n", argv[0]);
+	return 2;
+}
+
+int main(int argc, char **argv)
+{
+	struct tech_numbers tn;
+	struct hb_data data;
+	struct bomber b;
+	int rc;
+
+	rc = hb_load(&data, ".");
 	if (rc < 0) {
-		error("Failed to create entity arrays", rc);
+		error("Failed to load data", rc);
 		return 1;
 	}
+	fprintf(stderr, "Loaded %u guns\n", data.ent.ngun);
+	fprintf(stderr, "Loaded %u engines\n", data.ent.neng);
+	fprintf(stderr, "Loaded %u manfs\n", data.ent.nmanf);
+	fprintf(stderr, "Loaded %u techs\n", data.ent.ntech);
 
-	empty_guns(&guns);
-	empty_engines(&engines);
-	empty_techs(&techs);
-	rc = apply_techs(&entities, &tn);
+	if (argc > 1) {
+		rc = run_command(&data.ent, argc - 1, argv + 1);
+		hb_free(&data);
+		return rc;
+	}
+
+	rc = hb_tech_base(&data.ent, &tn);
 	if (rc < 0) {
 		error("Failed to init techs", rc);
 		return 1;
 	}
 	fprintf(stderr, "Initialised tech state\n");
 
-	srand(time(NULL));
-
-	init_bomber(&b, list_first_entry(&manfs, struct manf),
-		    list_first_entry(&engines, struct engine));
-	rc = calc_bomber(&b, &tn);
+	rc = hb_new_design(&data.ent, &b);
+	if (!rc)
+		rc = hb_evaluate(&b, &tn);
 	if (rc < 0) {
 		error("Failed to update calcs", rc);
 		return 1;
 	}
 	fprintf(stderr, "Prepared blank bomber\n");
 
-	editor(&b, &tn, &entities);
+	editor(&b, &tn, &data.ent);
 
 	fprintf(stderr, "Cleaning up...\n");
-	free_techs(&techs);
-	free_guns(&guns);
-	free_engines(&engines);
-	free_manfs(&manfs);
+	hb_free(&data);
 	return 0;
 }
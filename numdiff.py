@@ -0,0 +1,52 @@
+#!/usr/bin/python
+# encoding: utf-8
+# numdiff.py TOL A B: compare two runs' KEY=value output line by line.
+# Numbers may differ by TOL relative (or absolute, near zero), or by one
+# in the last place printed, as rounding can flip it; everything else
+# must match exactly.  Exits 1, listing the differences, if not.
+import re
+import sys
+
+number = re.compile(r'^[-+]?(\d+\.?\d*|\.\d+)([eE][-+]?\d+)?%?$')
+
+def fields(line):
+    return re.split(r'([:=,\s])', line.rstrip('\n'))
+
+def last_place(x):
+    m = re.match(r'^[^.eE]*\.(\d*)', x)
+    return 10.0 ** -len(m.group(1)) if m else 1.0
+
+def close(x, y, tol):
+    ulp = max(last_place(x), last_place(y))
+    x, y = float(x.rstrip('%')), float(y.rstrip('%'))
+    return abs(x - y) <= max(tol * max(abs(x), abs(y), 1.0), ulp * 1.0001)
+
+def main(tol, a, b):
+    tol = float(tol)
+    bad = 0
+    with open(a) as fa, open(b) as fb:
+        la, lb = fa.readlines(), fb.readlines()
+    if len(la) != len(lb):
+        print('%s has %d lines, %s has %d' % (a, len(la), b, len(lb)))
+        return 1
+    for n, (x, y) in enumerate(zip(la, lb), 1):
+        fx, fy = fields(x), fields(y)
+        ok = len(fx) == len(fy)
+        for u, v in zip(fx, fy) if ok else ():
+            if u == v:
+                continue
+            if not (number.match(u) and number.match(v) and close(u, v, tol)):
+                ok = False
+                break
+        if not ok:
+            bad += 1
+            sys.stdout.write('%d< %s%d> %s' % (n, x, n, y))
+    if bad:
+        print('%d lines differ by more than %s' % (bad, tol))
+    return 1 if bad else 0
+
+if __name__ == '__main__':
+    if len(sys.argv) != 4:
+        sys.stderr.write('Usage: numdiff.py TOL A B\n')
+        sys.exit(2)
+    sys.exit(main(*sys.argv[1:]))
@@ -0,0 +1,620 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "opt.h"
+
+static float get_cost(const struct bomber *b) { return b->cost; }
+static float get_cproto(const struct bomber *b) { return b->cproto; }
+static float get_cprod(const struct bomber *b) { return b->cprod; }
+static float get_tproto(const struct bomber *b) { return b->tproto; }
+static float get_tprod(const struct bomber *b) { return b->tprod; }
+static float get_defn0(const struct bomber *b) { return b->defn[0]; }
+static float get_defn1(const struct bomber *b) { return b->defn[1]; }
+static float get_ff0(const struct bomber *b) { return b->fight_factor[0]; }
+static float get_ff1(const struct bomber *b) { return b->fight_factor[1]; }
+static float get_flak(const struct bomber *b) { return b->flak_factor; }
+static float get_range(const struct bomber *b) { return b->range; }
+static float get_load(const struct bomber *b) { return b->bay.load; }
+static float get_accu(const struct bomber *b) { return b->accu; }
+static float get_serv(const struct bomber *b) { return b->serv; }
+static float get_fail(const struct bomber *b) { return b->fail; }
+static float get_vuln(const struct bomber *b) { return b->vuln; }
+static float get_ceiling(const struct bomber *b) { return b->ceiling; }
+static float get_speed(const struct bomber *b) { return b->cruise_spd; }
+static float get_deck(const struct bomber *b) { return b->deck_spd; }
+static float get_climb(const struct bomber *b) { return b->init_climb; }
+static float get_takeoff(const struct bomber *b) { return b->takeoff_spd; }
+static float get_gross(const struct bomber *b) { return b->gross; }
+static float get_tare(const struct bomber *b) { return b->tare; }
+static float get_errors(const struct bomber *b) { return b->error; }
+
+static float get_cplm(const struct bomber *b)
+{
+	float lm = b->bay.load * b->range;
+
+	return lm > 0.0f ? b->cost * 1e6f / lm : INFINITY;
+}
+
+/* As calc_perf's runway warnings */
+static float get_runway(const struct bomber *b)
+{
+	return floor(b->gross) <= b->tn.rgg * 1000 &&
+	       b->takeoff_spd - 0.1 <= b->tn.rgs;
+}
+
+static float get_concrete(const struct bomber *b)
+{
+	return b->tn.rcs && floor(b->gross) <= b->tn.rcg * 1000 &&
+	       b->takeoff_spd - 0.1 <= b->tn.rcs;
+}
+
+const struct hb_metric hb_metrics[] = {
+	{"cost", get_cost, "Unit cost"},
+	{"cproto", get_cproto, "Prototype cost"},
+	{"cprod", get_cprod, "Production tooling cost"},
+	{"tproto", get_tproto, "Prototype development time"},
+	{"tprod", get_tprod, "Production development time"},
+	{"defn0", get_defn0, "Losses (defn) vs. early fighters"},
+	{"defn1", get_defn1, "Losses (defn) vs. late fighters"},
+	{"ff0", get_ff0, "Fighter factor, early"},
+	{"ff1", get_ff1, "Fighter factor, late"},
+	{"flak", get_flak, "Flak factor"},
+	{"range", get_range, "Range, miles"},
+	{"load", get_load, "Bomb load, lb"},
+	{"accu", get_accu, "Bombing accuracy"},
+	{"serv", get_serv, "Serviceability"},
+	{"fail", get_fail, "Failure rate"},
+	{"vuln", get_vuln, "Vulnerability"},
+	{"ceiling", get_ceiling, "Ceiling, thousands ft"},
+	{"speed", get_speed, "Cruising speed, mph"},
+	{"deck", get_deck, "Speed at sea level, mph"},
+	{"climb", get_climb, "Initial climb, ft/min"},
+	{"takeoff", get_takeoff, "Take-off speed, mph"},
+	{"gross", get_gross, "Gross weight, lb"},
+	{"tare", get_tare, "Tare weight, lb"},
+	{"cplm", get_cplm, "Cost per million bomb-lb-miles"},
+	{"runway", get_runway, "1 if it can use grass runways, else 0"},
+	{"concrete", get_concrete, "1 if it can use concrete runways, else 0"},
+	{"errors", get_errors, "1 if the design has errors, else 0"},
+};
+const unsigned int hb_nmetrics = ARRAY_SIZE(hb_metrics);
+
+const struct hb_metric *hb_find_metric(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < hb_nmetrics; i++)
+		if (!strcmp(name, hb_metrics[i].name))
+			return hb_metrics + i;
+	return NULL;
+}
+
+int hb_parse_objective(const char *s, const struct hb_metric **m,
+		       bool *maximise)
+{
+	if (!strncmp(s, "min:", 4))
+		*maximise = false;
+	else if (!strncmp(s, "max:", 4))
+		*maximise = true;
+	else
+		return -EINVAL;
+	*m = hb_find_metric(s + 4);
+	return *m ? 0 : -ENOENT;
+}
+
+int hb_parse_constraint(const char *s, struct hb_constraint *c)
+{
+	size_t len = strcspn(s, "<>");
+	char name[32];
+	char *end;
+
+	if (len >= sizeof(name))
+		return -EINVAL;
+	memcpy(name, s, len);
+	name[len] = 0;
+	c->m = hb_find_metric(name);
+	if (!c->m)
+		return -ENOENT;
+	if (!s[len]) {
+		c->le = false;
+		c->value = 1.0f;
+		return 0;
+	}
+	if (s[len + 1] != '=')
+		return -EINVAL;
+	c->le = s[len] == '<';
+	c->value = strtof(s + len + 2, &end);
+	if (end == s + len + 2 || *end)
+		return -EINVAL;
+	return 0;
+}
+
+float hb_violation(const struct bomber *b, const struct hb_constraint *cons,
+		   unsigned int ncons)
+{
+	float v = b->error ? 100.0f : 0.0f;
+	unsigned int i;
+
+	/* Shortfalls are relative, so that constraints in different units
+	 * are weighed comparably
+	 */
+	for (i = 0; i < ncons; i++) {
+		const struct hb_constraint *c = cons + i;
+		float x = c->m->get(b), d;
+
+		d = c->le ? x - c->value : c->value - x;
+		if (d > 0.0f || isnan(d))
+			v += isfinite(d) ? d / max(fabsf(c->value), 1.0f)
+					 : 100.0f;
+	}
+	return v;
+}
+
+/* Search space and operators */
+
+static unsigned int irand(unsigned int *seed, unsigned int n)
+{
+	return n ? rand_r(seed) % n : 0;
+}
+
+static float frand(unsigned int *seed)
+{
+	return rand_r(seed) / (RAND_MAX + 1.0f);
+}
+
+/* Scales v by a random factor in [1/(1+spread), 1+spread] */
+static unsigned int jiggle(unsigned int v, float spread, unsigned int lo,
+			   unsigned int hi, unsigned int *seed)
+{
+	float f = powf(1.0f + spread, frand(seed) * 2.0f - 1.0f);
+	unsigned int n = lrintf(v * f);
+
+	if (n == v) /* make sure small values can still move */
+		n = v && irand(seed, 2) ? v - 1 : v + 1;
+	return min(max(n, lo), hi);
+}
+
+#define WING_MIN	100
+#define WING_MAX	3000
+#define ART_MIN		40
+#define ART_MAX		140
+#define HLB_MIN		5
+#define HLB_MAX		400
+#define BAY_MAX		25000
+#define BAY_STEP	250
+
+void hb_space_init(struct hb_space *s, const struct entities *ent,
+		   const struct tech_numbers *tn, const struct manf *manf)
+{
+	unsigned int i;
+
+	memset(s, 0, sizeof(*s));
+	s->ent = ent;
+	s->tn = tn;
+	s->manf = manf;
+	for (i = 0; i < ent->neng; i++)
+		if (test_bit(tn->eng, i))
+			s->eng[s->neng++] = i;
+	for (i = 0; i < ent->ngun; i++) {
+		unsigned int l = ent->gun[i]->lxn;
+
+		if (test_bit(tn->gun, i))
+			s->gun[l][s->ngun[l]++] = i;
+	}
+	s->max_engines = tn->g4c && tn->g4t ? 4 : 3;
+}
+
+static void random_engines(const struct hb_space *s, struct hb_design_in *in,
+			   unsigned int *seed)
+{
+	in->eng_typ = in->eng_mou = s->eng[irand(seed, s->neng)];
+	in->eng_number = 1 + irand(seed, s->max_engines);
+	in->egg = s->tn->ees && irand(seed, 2);
+}
+
+static void random_turret(const struct hb_space *s, struct hb_design_in *in,
+			  unsigned int l, unsigned int *seed)
+{
+	unsigned int n = s->ngun[l];
+
+	if (!n || irand(seed, 2))
+		in->tur_typ[l] = HB_NONE;
+	else
+		in->tur_typ[l] = s->gun[l][irand(seed, n)];
+	in->tur_mou[l] = in->tur_typ[l];
+}
+
+static unsigned int count_turrets(const struct hb_design_in *in)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < LXN_COUNT; i++)
+		n += in->tur_typ[i] != HB_NONE;
+	return n;
+}
+
+static void add_crew(struct hb_design_in *in, enum crewpos pos,
+		     unsigned int n, unsigned int *seed)
+{
+	while (n-- && in->crew_n < MAX_CREW) {
+		unsigned char c = pos;
+
+		if (pos != CCLASS_E && pos != CCLASS_G && !irand(seed, 4))
+			c |= HB_CREW_GUN;
+		in->crew[in->crew_n++] = c;
+	}
+}
+
+/* Crew is kept sorted by position, as the editor does */
+static void random_crew(const struct hb_space *s, struct hb_design_in *in,
+			unsigned int *seed)
+{
+	unsigned int t = count_turrets(in);
+
+	in->crew_n = 0;
+	add_crew(in, CCLASS_P, 1 + irand(seed, 2), seed);
+	add_crew(in, CCLASS_N, 1, seed);
+	add_crew(in, CCLASS_B, irand(seed, 2), seed);
+	add_crew(in, CCLASS_W, irand(seed, 2), seed);
+	add_crew(in, CCLASS_E, in->eng_number > 2 ? irand(seed, 2) : 0, seed);
+	add_crew(in, CCLASS_G, irand(seed, t + 1), seed);
+}
+
+static void random_bay(const struct hb_space *s, struct hb_design_in *in,
+		       unsigned int *seed)
+{
+	do
+		in->girth = irand(seed, BB_COUNT);
+	while (!s->tn->bt[in->girth] && in->girth);
+	in->bay_cap = BAY_STEP * (1 + irand(seed, BAY_MAX / BAY_STEP));
+	in->bay_load = in->bay_cap;
+	in->csbs = s->tn->csb && irand(seed, 2);
+}
+
+static void random_fuse(const struct hb_space *s, struct hb_design_in *in,
+			unsigned int *seed)
+{
+	in->fuse = irand(seed, s->manf->geo ? FT_COUNT : FT_GEODETIC);
+}
+
+static void random_elec(const struct hb_space *s, struct hb_design_in *in,
+			unsigned int *seed)
+{
+	unsigned int i;
+
+	in->esl = irand(seed, s->tn->esl + 1);
+	in->navaid = 0;
+	for (i = 0; i < NA_COUNT; i++)
+		if (s->tn->na[i] && irand(seed, 2))
+			in->navaid |= 1 << i;
+}
+
+static void random_tanks(const struct hb_space *s, struct hb_design_in *in,
+			 unsigned int *seed)
+{
+	in->tank_hlb = HLB_MIN + irand(seed, HLB_MAX / 2 - HLB_MIN);
+	in->tank_pct = 100;
+	in->sst = s->tn->sft && irand(seed, 2);
+}
+
+void hb_design_random(const struct hb_space *s, struct hb_design_in *in,
+		      unsigned int *seed)
+{
+	unsigned int i;
+
+	memset(in, 0, sizeof(*in));
+	memcpy(in->tech, s->tn->tech, sizeof(in->tech));
+	in->manf = s->manf->idx;
+	random_engines(s, in, seed);
+	for (i = 0; i < LXN_COUNT; i++)
+		random_turret(s, in, i, seed);
+	in->wing_area = WING_MIN + irand(seed, WING_MAX / 2 - WING_MIN);
+	in->wing_art = 50 + irand(seed, 60);
+	random_crew(s, in, seed);
+	random_bay(s, in, seed);
+	random_fuse(s, in, seed);
+	random_elec(s, in, seed);
+	random_tanks(s, in, seed);
+}
+
+enum gene {
+	G_ENGINES,
+	G_TURRETS,
+	G_WING,
+	G_CREW,
+	G_BAY,
+	G_FUSE,
+	G_ELEC,
+	G_TANKS,
+	G_MTOW,
+
+	G_COUNT
+};
+
+void hb_design_mutate(const struct hb_space *s, struct hb_design_in *in,
+		      float rate, unsigned int *seed)
+{
+	unsigned int g, i, changed = 0;
+
+	/* Always change something, so children aren't clones */
+	while (!changed)
+		for (g = 0; g < G_COUNT; g++) {
+			if (frand(seed) >= rate)
+				continue;
+			changed++;
+			switch (g) {
+			case G_ENGINES:
+				switch (irand(seed, 3)) {
+				case 0:
+					random_engines(s, in, seed);
+					break;
+				case 1:
+					in->eng_number = 1 + irand(seed, s->max_engines);
+					break;
+				default:
+					in->eng_typ = in->eng_mou =
+						s->eng[irand(seed, s->neng)];
+				}
+				break;
+			case G_TURRETS:
+				random_turret(s, in, irand(seed, LXN_COUNT),
+					      seed);
+				break;
+			case G_WING:
+				if (irand(seed, 2))
+					in->wing_area = jiggle(in->wing_area,
+							       0.15f, WING_MIN,
+							       WING_MAX, seed);
+				else
+					in->wing_art = jiggle(in->wing_art,
+							      0.1f, ART_MIN,
+							      ART_MAX, seed);
+				break;
+			case G_CREW:
+				if (in->crew_n && irand(seed, 2)) {
+					i = irand(seed, in->crew_n);
+					if ((in->crew[i] & ~HB_CREW_GUN) < CCLASS_E)
+						in->crew[i] ^= HB_CREW_GUN;
+				} else {
+					random_crew(s, in, seed);
+				}
+				break;
+			case G_BAY:
+				switch (irand(seed, 4)) {
+				case 0:
+					random_bay(s, in, seed);
+					break;
+				case 1:
+					in->bay_cap = jiggle(in->bay_cap / BAY_STEP,
+							     0.2f, 1,
+							     BAY_MAX / BAY_STEP,
+							     seed) * BAY_STEP;
+					in->bay_load = in->bay_cap;
+					break;
+				case 2:
+					in->bay_load = in->bay_cap / BAY_STEP ?
+						       BAY_STEP * irand(seed, in->bay_cap / BAY_STEP + 1) :
+						       0;
+					break;
+				default:
+					in->csbs = s->tn->csb && !in->csbs;
+				}
+				break;
+			case G_FUSE:
+				random_fuse(s, in, seed);
+				break;
+			case G_ELEC:
+				random_elec(s, in, seed);
+				break;
+			case G_TANKS:
+				if (irand(seed, 3)) {
+					in->tank_hlb = jiggle(in->tank_hlb,
+							      0.2f, HLB_MIN,
+							      HLB_MAX, seed);
+					in->tank_pct = 100;
+				} else {
+					in->sst = s->tn->sft && !in->sst;
+				}
+				break;
+			case G_MTOW:
+				/* Mostly leave it to calc_perf */
+				if (in->user_mtow || irand(seed, 4)) {
+					in->user_mtow = false;
+				} else if (in->mtow) {
+					in->user_mtow = true;
+					in->mtow = jiggle(in->mtow, 0.1f,
+							  in->mtow * 9 / 10,
+							  in->mtow * 5 / 4,
+							  seed);
+				}
+				break;
+			}
+		}
+}
+
+void hb_design_cross(const struct hb_design_in *a,
+		     const struct hb_design_in *b, struct hb_design_in *child,
+		     unsigned int *seed)
+{
+	const struct hb_design_in *p;
+	unsigned int i;
+
+	*child = *a;
+	if (irand(seed, 2)) {
+		child->eng_typ = b->eng_typ;
+		child->eng_mou = b->eng_mou;
+		child->eng_number = b->eng_number;
+		child->egg = b->egg;
+	}
+	for (i = 0; i < LXN_COUNT; i++)
+		if (irand(seed, 2)) {
+			child->tur_typ[i] = b->tur_typ[i];
+			child->tur_mou[i] = b->tur_mou[i];
+		}
+	if (irand(seed, 2)) {
+		child->wing_area = b->wing_area;
+		child->wing_art = b->wing_art;
+	}
+	if (irand(seed, 2)) {
+		child->crew_n = b->crew_n;
+		memcpy(child->crew, b->crew, sizeof(child->crew));
+	}
+	if (irand(seed, 2)) {
+		child->girth = b->girth;
+		child->bay_cap = b->bay_cap;
+		child->bay_load = b->bay_load;
+		child->csbs = b->csbs;
+	}
+	if (irand(seed, 2))
+		child->fuse = b->fuse;
+	if (irand(seed, 2)) {
+		child->esl = b->esl;
+		child->navaid = b->navaid;
+	}
+	if (irand(seed, 2)) {
+		child->tank_hlb = b->tank_hlb;
+		child->tank_pct = b->tank_pct;
+		child->sst = b->sst;
+	}
+	p = irand(seed, 2) ? a : b;
+	child->user_mtow = p->user_mtow;
+	child->mtow = p->mtow;
+}
+
+/* The GA */
+
+struct indiv {
+	struct hb_design_in in;
+	float value, violation;
+	unsigned int mtow; /* as evaluated, for G_MTOW to start from */
+};
+
+struct ga {
+	const struct hb_opt *o;
+	struct indiv *pop;
+};
+
+static int ga_eval(void *ctx, struct hb_worker *w, unsigned long i)
+{
+	struct ga *ga = ctx;
+	const struct hb_opt *o = ga->o;
+	struct indiv *d = ga->pop + i;
+	struct hb_result res;
+
+	hb_eval_packed(o->space->ent, w, &d->in, &res);
+	if (res.rc) {
+		d->value = NAN;
+		d->violation = INFINITY;
+		return 0;
+	}
+	d->value = o->objective->get(&w->b);
+	if (!o->maximise)
+		d->value = -d->value;
+	d->violation = hb_violation(&w->b, o->cons, o->ncons);
+	if (isnan(d->value))
+		d->violation = INFINITY;
+	d->mtow = w->b.mtow;
+	return 0;
+}
+
+/* Feasible beats infeasible; then less violation; then better value */
+static bool better(const struct indiv *a, const struct indiv *b)
+{
+	if (a->violation != b->violation)
+		return a->violation < b->violation;
+	return a->value > b->value;
+}
+
+static int cmp_indiv(const void *a, const void *b)
+{
+	if (better(a, b))
+		return -1;
+	return better(b, a) ? 1 : 0;
+}
+
+static const struct indiv *tournament(const struct indiv *pop,
+				      unsigned int n, unsigned int *seed)
+{
+	const struct indiv *a = pop + irand(seed, n);
+	const struct indiv *b = pop + irand(seed, n);
+
+	return better(b, a) ? b : a;
+}
+
+#define ELITE	2
+
+int hb_optimise(struct hb_pool *p, const struct hb_opt *o,
+		struct hb_opt_best *best)
+{
+	unsigned int n = max(o->pop, ELITE + 2), seed = o->seed, gen, i;
+	struct indiv *pop, *next;
+	struct ga ga = {.o = o};
+	int rc;
+
+	if (!o->space->neng)
+		return -ENOENT;
+	pop = calloc(n, sizeof(*pop));
+	next = calloc(n, sizeof(*next));
+	if (!pop || !next) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	memset(best, 0, sizeof(*best));
+	best->violation = INFINITY;
+	for (i = 0; i < n; i++)
+		hb_design_random(o->space, &pop[i].in, &seed);
+	for (i = 0; i < min(o->nstart, n); i++) {
+		pop[i].in = o->start[i];
+		memcpy(pop[i].in.tech, o->space->tn->tech, sizeof(pop[i].in.tech));
+	}
+	for (gen = 0; gen <= o->gens; gen++) {
+		struct indiv *t;
+
+		ga.pop = pop;
+		rc = hb_parallel_for(p, n, 1, ga_eval, &ga);
+		if (rc)
+			goto out;
+		best->evals += n;
+		qsort(pop, n, sizeof(*pop), cmp_indiv);
+		if (pop[0].violation < best->violation ||
+		    (pop[0].violation == best->violation &&
+		     pop[0].value > (o->maximise ? best->value
+						 : -best->value))) {
+			best->in = pop[0].in;
+			best->value = o->maximise ? pop[0].value
+						  : -pop[0].value;
+			best->violation = pop[0].violation;
+			best->gen = gen;
+			if (o->progress)
+				o->progress(o->ctx, best);
+		}
+		if (gen == o->gens)
+			break;
+		/* Breed the next generation */
+		for (i = 0; i < ELITE; i++)
+			next[i] = pop[i];
+		for (; i < n; i++) {
+			const struct indiv *a = tournament(pop, n, &seed);
+			const struct indiv *b = tournament(pop, n, &seed);
+
+			if (irand(&seed, 4))
+				hb_design_cross(&a->in, &b->in, &next[i].in,
+						&seed);
+			else
+				next[i].in = a->in;
+			if (!next[i].in.user_mtow)
+				next[i].in.mtow = a->mtow;
+			hb_design_mutate(o->space, &next[i].in,
+					 1.5f / G_COUNT, &seed);
+		}
+		t = pop;
+		pop = next;
+		next = t;
+	}
+	rc = 0;
+out:
+	free(next);
+	free(pop);
+	return rc;
+}
@@ -0,0 +1,99 @@
+#ifndef _OPT_H
+#define _OPT_H
+
+/* Automatic design search.
+ *
+ * Designs are measured by metrics, named functions of an evaluated bomber
+ * (see hb_metrics[]).  An objective is a metric to minimise or maximise,
+ * written "min:cost" or "max:range"; a constraint is a metric bound,
+ * written "range>=600" or "cost<=20000", or a bare name like "runway"
+ * meaning that metric must be at least 1.  A design with errors never
+ * satisfies the constraints.
+ *
+ * The searches work on packed designs (struct hb_design_in), using
+ * hb_design_random(), hb_design_mutate() and hb_design_cross() to make
+ * new ones.  These only vary the inputs of a clean-sheet design for one
+ * manufacturer, and only pick engines, turrets and so on that the tech
+ * state has unlocked.
+ */
+
+#include "hbuilder.h"
+#include "pool.h"
+
+struct hb_metric {
+	const char *name;
+	float (*get)(const struct bomber *b);
+	const char *desc;
+};
+
+extern const struct hb_metric hb_metrics[];
+extern const unsigned int hb_nmetrics;
+
+const struct hb_metric *hb_find_metric(const char *name);
+
+struct hb_constraint {
+	const struct hb_metric *m;
+	bool le; /* metric <= value, else metric >= value */
+	float value;
+};
+
+int hb_parse_objective(const char *s, const struct hb_metric **m,
+		       bool *maximise);
+int hb_parse_constraint(const char *s, struct hb_constraint *c);
+/* How far b is from meeting the constraints; 0 if it meets them */
+float hb_violation(const struct bomber *b, const struct hb_constraint *cons,
+		   unsigned int ncons);
+
+/* What a search may vary */
+struct hb_space {
+	const struct entities *ent;
+	const struct tech_numbers *tn;
+	const struct manf *manf;
+	/* built by hb_space_init() */
+	unsigned int neng, eng[MAX_ENGINES];
+	unsigned int ngun[LXN_COUNT], gun[LXN_COUNT][MAX_GUNS];
+	unsigned int max_engines;
+};
+
+void hb_space_init(struct hb_space *s, const struct entities *ent,
+		   const struct tech_numbers *tn, const struct manf *manf);
+void hb_design_random(const struct hb_space *s, struct hb_design_in *in,
+		      unsigned int *seed);
+/* Changes each group of related inputs with probability rate */
+void hb_design_mutate(const struct hb_space *s, struct hb_design_in *in,
+		      float rate, unsigned int *seed);
+/* Child takes each group of related inputs from one parent or the other */
+void hb_design_cross(const struct hb_design_in *a,
+		     const struct hb_design_in *b, struct hb_design_in *child,
+		     unsigned int *seed);
+
+/* Single-objective search, with a generational GA */
+struct hb_opt_best {
+	struct hb_design_in in;
+	float value; /* of the objective */
+	float violation; /* 0 if feasible */
+	unsigned int gen, evals;
+};
+
+struct hb_opt {
+	const struct hb_space *space;
+	const struct hb_metric *objective;
+	bool maximise;
+	const struct hb_constraint *cons;
+	unsigned int ncons;
+	unsigned int pop, gens;
+	unsigned int seed;
+	/* Designs to start from, in place of as many random ones; their
+	 * techs are taken to be the space's
+	 */
+	const struct hb_design_in *start;
+	unsigned int nstart;
+	/* Called from the calling thread whenever the best design improves */
+	void (*progress)(void *ctx, const struct hb_opt_best *best);
+	void *ctx;
+};
+
+int hb_optimise(struct hb_pool *p, const struct hb_opt *o,
+		struct hb_opt_best *best);
+
+#endif // _OPT_H
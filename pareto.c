@@ -0,0 +1,446 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "pareto.h"
+
+#define ND_LEAF		20 /* points in a leaf before it splits */
+#define ND_BRANCH	6 /* children of a split leaf */
+
+struct nd_node {
+	struct nd_node *parent;
+	float ideal[HB_PARETO_MAX_OBJ], nadir[HB_PARETO_MAX_OBJ];
+	bool leaf;
+	unsigned int n; /* children, or points if leaf */
+	union {
+		struct nd_node *child[ND_BRANCH];
+		unsigned int pt[ND_LEAF + 1];
+	};
+};
+
+struct point {
+	float obj[HB_PARETO_MAX_OBJ];
+	struct nd_node *leaf;
+	struct hb_design_in in;
+};
+
+struct hb_pareto {
+	unsigned int nobj;
+	struct nd_node *root;
+	/* The front, densely packed; leaves hold indices into it */
+	struct point *pts;
+	unsigned int npts, size;
+};
+
+int hb_pareto_create(unsigned int nobj, struct hb_pareto **a)
+{
+	if (!nobj || nobj > HB_PARETO_MAX_OBJ)
+		return -EINVAL;
+	*a = calloc(1, sizeof(**a));
+	if (!*a)
+		return -ENOMEM;
+	(*a)->nobj = nobj;
+	return 0;
+}
+
+static void free_node(struct nd_node *n)
+{
+	unsigned int i;
+
+	if (!n->leaf)
+		for (i = 0; i < n->n; i++)
+			free_node(n->child[i]);
+	free(n);
+}
+
+void hb_pareto_destroy(struct hb_pareto *a)
+{
+	if (a->root)
+		free_node(a->root);
+	free(a->pts);
+	free(a);
+}
+
+unsigned int hb_pareto_size(const struct hb_pareto *a)
+{
+	return a->npts;
+}
+
+const struct hb_design_in *hb_pareto_get(const struct hb_pareto *a,
+					 unsigned int i, const float **obj)
+{
+	if (i >= a->npts)
+		return NULL;
+	if (obj)
+		*obj = a->pts[i].obj;
+	return &a->pts[i].in;
+}
+
+/* x is no worse than y in every objective */
+static bool covers(const float *x, const float *y, unsigned int nobj)
+{
+	unsigned int i;
+
+	for (i = 0; i < nobj; i++)
+		if (x[i] > y[i])
+			return false;
+	return true;
+}
+
+/* Removes an empty node, and any ancestors it leaves empty */
+static void unlink_node(struct hb_pareto *a, struct nd_node *n)
+{
+	struct nd_node *p = n->parent;
+	unsigned int i;
+
+	free(n);
+	if (!p) {
+		a->root = NULL;
+		return;
+	}
+	for (i = 0; i < p->n; i++)
+		if (p->child[i] == n)
+			break;
+	p->child[i] = p->child[--p->n];
+	if (!p->n)
+		unlink_node(a, p);
+}
+
+/* Drops point i from the front, keeping pts[] dense */
+static void drop_point(struct hb_pareto *a, unsigned int i)
+{
+	struct point *last = a->pts + --a->npts;
+	struct nd_node *l;
+	unsigned int j;
+
+	if (i == a->npts)
+		return;
+	a->pts[i] = *last;
+	l = a->pts[i].leaf;
+	for (j = 0; j < l->n; j++)
+		if (l->pt[j] == a->npts)
+			l->pt[j] = i;
+}
+
+static void drop_subtree(struct hb_pareto *a, struct nd_node *n)
+{
+	if (n->leaf) {
+		while (n->n)
+			drop_point(a, n->pt[--n->n]);
+	} else {
+		while (n->n) {
+			drop_subtree(a, n->child[--n->n]);
+			free(n->child[n->n]);
+		}
+	}
+}
+
+/* Returns true if y is covered by some point under n; otherwise removes
+ * every point under n that y dominates.  Leaves n freed if it empties.
+ */
+static bool nd_update(struct hb_pareto *a, struct nd_node *n, const float *y)
+{
+	unsigned int nobj = a->nobj, i;
+
+	if (covers(n->nadir, y, nobj))
+		return true;
+	if (covers(y, n->ideal, nobj)) {
+		drop_subtree(a, n);
+		unlink_node(a, n);
+		return false;
+	}
+	/* Otherwise only a node whose box straddles y can hold points
+	 * that cover or are covered by it
+	 */
+	if (!covers(n->ideal, y, nobj) && !covers(y, n->nadir, nobj))
+		return false;
+	if (n->leaf) {
+		for (i = 0; i < n->n;) {
+			unsigned int k = n->pt[i];
+
+			if (covers(a->pts[k].obj, y, nobj))
+				return true;
+			if (covers(y, a->pts[k].obj, nobj)) {
+				n->pt[i] = n->pt[--n->n];
+				drop_point(a, k);
+			} else {
+				i++;
+			}
+		}
+		if (!n->n)
+			unlink_node(a, n);
+		return false;
+	}
+	for (i = n->n; i-- > 0;)
+		if (nd_update(a, n->child[i], y))
+			return true;
+	return false;
+}
+
+static void widen(struct nd_node *n, const float *y, unsigned int nobj)
+{
+	unsigned int i;
+
+	for (i = 0; i < nobj; i++) {
+		n->ideal[i] = min(n->ideal[i], y[i]);
+		n->nadir[i] = max(n->nadir[i], y[i]);
+	}
+}
+
+static struct nd_node *new_leaf(struct nd_node *parent)
+{
+	struct nd_node *n = calloc(1, sizeof(*n));
+	unsigned int i;
+
+	if (!n)
+		return NULL;
+	n->parent = parent;
+	n->leaf = true;
+	for (i = 0; i < HB_PARETO_MAX_OBJ; i++) {
+		n->ideal[i] = INFINITY;
+		n->nadir[i] = -INFINITY;
+	}
+	return n;
+}
+
+/* Distances are scaled by the extent of the whole front */
+static float dist2(const struct hb_pareto *a, const float *x, const float *y)
+{
+	const struct nd_node *r = a->root;
+	unsigned int i;
+	float d = 0.0f;
+
+	for (i = 0; i < a->nobj; i++) {
+		float s = r->nadir[i] - r->ideal[i], e;
+
+		e = s > 0.0f ? (x[i] - y[i]) / s : 0.0f;
+		d += e * e;
+	}
+	return d;
+}
+
+/* Turns an overfull leaf into ND_BRANCH leaves, clustered around points
+ * that are spread out from each other
+ */
+static int split_leaf(struct hb_pareto *a, struct nd_node *n)
+{
+	unsigned int pts[ND_LEAF + 1], np = n->n, seed[ND_BRANCH];
+	struct nd_node *c[ND_BRANCH];
+	unsigned int i, j, k;
+	float best, d;
+
+	for (j = 0; j < ND_BRANCH; j++) {
+		c[j] = new_leaf(n);
+		if (!c[j]) {
+			while (j--)
+				free(c[j]);
+			return -ENOMEM;
+		}
+	}
+	memcpy(pts, n->pt, sizeof(pts));
+	/* First seed: the point furthest from the others on average */
+	best = -1.0f;
+	for (i = 0; i < np; i++) {
+		for (d = 0.0f, k = 0; k < np; k++)
+			d += dist2(a, a->pts[pts[i]].obj, a->pts[pts[k]].obj);
+		if (d > best) {
+			best = d;
+			seed[0] = i;
+		}
+	}
+	/* Then each next seed is the point furthest from its nearest seed */
+	for (j = 1; j < ND_BRANCH; j++) {
+		best = -1.0f;
+		for (i = 0; i < np; i++) {
+			float near = INFINITY;
+
+			for (k = 0; k < j; k++)
+				near = min(near, dist2(a, a->pts[pts[i]].obj,
+						       a->pts[pts[seed[k]]].obj));
+			if (near > best) {
+				best = near;
+				seed[j] = i;
+			}
+		}
+	}
+	for (i = 0; i < np; i++) {
+		struct point *p = a->pts + pts[i];
+
+		best = INFINITY;
+		for (j = k = 0; j < ND_BRANCH; j++) {
+			d = dist2(a, p->obj, a->pts[pts[seed[j]]].obj);
+			if (d < best) {
+				best = d;
+				k = j;
+			}
+		}
+		c[k]->pt[c[k]->n++] = pts[i];
+		widen(c[k], p->obj, a->nobj);
+		p->leaf = c[k];
+	}
+	n->leaf = false;
+	n->n = 0;
+	for (j = 0; j < ND_BRANCH; j++)
+		if (c[j]->n)
+			n->child[n->n++] = c[j];
+		else
+			free(c[j]);
+	return 0;
+}
+
+static int nd_insert(struct hb_pareto *a, unsigned int k)
+{
+	const float *y = a->pts[k].obj;
+	struct nd_node *n;
+	unsigned int i;
+
+	if (!a->root) {
+		a->root = new_leaf(NULL);
+		if (!a->root)
+			return -ENOMEM;
+	}
+	for (n = a->root; !n->leaf;) {
+		struct nd_node *c = n->child[0];
+		float best = INFINITY;
+
+		widen(n, y, a->nobj);
+		for (i = 0; i < n->n; i++) {
+			float mid[HB_PARETO_MAX_OBJ], d;
+			unsigned int j;
+
+			for (j = 0; j < a->nobj; j++)
+				mid[j] = (n->child[i]->ideal[j] +
+					  n->child[i]->nadir[j]) / 2.0f;
+			d = dist2(a, y, mid);
+			if (d < best) {
+				best = d;
+				c = n->child[i];
+			}
+		}
+		n = c;
+	}
+	widen(n, y, a->nobj);
+	n->pt[n->n++] = k;
+	a->pts[k].leaf = n;
+	if (n->n > ND_LEAF)
+		return split_leaf(a, n);
+	return 0;
+}
+
+int hb_pareto_insert(struct hb_pareto *a, const float *obj,
+		     const struct hb_design_in *in)
+{
+	struct point *p;
+	unsigned int i;
+	int rc;
+
+	for (i = 0; i < a->nobj; i++)
+		if (isnan(obj[i]))
+			return -EINVAL;
+	if (a->root && nd_update(a, a->root, obj))
+		return 0;
+	if (a->npts == a->size) {
+		unsigned int size = a->size ? a->size * 2 : 256;
+
+		p = realloc(a->pts, size * sizeof(*p));
+		if (!p)
+			return -ENOMEM;
+		a->pts = p;
+		a->size = size;
+	}
+	p = a->pts + a->npts;
+	memset(p->obj, 0, sizeof(p->obj));
+	memcpy(p->obj, obj, a->nobj * sizeof(*obj));
+	p->in = *in;
+	rc = nd_insert(a, a->npts++);
+	if (rc) {
+		a->npts--;
+		return rc;
+	}
+	return 1;
+}
+
+/* The explorer */
+
+struct cand {
+	struct hb_design_in in;
+	float obj[HB_PARETO_MAX_OBJ];
+	bool ok;
+};
+
+struct explore {
+	const struct hb_explore *e;
+	struct cand *c;
+};
+
+static int explore_eval(void *ctx, struct hb_worker *w, unsigned long i)
+{
+	struct explore *x = ctx;
+	const struct hb_explore *e = x->e;
+	struct cand *c = x->c + i;
+	struct hb_result res;
+	unsigned int j;
+
+	hb_eval_packed(e->space->ent, w, &c->in, &res);
+	c->ok = !res.rc && !hb_violation(&w->b, e->cons, e->ncons);
+	if (!c->ok)
+		return 0;
+	for (j = 0; j < e->nobj; j++) {
+		c->obj[j] = e->obj[j]->get(&w->b);
+		if (e->maximise[j])
+			c->obj[j] = -c->obj[j];
+		if (!isfinite(c->obj[j]))
+			c->ok = false;
+	}
+	return 0;
+}
+
+int hb_explore(struct hb_pool *p, const struct hb_explore *e,
+	       struct hb_pareto *a)
+{
+	unsigned int n = max(e->batch, 1u), seed = e->seed, round, i;
+	struct explore x = {.e = e};
+	int rc = 0;
+
+	if (e->nobj != a->nobj)
+		return -EINVAL;
+	if (!e->space->neng)
+		return -ENOENT;
+	x.c = calloc(n, sizeof(*x.c));
+	if (!x.c)
+		return -ENOMEM;
+	for (round = 0; round < e->rounds; round++) {
+		unsigned int size = hb_pareto_size(a);
+
+		/* Mostly children of the front; some fresh blood */
+		for (i = 0; i < n; i++) {
+			struct hb_design_in *in = &x.c[i].in;
+
+			if (size && rand_r(&seed) % 8) {
+				const struct hb_design_in *pa, *pb;
+
+				pa = hb_pareto_get(a, rand_r(&seed) % size, NULL);
+				pb = hb_pareto_get(a, rand_r(&seed) % size, NULL);
+				hb_design_cross(pa, pb, in, &seed);
+				hb_design_mutate(e->space, in, 1.0f / 9, &seed);
+			} else {
+				hb_design_random(e->space, in, &seed);
+			}
+		}
+		rc = hb_parallel_for(p, n, 0, explore_eval, &x);
+		if (rc)
+			break;
+		for (i = 0; i < n; i++)
+			if (x.c[i].ok) {
+				rc = hb_pareto_insert(a, x.c[i].obj, &x.c[i].in);
+				if (rc < 0)
+					goto out;
+			}
+		rc = 0;
+		if (e->progress)
+			e->progress(e->ctx, round, a);
+	}
+out:
+	free(x.c);
+	return rc;
+}
@@ -0,0 +1,53 @@
+#ifndef _PARETO_H
+#define _PARETO_H
+
+/* Multi-objective design search.
+ *
+ * hb_explore() builds up the set of non-dominated designs (the Pareto
+ * front) over several objectives at once, breeding each batch of
+ * candidates from the front found so far and evaluating them in
+ * parallel.  The front is kept in an ND-tree (Jaszkiewicz & Lust, 2018):
+ * every node knows the best (ideal) and worst (nadir) value of each
+ * objective among the designs below it, so most of the front can be ruled
+ * out at once when checking a new design for dominance, and insertion
+ * stays fast as the front grows into the tens of thousands.
+ */
+
+#include "opt.h"
+
+#define HB_PARETO_MAX_OBJ	8
+
+struct hb_pareto;
+
+/* Objective values are always to be minimised; negate the others */
+int hb_pareto_create(unsigned int nobj, struct hb_pareto **a);
+void hb_pareto_destroy(struct hb_pareto *a);
+unsigned int hb_pareto_size(const struct hb_pareto *a);
+/* Returns 1 if the design joined the front (displacing any designs it
+ * dominates), 0 if it is dominated by (or equal to) one already there.
+ */
+int hb_pareto_insert(struct hb_pareto *a, const float *obj,
+		     const struct hb_design_in *in);
+/* The i'th member of the front, 0 <= i < size; order is arbitrary */
+const struct hb_design_in *hb_pareto_get(const struct hb_pareto *a,
+					 unsigned int i, const float **obj);
+
+struct hb_explore {
+	const struct hb_space *space;
+	unsigned int nobj;
+	const struct hb_metric *obj[HB_PARETO_MAX_OBJ];
+	bool maximise[HB_PARETO_MAX_OBJ];
+	const struct hb_constraint *cons;
+	unsigned int ncons;
+	unsigned int rounds, batch;
+	unsigned int seed;
+	/* Called from the calling thread after each round */
+	void (*progress)(void *ctx, unsigned int round,
+			 const struct hb_pareto *a);
+	void *ctx;
+};
+
+int hb_explore(struct hb_pool *p, const struct hb_explore *e,
+	       struct hb_pareto *a);
+
+#endif // _PARETO_H
@@ -0,0 +1,194 @@
+/* paretocheck [-n INSERTS]: the ND-tree archive against a plain list.
+ *
+ * Inserts the same random points into an hb_pareto and into a list kept
+ * non-dominated by comparing each point with every member, and fails if
+ * hb_pareto_insert() ever disagrees about whether a point joins, or if
+ * the two fronts ever differ.  The points are drawn three ways: near a
+ * simplex, so that most of them are non-dominated and the front grows
+ * large; the same rounded to eighths, with many ties and repeats; and
+ * improving as they go, so that each new point evicts much of the front.
+ * Run by `make check`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "pareto.h"
+
+#define ARRAY_SIZE(x)	(sizeof(x) / sizeof(*x))
+
+enum kind {
+	KIND_TIES,
+	KIND_SIMPLEX,
+	KIND_DRIFT,
+
+	KIND_COUNT
+};
+
+static const char *const kind_name[KIND_COUNT] = {
+	[KIND_TIES] = "ties",
+	[KIND_SIMPLEX] = "simplex",
+	[KIND_DRIFT] = "drift",
+};
+
+/* Uniform in [0, 1) */
+static float uniform(unsigned long long key, unsigned long long idx)
+{
+	return (dice_roll(key, idx) >> 40) / 16777216.0f;
+}
+
+static void draw(enum kind kind, unsigned int nobj, unsigned int i,
+		 unsigned int n, float *obj)
+{
+	unsigned long long key = kind * 16 + nobj;
+	float sum = 0;
+	unsigned int j;
+
+	for (j = 0; j < nobj; j++)
+		obj[j] = uniform(key, i * HB_PARETO_MAX_OBJ + j);
+	switch (kind) {
+	case KIND_TIES:
+	case KIND_SIMPLEX:
+		for (j = 0; j < nobj; j++)
+			sum += obj[j];
+		for (j = 0; j < nobj; j++)
+			obj[j] = obj[j] / sum +
+				 uniform(~key, i * HB_PARETO_MAX_OBJ + j) * 0.01f;
+		if (kind == KIND_SIMPLEX)
+			break;
+		for (j = 0; j < nobj; j++)
+			obj[j] = (int)(obj[j] * 8);
+		break;
+	case KIND_DRIFT:
+		for (j = 0; j < nobj; j++)
+			obj[j] += 4.0f * (n - i) / n;
+		break;
+	default:
+		break;
+	}
+}
+
+/* x is no worse than y in every objective */
+static bool covers(const float *x, const float *y, unsigned int nobj)
+{
+	unsigned int j;
+
+	for (j = 0; j < nobj; j++)
+		if (x[j] > y[j])
+			return false;
+	return true;
+}
+
+static int cmp_uint(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Whether a holds the same points as the list, whose tags are tag[] */
+static bool same_front(const struct hb_pareto *a, unsigned int *tag,
+		       unsigned int len, unsigned int *scratch)
+{
+	unsigned int i;
+
+	if (hb_pareto_size(a) != len)
+		return false;
+	for (i = 0; i < len; i++)
+		scratch[i] = hb_pareto_get(a, i, NULL)->tag;
+	qsort(scratch, len, sizeof(*scratch), cmp_uint);
+	qsort(tag, len, sizeof(*tag), cmp_uint);
+	return !memcmp(scratch, tag, len * sizeof(*tag));
+}
+
+static int check(enum kind kind, unsigned int nobj, unsigned int n)
+{
+	unsigned int *tag, *scratch, len = 0, bad = 0, i, k, m;
+	struct hb_design_in in = {0};
+	struct hb_pareto *a;
+	float *pts;
+	bool joins;
+	int rc;
+
+	rc = hb_pareto_create(nobj, &a);
+	if (rc)
+		return rc;
+	pts = malloc(n * HB_PARETO_MAX_OBJ * sizeof(*pts));
+	tag = malloc(n * sizeof(*tag));
+	scratch = malloc(n * sizeof(*scratch));
+	if (!pts || !tag || !scratch) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < n; i++) {
+		float *x = pts + i * HB_PARETO_MAX_OBJ;
+
+		draw(kind, nobj, i, n, x);
+		joins = true;
+		for (k = 0; k < len && joins; k++)
+			joins = !covers(pts + tag[k] * HB_PARETO_MAX_OBJ, x, nobj);
+		if (joins) {
+			for (k = m = 0; k < len; k++)
+				if (!covers(x, pts + tag[k] * HB_PARETO_MAX_OBJ,
+					    nobj))
+					tag[m++] = tag[k];
+			len = m;
+			tag[len++] = i;
+		}
+		in.tag = i;
+		rc = hb_pareto_insert(a, x, &in);
+		if (rc < 0)
+			goto out;
+		if (rc != joins) {
+			fprintf(stderr, "%s/%u: point %u %s\n", kind_name[kind],
+				nobj, i, joins ? "left out" : "let in");
+			bad++;
+		}
+		if (((i + 1) % 1000 && i + 1 < n) || bad)
+			continue;
+		if (!same_front(a, tag, len, scratch)) {
+			fprintf(stderr, "%s/%u: fronts differ after %u points\n",
+				kind_name[kind], nobj, i + 1);
+			bad++;
+		}
+	}
+	printf("KIND=%s:NOBJ=%u:POINTS=%u:FRONT=%u:BAD=%u\n", kind_name[kind],
+	       nobj, n, len, bad);
+	rc = bad ? 1 : 0;
+out:
+	free(scratch);
+	free(tag);
+	free(pts);
+	hb_pareto_destroy(a);
+	return rc;
+}
+
+int main(int argc, char **argv)
+{
+	static const unsigned int nobj[] = {2, 3, 5, HB_PARETO_MAX_OBJ};
+	unsigned int n = 10000, i;
+	enum kind kind;
+	int rc, bad = 0;
+
+	if (argc == 3 && !strcmp(argv[1], "-n"))
+		n = strtoul(argv[2], NULL, 0);
+	if ((argc != 1 && argc != 3) || !n) {
+		fprintf(stderr, "Usage: paretocheck [-n INSERTS]\n");
+		return 2;
+	}
+	for (kind = 0; kind < KIND_COUNT; kind++)
+		for (i = 0; i < ARRAY_SIZE(nobj); i++) {
+			rc = check(kind, nobj[i], n);
+			if (rc < 0) {
+				fprintf(stderr, "paretocheck: %s\n",
+					strerror(-rc));
+				return 2;
+			}
+			if (rc)
+				bad = 1;
+		}
+	if (bad)
+		fprintf(stderr, "paretocheck: the archive disagrees\n");
+	return bad;
+}
@@ -0,0 +1,204 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "payload.h"
+
+/* Most fuel, in % of tankage, that fits in room lb */
+static unsigned int max_pct(const struct hb_payload *pr, float room)
+{
+	unsigned int hlb = pr->b->tanks.hlb;
+
+	if (room <= 0.0f)
+		return 0;
+	if (!hlb || room >= hlb * 100.0f)
+		return 100;
+	return floor(room / hlb);
+}
+
+/* Most bombs that fit under the limit alongside pct% fuel */
+static unsigned int max_load(const struct hb_payload *pr, unsigned int pct)
+{
+	float room = pr->limit - pr->dry - pr->b->tanks.hlb * (float)pct;
+
+	return min((unsigned int)floor(max(room, 0.0f)), pr->b->bay.cap);
+}
+
+static int eval(struct hb_payload *pr, unsigned int load, unsigned int pct,
+		struct hb_payload_point *pt)
+{
+	struct bomber *b = pr->b;
+	int rc;
+
+	b->bay.load = load;
+	b->tanks.pct = pct;
+	rc = calc_bomber_from(b, pr->tn, CALC_BOMBBAY);
+	pr->evals++;
+	if (rc)
+		return rc;
+	*pt = (struct hb_payload_point){.load = load, .pct = pct,
+					.range = b->range};
+	return 0;
+}
+
+int hb_payload_init(struct hb_payload *pr, const struct bomber *b,
+		    const struct tech_numbers *tn, bool concrete)
+{
+	unsigned int mts, mtg, lift, full, bay;
+	struct bomber *s;
+	int rc;
+
+	memset(pr, 0, sizeof(*pr));
+	s = malloc(sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+	*s = *b;
+	pr->b = s;
+	pr->tn = tn;
+	rc = calc_bomber(s, tn);
+	if (rc)
+		goto fail;
+	/* Loading it differently mustn't move the MTOW */
+	s->user_mtow = true;
+	pr->concrete = concrete = concrete && tn->rcs;
+	mts = concrete ? tn->rcs : tn->rgs;
+	mtg = (concrete ? tn->rcg : tn->rgg) * 1000;
+	lift = floor(wing_lift(&s->wing, mts / 1.6f));
+	pr->limit = s->mtow;
+	pr->by = HB_PAYLOAD_MTOW;
+	if (mtg < pr->limit) {
+		pr->limit = mtg;
+		pr->by = HB_PAYLOAD_RUNWAY;
+	}
+	if (lift < pr->limit) {
+		pr->limit = lift;
+		pr->by = HB_PAYLOAD_WING;
+	}
+	pr->dry = s->tare + s->turrets.ammo + s->crew.gross;
+	if (pr->dry > pr->limit) {
+		rc = -ERANGE; /* Too heavy even without load */
+		goto fail;
+	}
+	full = max_pct(pr, pr->limit - pr->dry);
+	bay = max_pct(pr, pr->limit - pr->dry - s->bay.cap);
+	rc = eval(pr, max_load(pr, bay), bay, &pr->maxload);
+	if (!rc)
+		rc = eval(pr, max_load(pr, full), full, &pr->fullfuel);
+	if (!rc)
+		rc = eval(pr, 0, full, &pr->ferry);
+	if (!rc)
+		return 0;
+fail:
+	hb_payload_free(pr);
+	return rc;
+}
+
+/* Evaluates load with pct% fuel, and tells whether it gets dist miles */
+static int reaches(struct hb_payload *pr, unsigned int load, unsigned int pct,
+		   float dist, struct hb_payload_point *pt, bool *ok)
+{
+	int rc = eval(pr, load, pct, pt);
+
+	*ok = !rc && pt->range >= dist;
+	return rc;
+}
+
+/* The heaviest load from lo to hi that gets pct% fuel dist miles, into
+ * *pt, setting *found if there is one.
+ *
+ * As the load goes up, range falls, until the aircraft is heavy enough to
+ * lose a step of ceiling; then it cruises lower down, where the engines
+ * may give more power, and range can jump back up.  So walk up the teeth
+ * of the sawtooth, finding where each ends by bisection on the ceiling,
+ * and the last load on it that gets there by bisection on range, until
+ * range_bound() shows that no heavier load can.
+ */
+static int heaviest(struct hb_payload *pr, unsigned int pct, unsigned int lo,
+		    unsigned int hi, float dist, struct hb_payload_point *pt,
+		    bool *found)
+{
+	struct hb_payload_point p;
+	unsigned int good, bad, end, mid;
+	float ceiling;
+	bool ok;
+	int rc;
+
+	while (lo <= hi) {
+		rc = reaches(pr, lo, pct, dist, &p, &ok);
+		if (rc || range_bound(pr->b) < dist)
+			return rc;
+		if (ok) {
+			*pt = p;
+			*found = true;
+		}
+		/* The end of this tooth */
+		ceiling = pr->b->ceiling;
+		good = lo;
+		bad = hi + 1;
+		if (hi > lo) {
+			rc = eval(pr, hi, pct, &p);
+			if (rc)
+				return rc;
+			if (pr->b->ceiling == ceiling)
+				good = hi;
+			else
+				bad = hi;
+		}
+		while (bad - good > 1) {
+			mid = good + (bad - good) / 2;
+			rc = eval(pr, mid, pct, &p);
+			if (rc)
+				return rc;
+			if (pr->b->ceiling == ceiling)
+				good = mid;
+			else
+				bad = mid;
+		}
+		end = good;
+		/* The last load on it that gets there */
+		good = lo;
+		bad = ok ? end + 1 : lo;
+		while (bad - good > 1) {
+			mid = good + (bad - good) / 2;
+			rc = reaches(pr, mid, pct, dist, &p, &ok);
+			if (rc)
+				return rc;
+			if (ok) {
+				*pt = p;
+				good = mid;
+			} else {
+				bad = mid;
+			}
+		}
+		lo = end + 1;
+	}
+	return 0;
+}
+
+int hb_payload_at(struct hb_payload *pr, float dist,
+		  struct hb_payload_point *pt)
+{
+	bool found = false;
+	unsigned int pct, hi;
+	int rc;
+
+	/* Fewer bombs fit alongside more fuel; so once no more fit than
+	 * the best so far, no more fuel can do better
+	 */
+	for (pct = 0; pct <= pr->ferry.pct; pct++) {
+		hi = max_load(pr, pct);
+		if (found && hi <= pt->load)
+			break;
+		rc = heaviest(pr, pct, found ? pt->load + 1 : 0, hi, dist, pt,
+			      &found);
+		if (rc)
+			return rc;
+	}
+	return found ? 0 : -ERANGE;
+}
+
+void hb_payload_free(struct hb_payload *pr)
+{
+	free(pr->b);
+	pr->b = NULL;
+}
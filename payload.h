@@ -0,0 +1,64 @@
+#ifndef _PAYLOAD_H
+#define _PAYLOAD_H
+
+/* Payload against range.
+ *
+ * A design takes off no heavier than the least of its MTOW, the runway's
+ * gross weight limit, and what its wing can lift at the runway's take-off
+ * speed limit (the same sums as the editor's doctrine refit).  Within
+ * that, bombs trade against fuel.  The trade curve has three corners:
+ *	maxload: a full bay, with as much fuel as the limit then allows
+ *	fullfuel: full tanks, with as many bombs as the limit then allows
+ *	ferry: full tanks and no bombs
+ * Between the first two the aircraft is at the limit, and range mostly
+ * grows with fuel; beyond the second it mostly grows as the bomb load
+ * comes down.  But not always: an aircraft a step of ceiling lower
+ * cruises lower down, where its engines may give more power, so range is
+ * a sawtooth in the load, and a few more bombs can take it further.  The
+ * best load for a given distance is found fuel percent by fuel percent,
+ * walking up the teeth by bisection and stopping where range_bound()
+ * shows no heavier load can get there, or where the tanks leave no room
+ * for more bombs than the best so far.  That takes some thousands of
+ * recalculations, each only from the bomb bay on.
+ */
+
+#include "hbuilder.h"
+
+enum hb_payload_by {
+	HB_PAYLOAD_MTOW,
+	HB_PAYLOAD_RUNWAY, /* gross weight limit */
+	HB_PAYLOAD_WING, /* take-off speed limit */
+};
+
+struct hb_payload_point {
+	unsigned int load; /* lb of bombs */
+	unsigned int pct; /* fuel, % of tankage */
+	float range;
+};
+
+struct hb_payload {
+	bool concrete;
+	unsigned int limit; /* take-off gross weight, lb */
+	enum hb_payload_by by;
+	float dry; /* gross weight without fuel or bombs */
+	struct hb_payload_point maxload, fullfuel, ferry;
+	unsigned long evals; /* recalculations done */
+	/* private */
+	const struct tech_numbers *tn;
+	struct bomber *b;
+};
+
+/* b is not changed.  Returns -ERANGE if the design cannot take off
+ * even empty.
+ */
+int hb_payload_init(struct hb_payload *pr, const struct bomber *b,
+		    const struct tech_numbers *tn, bool concrete);
+/* Greatest bomb load that reaches dist miles, on the least fuel that does
+ * it; -ERANGE if no loading does.  This can be a little beyond the ferry
+ * range.
+ */
+int hb_payload_at(struct hb_payload *pr, float dist,
+		  struct hb_payload_point *pt);
+void hb_payload_free(struct hb_payload *pr);
+
+#endif // _PAYLOAD_H
@@ -0,0 +1,194 @@
+/* payloadcheck [-t YEAR] DESIGN...: hb_payload_at() against every load.
+ *
+ * Evaluates each design at every fuel percent and every bomb load that
+ * its take-off limit allows, and then, every 10 miles out to beyond its
+ * ferry range and at each corner of the curve, finds the greatest load
+ * that gets there on the least fuel by looking through them all.  Fails
+ * if hb_payload_at() ever gives a different load or fuel, or a range
+ * for a distance that can or can't be reached when it says otherwise.
+ * Run by `make check`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "payload.h"
+#include "pool.h"
+
+struct grid {
+	const struct bomber *b; /* evaluated, with its MTOW held */
+	const struct tech_numbers *tn;
+	const struct hb_payload *pr;
+	unsigned int cap;
+	float *range; /* [pct * (cap + 1) + load]; NAN if not allowed */
+};
+
+/* Most bombs allowed alongside pct% fuel, as payload.c has it */
+static int top_load(const struct grid *g, unsigned int pct)
+{
+	float room = g->pr->limit - g->pr->dry - g->b->tanks.hlb * (float)pct;
+
+	if (pct > g->pr->ferry.pct)
+		return -1;
+	return min((unsigned int)floor(max(room, 0.0f)), g->cap);
+}
+
+static int eval_pct(void *ctx, struct hb_worker *w, unsigned long pct)
+{
+	struct grid *g = ctx;
+	float *range = g->range + pct * (g->cap + 1);
+	int top = top_load(g, pct), load;
+
+	w->b = *g->b;
+	w->b.tanks.pct = pct;
+	for (load = 0; load <= top; load++) {
+		w->b.bay.load = load;
+		range[load] = calc_bomber_from(&w->b, g->tn, CALC_BOMBBAY) ?
+			      NAN : w->b.range;
+	}
+	for (; load <= (int)g->cap; load++)
+		range[load] = NAN;
+	return 0;
+}
+
+/* The greatest load that reaches dist, on the least fuel */
+static int best_at(const struct grid *g, float dist,
+		   struct hb_payload_point *pt)
+{
+	unsigned int pct;
+	int load;
+
+	for (load = g->cap; load >= 0; load--)
+		for (pct = 0; pct <= 100; pct++)
+			if (g->range[pct * (g->cap + 1) + load] >= dist) {
+				pt->load = load;
+				pt->pct = pct;
+				return 0;
+			}
+	return -ERANGE;
+}
+
+static int check_at(const char *name, struct grid *g, struct hb_payload *pr,
+		    float dist)
+{
+	struct hb_payload_point want, got;
+	int rw, rg;
+
+	rw = best_at(g, dist, &want);
+	rg = hb_payload_at(pr, dist, &got);
+	if (rw == rg && (rw || (want.load == got.load &&
+				want.pct == got.pct)))
+		return 0;
+	fprintf(stderr, "%s: at %g miles, ", name, dist);
+	if (rw)
+		fprintf(stderr, "out of range");
+	else
+		fprintf(stderr, "LOAD=%u:PCT=%u", want.load, want.pct);
+	fprintf(stderr, " but hb_payload_at() gives ");
+	if (rg)
+		fprintf(stderr, "%s\n", strerror(-rg));
+	else
+		fprintf(stderr, "LOAD=%u:PCT=%u\n", got.load, got.pct);
+	return 1;
+}
+
+static int check_design(struct hb_pool *pool, const struct entities *ent,
+			const struct tech_numbers *tn, const char *name)
+{
+	const struct hb_payload_point *corner[3];
+	struct hb_payload pr;
+	struct bomber *b;
+	struct grid g;
+	unsigned int bad = 0, n = 0, i;
+	float dist;
+	FILE *f;
+	int rc;
+
+	b = malloc(sizeof(*b));
+	if (!b)
+		return -ENOMEM;
+	f = fopen(name, "r");
+	if (!f) {
+		rc = -errno;
+		goto out;
+	}
+	rc = hb_load_design(ent, f, b);
+	fclose(f);
+	if (!rc)
+		rc = hb_payload_init(&pr, b, tn, true);
+	if (rc == -ERANGE) {
+		printf("%s:TOO_HEAVY\n", name);
+		rc = 0;
+	}
+	if (rc)
+		goto out;
+	/* As hb_payload_init() evaluates it */
+	rc = calc_bomber(b, tn);
+	b->user_mtow = true;
+	g = (struct grid){.b = b, .tn = tn, .pr = &pr, .cap = b->bay.cap};
+	g.range = malloc(101 * (g.cap + 1) * sizeof(*g.range));
+	if (!rc && !g.range)
+		rc = -ENOMEM;
+	if (!rc)
+		rc = hb_parallel_for(pool, 101, 1, eval_pct, &g);
+	if (rc)
+		goto done;
+	for (dist = 10.0f; dist <= pr.ferry.range + 10.0f; dist += 10.0f, n++)
+		bad += check_at(name, &g, &pr, dist);
+	corner[0] = &pr.maxload;
+	corner[1] = &pr.fullfuel;
+	corner[2] = &pr.ferry;
+	for (i = 0; i < ARRAY_SIZE(corner); i++, n++)
+		bad += check_at(name, &g, &pr, corner[i]->range);
+	printf("%s:LIMIT=%u:DISTS=%u:BAD=%u\n", name, pr.limit, n, bad);
+	rc = bad ? 1 : 0;
+done:
+	free(g.range);
+	hb_payload_free(&pr);
+out:
+	free(b);
+	return rc;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int year = 1942;
+	struct tech_numbers tn;
+	struct hb_pool *pool;
+	struct hb_data d;
+	int rc, i, bad = 0;
+
+	if (argc > 2 && !strcmp(argv[1], "-t")) {
+		year = strtoul(argv[2], NULL, 0);
+		argc -= 2;
+		argv += 2;
+	}
+	if (argc < 2) {
+		fprintf(stderr, "Usage: payloadcheck [-t YEAR] DESIGN...\n");
+		return 2;
+	}
+	rc = hb_load(&d, ".");
+	if (rc)
+		return 2;
+	rc = hb_tech_date(&d.ent, year, 0, &tn);
+	if (!rc)
+		rc = hb_pool_create(0, 0, &pool);
+	if (rc) {
+		hb_free(&d);
+		return 2;
+	}
+	for (i = 1; i < argc; i++) {
+		rc = check_design(pool, &d.ent, &tn, argv[i]);
+		if (rc < 0)
+			fprintf(stderr, "%s: %s\n", argv[i], strerror(-rc));
+		if (rc)
+			bad = 1;
+	}
+	hb_pool_destroy(pool);
+	hb_free(&d);
+	if (bad)
+		fprintf(stderr, "payloadcheck: hb_payload_at() disagrees\n");
+	return bad;
+}
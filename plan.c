@@ -0,0 +1,245 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "plan.h"
+
+struct entry {
+	struct hb_opt_best best; /* best.in.tech is the key */
+	unsigned int seen; /* the last month reached, + 1 */
+};
+
+struct node {
+	struct tech_numbers tn;
+	unsigned int entry;
+	unsigned int order[HB_CAMPAIGN_MONTHS];
+};
+
+struct planner {
+	struct hb_pool *p;
+	const struct entities *ent;
+	const struct hb_plan *o;
+	struct hb_plan_result *res;
+	unsigned int n, cap;
+	struct entry *e;
+	/* Open-addressed index into e[], by techs; never over half full */
+	unsigned int hmask;
+	unsigned int *hash; /* i + 1, or 0 for empty */
+};
+
+static unsigned int key_hash(const unsigned int *tech)
+{
+	const unsigned char *p = (const unsigned char *)tech;
+	unsigned int h = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < BITSET_WORDS(MAX_TECHS) * sizeof(*tech); i++)
+		h = (h ^ p[i]) * 16777619u;
+	return h;
+}
+
+static void insert(struct planner *pl, unsigned int i)
+{
+	unsigned int h = key_hash(pl->e[i].best.in.tech) & pl->hmask;
+
+	while (pl->hash[h])
+		h = (h + 1) & pl->hmask;
+	pl->hash[h] = i + 1;
+}
+
+static int find(const struct planner *pl, const unsigned int *tech)
+{
+	unsigned int h;
+
+	for (h = key_hash(tech) & pl->hmask; pl->hash[h];
+	     h = (h + 1) & pl->hmask)
+		if (!memcmp(pl->e[pl->hash[h] - 1].best.in.tech, tech,
+			    sizeof(pl->e[0].best.in.tech)))
+			return pl->hash[h] - 1;
+	return -ENOENT;
+}
+
+static int add(struct planner *pl, const struct hb_opt_best *best)
+{
+	unsigned int i;
+
+	if (pl->n == pl->cap) {
+		unsigned int cap = pl->cap ? pl->cap * 2 : 256;
+		void *e = realloc(pl->e, cap * sizeof(*pl->e));
+
+		if (!e)
+			return -ENOMEM;
+		pl->e = e;
+		free(pl->hash);
+		pl->hash = calloc(cap * 2, sizeof(*pl->hash));
+		if (!pl->hash)
+			return -ENOMEM;
+		pl->cap = cap;
+		pl->hmask = cap * 2 - 1;
+		for (i = 0; i < pl->n; i++)
+			insert(pl, i);
+	}
+	pl->e[pl->n] = (struct entry){.best = *best};
+	insert(pl, pl->n);
+	return pl->n++;
+}
+
+/* Feasible beats infeasible; then less violation; then better value */
+static bool better(const struct hb_plan *o, const struct hb_opt_best *a,
+		   const struct hb_opt_best *b)
+{
+	if (a->violation != b->violation)
+		return a->violation < b->violation;
+	return o->maximise ? a->value > b->value : a->value < b->value;
+}
+
+static int search(struct planner *pl, const struct tech_numbers *tn,
+		  const struct hb_opt_best *from, struct hb_opt_best *best)
+{
+	const struct hb_plan *o = pl->o;
+	struct hb_space space;
+	struct hb_opt opt = {
+		.space = &space,
+		.objective = o->objective,
+		.maximise = o->maximise,
+		.cons = o->cons,
+		.ncons = o->ncons,
+		.pop = o->pop,
+		.gens = o->gens,
+		.seed = o->seed + pl->res->searches,
+	};
+	int rc;
+
+	hb_space_init(&space, pl->ent, tn, o->manf);
+	if (from) {
+		opt.start = &from->in;
+		opt.nstart = 1;
+	}
+	rc = hb_optimise(pl->p, &opt, best);
+	if (rc)
+		return rc;
+	pl->res->searches++;
+	pl->res->evals += best->evals;
+	return 0;
+}
+
+/* The entry for tn, one tech on from ptn, whose entry is pe */
+static int reach(struct planner *pl, const struct tech_numbers *ptn,
+		 unsigned int pe, const struct tech_numbers *tn)
+{
+	struct hb_opt_best best;
+	int rc;
+
+	rc = find(pl, tn->tech);
+	if (rc >= 0)
+		return rc;
+	pl->res->states++;
+	if (calc_tn_stage(ptn, tn) == CALC_STAGES) {
+		/* Nothing the design sees has changed */
+		best = pl->e[pe].best;
+		memcpy(best.in.tech, tn->tech, sizeof(best.in.tech));
+	} else {
+		rc = search(pl, tn, &pl->e[pe].best, &best);
+		if (rc)
+			return rc;
+	}
+	return add(pl, &best);
+}
+
+unsigned int hb_plan_months(unsigned int year, unsigned int month)
+{
+	int m = ((int)year - HB_CAMPAIGN_YEAR) * 12 + (month ? month : 12) -
+		HB_CAMPAIGN_MONTH;
+
+	return min(max(m, 0), HB_CAMPAIGN_MONTHS);
+}
+
+int hb_plan_research(struct hb_pool *p, const struct entities *ent,
+		     const struct hb_plan *o, struct hb_plan_result *res)
+{
+	struct planner pl = {.p = p, .ent = ent, .o = o, .res = res};
+	unsigned int nb = 1, nn, m, i, j, k, t;
+	struct node *beam, *next, *c;
+	struct hb_opt_best best;
+	int date[MAX_TECHS];
+	bool any;
+	int rc;
+
+	if (!o->width || o->months > HB_CAMPAIGN_MONTHS)
+		return -EINVAL;
+	memset(res, 0, sizeof(*res));
+	beam = calloc(o->width, sizeof(*beam));
+	next = calloc((size_t)o->width * (ent->ntech + 1), sizeof(*next));
+	if (!beam || !next) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	for (t = 0; t < ent->ntech; t++)
+		date[t] = hb_campaign_month(ent->tech[t]);
+	rc = hb_tech_date(ent, HB_CAMPAIGN_YEAR, HB_CAMPAIGN_MONTH, &beam->tn);
+	if (rc)
+		goto out;
+	res->states++;
+	rc = search(&pl, &beam->tn, NULL, &best);
+	if (!rc)
+		rc = add(&pl, &best);
+	if (rc < 0)
+		goto out;
+	beam->entry = rc;
+
+	for (m = 0; m < o->months; m++) {
+		nn = 0;
+		for (i = 0; i < nb; i++) {
+			const struct node *b = beam + i;
+
+			any = false;
+			for (t = 0; t < ent->ntech; t++) {
+				if (test_bit(b->tn.tech, t) ||
+				    date[t] > (int)(m + HB_RESEARCH_WINDOW) ||
+				    !tech_have_reqs(ent->tech[t], &b->tn))
+					continue;
+				any = true;
+				c = next + nn;
+				c->tn = b->tn;
+				rc = hb_tech_add(ent, &c->tn, t);
+				if (rc >= 0)
+					rc = reach(&pl, &b->tn, b->entry, &c->tn);
+				if (rc < 0)
+					goto out;
+				/* Another order got to these techs first */
+				if (pl.e[rc].seen == m + 1)
+					continue;
+				pl.e[rc].seen = m + 1;
+				c->entry = rc;
+				memcpy(c->order, b->order, sizeof(c->order));
+				c->order[m] = t;
+				nn++;
+			}
+			if (!any && pl.e[b->entry].seen != m + 1) {
+				pl.e[b->entry].seen = m + 1;
+				next[nn] = *b;
+				next[nn++].order[m] = HB_PLAN_NONE;
+			}
+		}
+		/* Keep the width best */
+		nb = min(nn, o->width);
+		for (j = 0; j < nb; j++) {
+			for (k = j, i = j + 1; i < nn; i++)
+				if (better(o, &pl.e[next[i].entry].best,
+					   &pl.e[next[k].entry].best))
+					k = i;
+			beam[j] = next[k];
+			if (k != j)
+				next[k] = next[j];
+		}
+	}
+	memcpy(res->order, beam->order, sizeof(res->order));
+	res->tn = beam->tn;
+	res->best = pl.e[beam->entry].best;
+	rc = 0;
+out:
+	free(pl.hash);
+	free(pl.e);
+	free(next);
+	free(beam);
+	return rc;
+}
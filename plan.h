@@ -0,0 +1,57 @@
+#ifndef _PLAN_H
+#define _PLAN_H
+
+/* Research order planning.
+ *
+ * hb_plan_research() looks for the order in which to research techs, one
+ * a month from October 1939, that gives the best design by a target
+ * month: the best, that is, that hb_optimise() finds for the objective
+ * and constraints under the techs researched by then.  It is a beam
+ * search over the tech DAG.  Each month every order in the beam is
+ * extended by each tech on offer (prerequisites met, and dated at most
+ * HB_RESEARCH_WINDOW months ahead), and the width extensions with the
+ * best designs so far are kept.
+ *
+ * The best design for each set of techs is cached, so orders that reach
+ * the same set share it.  An extension's tech state is its parent's plus
+ * the one tech, applied with hb_tech_add(); if no calculation stage reads
+ * anything that changes, the parent's design stands, and otherwise the
+ * search under the new state starts from it, so the design work done
+ * along a shared prefix carries into every branch.
+ */
+
+#include "opt.h"
+#include "research.h"
+
+#define HB_PLAN_NONE	(~0u) /* nothing on offer that month */
+
+struct hb_plan {
+	const struct manf *manf;
+	const struct hb_metric *objective;
+	bool maximise;
+	const struct hb_constraint *cons;
+	unsigned int ncons;
+	unsigned int pop, gens; /* for each tech state's search */
+	unsigned int seed;
+	unsigned int months; /* to plan, from October 1939 */
+	unsigned int width; /* of the beam */
+};
+
+struct hb_plan_result {
+	unsigned int order[HB_CAMPAIGN_MONTHS]; /* tech researched each month */
+	struct tech_numbers tn; /* at the end */
+	struct hb_opt_best best; /* under tn */
+	unsigned long states; /* distinct sets of techs reached */
+	unsigned long searches; /* of them, how many needed a search */
+	unsigned long evals;
+};
+
+/* Months of research up to and including month (1-12, or 0 for all) of
+ * year, clamped to the campaign
+ */
+unsigned int hb_plan_months(unsigned int year, unsigned int month);
+
+int hb_plan_research(struct hb_pool *p, const struct entities *ent,
+		     const struct hb_plan *o, struct hb_plan_result *res);
+
+#endif // _PLAN_H
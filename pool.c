@@ -0,0 +1,265 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include "pool.h"
+
+/* A worker's share of the current loop, [lo, hi).  The owner takes from
+ * lo, thieves from hi; both under lock, which is held only briefly.
+ */
+struct range {
+	pthread_mutex_t lock;
+	unsigned long lo, hi;
+} __attribute__((aligned(HB_CACHE_LINE)));
+
+struct thread {
+	pthread_t thread;
+	struct hb_pool *pool;
+	struct range range;
+	struct hb_worker w;
+};
+
+struct hb_pool {
+	unsigned int n;
+	struct thread *t;
+	pthread_mutex_t busy; /* one loop at a time */
+	/* Loop dispatch, under lock */
+	pthread_mutex_t lock;
+	pthread_cond_t start, done;
+	unsigned long gen; /* bumped for each loop */
+	unsigned int running;
+	bool quit;
+	/* The current loop */
+	unsigned long grain;
+	hb_for_fn fn;
+	void *ctx;
+	atomic_int rc;
+};
+
+static bool take(struct range *r, unsigned long grain, unsigned long *lo,
+		 unsigned long *hi)
+{
+	bool got;
+
+	pthread_mutex_lock(&r->lock);
+	got = r->lo < r->hi;
+	if (got) {
+		*lo = r->lo;
+		*hi = min(r->lo + grain, r->hi);
+		r->lo = *hi;
+	}
+	pthread_mutex_unlock(&r->lock);
+	return got;
+}
+
+static bool steal(struct hb_pool *p, struct thread *self)
+{
+	unsigned long lo = 0, hi = 0;
+	unsigned int i;
+
+	for (i = 1; i < p->n; i++) {
+		struct range *v = &p->t[(self->w.id + i) % p->n].range;
+
+		pthread_mutex_lock(&v->lock);
+		if (v->lo < v->hi) {
+			lo = v->lo + (v->hi - v->lo) / 2;
+			hi = v->hi;
+			v->hi = lo;
+		}
+		pthread_mutex_unlock(&v->lock);
+		if (lo < hi) {
+			pthread_mutex_lock(&self->range.lock);
+			self->range.lo = lo;
+			self->range.hi = hi;
+			pthread_mutex_unlock(&self->range.lock);
+			return true;
+		}
+	}
+	return false;
+}
+
+static void run(struct hb_pool *p, struct thread *t)
+{
+	unsigned long lo, hi, i;
+	int rc;
+
+	do {
+		while (take(&t->range, p->grain, &lo, &hi))
+			for (i = lo; i < hi; i++) {
+				if (atomic_load_explicit(&p->rc,
+							 memory_order_relaxed))
+					return;
+				rc = p->fn(p->ctx, &t->w, i);
+				if (rc < 0) {
+					atomic_store(&p->rc, rc);
+					return;
+				}
+			}
+	} while (steal(p, t));
+}
+
+static void *pool_thread(void *data)
+{
+	struct thread *t = data;
+	struct hb_pool *p = t->pool;
+	unsigned long gen = 0;
+
+	pthread_mutex_lock(&p->lock);
+	for (;;) {
+		while (p->gen == gen && !p->quit)
+			pthread_cond_wait(&p->start, &p->lock);
+		if (p->quit)
+			break;
+		gen = p->gen;
+		pthread_mutex_unlock(&p->lock);
+
+		run(p, t);
+
+		pthread_mutex_lock(&p->lock);
+		if (!--p->running)
+			pthread_cond_signal(&p->done);
+	}
+	pthread_mutex_unlock(&p->lock);
+	return NULL;
+}
+
+int hb_pool_create(unsigned int nthreads, unsigned int seed,
+		   struct hb_pool **pp)
+{
+	struct hb_pool *p;
+	unsigned int i;
+	int rc;
+
+	if (!nthreads) {
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+		nthreads = ncpu > 0 ? ncpu : 1;
+	}
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return -ENOMEM;
+	p->t = calloc(nthreads, sizeof(*p->t));
+	if (!p->t) {
+		free(p);
+		return -ENOMEM;
+	}
+	pthread_mutex_init(&p->busy, NULL);
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->start, NULL);
+	pthread_cond_init(&p->done, NULL);
+	for (i = 0; i < nthreads; i++) {
+		struct thread *t = p->t + i;
+
+		t->pool = p;
+		t->w.id = i;
+		t->w.seed = seed + i;
+		pthread_mutex_init(&t->range.lock, NULL);
+	}
+	/* Worker 0 is whoever calls hb_parallel_for() */
+	p->n = 1;
+	for (i = 1; i < nthreads; i++) {
+		rc = -pthread_create(&p->t[i].thread, NULL, pool_thread,
+				     p->t + i);
+		if (rc) {
+			hb_pool_destroy(p);
+			return rc;
+		}
+		p->n++;
+	}
+	*pp = p;
+	return 0;
+}
+
+void hb_pool_destroy(struct hb_pool *p)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&p->lock);
+	p->quit = true;
+	pthread_cond_broadcast(&p->start);
+	pthread_mutex_unlock(&p->lock);
+	for (i = 1; i < p->n; i++)
+		pthread_join(p->t[i].thread, NULL);
+	free(p->t);
+	free(p);
+}
+
+unsigned int hb_pool_size(const struct hb_pool *p)
+{
+	return p->n;
+}
+
+void *hb_tally_alloc(const struct hb_pool *p, size_t size)
+{
+	size_t len = p->n * HB_TALLY_SIZE(size);
+	void *t = aligned_alloc(HB_CACHE_LINE, len);
+
+	if (t)
+		memset(t, 0, len);
+	return t;
+}
+
+int hb_parallel_for(struct hb_pool *p, unsigned long n, unsigned long grain,
+		    hb_for_fn fn, void *ctx)
+{
+	unsigned long share = n / p->n, extra = n % p->n, lo = 0;
+	unsigned int i;
+	int rc;
+
+	if (!grain)
+		grain = max(1ul, min(64ul, n / (p->n * 16ul)));
+	pthread_mutex_lock(&p->busy);
+	/* Start everyone off with an equal share; stealing evens it out */
+	for (i = 0; i < p->n; i++) {
+		struct range *r = &p->t[i].range;
+
+		r->lo = lo;
+		lo += share + (i < extra);
+		r->hi = lo;
+	}
+	p->grain = grain;
+	p->fn = fn;
+	p->ctx = ctx;
+	atomic_store(&p->rc, 0);
+
+	pthread_mutex_lock(&p->lock);
+	p->gen++;
+	p->running = p->n - 1;
+	pthread_cond_broadcast(&p->start);
+	pthread_mutex_unlock(&p->lock);
+
+	run(p, p->t);
+
+	pthread_mutex_lock(&p->lock);
+	while (p->running)
+		pthread_cond_wait(&p->done, &p->lock);
+	pthread_mutex_unlock(&p->lock);
+	rc = atomic_load(&p->rc);
+	pthread_mutex_unlock(&p->busy);
+	return rc;
+}
+
+struct eval_batch {
+	const struct entities *ent;
+	const struct hb_design_in *in;
+	struct hb_result *out;
+};
+
+static int eval_one(void *ctx, struct hb_worker *w, unsigned long i)
+{
+	struct eval_batch *e = ctx;
+
+	hb_eval_packed(e->ent, w, e->in + i, e->out + i);
+	return 0;
+}
+
+int hb_eval_batch(struct hb_pool *p, const struct entities *ent,
+		  const struct hb_design_in *in, unsigned long n,
+		  struct hb_result *out)
+{
+	struct eval_batch e = {.ent = ent, .in = in, .out = out};
+
+	return hb_parallel_for(p, n, 0, eval_one, &e);
+}
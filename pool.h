@@ -0,0 +1,63 @@
+#ifndef _POOL_H
+#define _POOL_H
+
+/* A pool of evaluation threads, for sweeps, searches and batches.
+ *
+ * hb_parallel_for() runs fn(ctx, w, i) for every i in [0, n), spread over
+ * the pool's workers (the calling thread is worker 0).  Each worker has
+ * its own range of indices, which it works through grain at a time from
+ * the bottom; a worker that runs out steals the top half of someone
+ * else's range.  So designs that take longer to evaluate (e.g. ones that
+ * get further in calc_ceiling) don't leave the other threads idle.
+ *
+ * fn gets the worker's own struct hb_worker as scratch space, with its
+ * own bomber and dice seed, so it needn't lock anything to evaluate.  If
+ * fn returns a negative rc, the loop stops early and returns that rc.
+ * A pool runs one loop at a time; fn must not call back into the pool.
+ *
+ * A simulation keys each item's rolls by its run's seed and i, with
+ * dice_roll(), rather than drawing on the worker's dice, so a run comes
+ * out the same however the items are shared out.  Its workers count into
+ * tallies of their own from hb_tally_alloc(), which are added up once
+ * the loop is done.
+ */
+
+#include "hbuilder.h"
+
+#define HB_CACHE_LINE	64
+#define HB_TALLY_SIZE(size) \
+	(((size) + HB_CACHE_LINE - 1) & ~(size_t)(HB_CACHE_LINE - 1))
+
+struct hb_pool;
+
+typedef int (*hb_for_fn)(void *ctx, struct hb_worker *w, unsigned long i);
+
+/* nthreads == 0 means one per online CPU.  Worker i's dice seed starts at
+ * seed + i.
+ */
+int hb_pool_create(unsigned int nthreads, unsigned int seed,
+		   struct hb_pool **p);
+void hb_pool_destroy(struct hb_pool *p);
+unsigned int hb_pool_size(const struct hb_pool *p);
+
+/* grain == 0 picks a grain size from n */
+int hb_parallel_for(struct hb_pool *p, unsigned long n, unsigned long grain,
+		    hb_for_fn fn, void *ctx);
+
+/* A zeroed tally of size bytes for each worker, each on cache lines of its
+ * own so that the workers don't slow each other down; free with free()
+ */
+void *hb_tally_alloc(const struct hb_pool *p, size_t size);
+
+/* Worker id's tally */
+static inline void *hb_tally(void *tally, size_t size, unsigned int id)
+{
+	return (char *)tally + id * HB_TALLY_SIZE(size);
+}
+
+/* Evaluates n packed designs; out[i] is the result for in[i] */
+int hb_eval_batch(struct hb_pool *p, const struct entities *ent,
+		  const struct hb_design_in *in, unsigned long n,
+		  struct hb_result *out);
+
+#endif // _POOL_H
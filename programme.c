@@ -0,0 +1,339 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "programme.h"
+
+/* Days since 1 March of year 0, for the proleptic Gregorian calendar */
+static long civil_days(int y, unsigned int m, unsigned int d)
+{
+	unsigned int yoe, doy;
+
+	y -= m <= 2;
+	yoe = y % 400;
+	doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	return (long)(y / 400) * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy;
+}
+
+double hb_sched_day(unsigned int year, unsigned int month, unsigned int mday)
+{
+	return civil_days(year, month, mday) -
+	       civil_days(HB_CAMPAIGN_YEAR, HB_CAMPAIGN_MONTH, 1);
+}
+
+/* Day on which month m of the campaign (from 0) starts */
+static double month_start(unsigned int m)
+{
+	m += HB_CAMPAIGN_MONTH - 1;
+	return hb_sched_day(HB_CAMPAIGN_YEAR + m / 12, m % 12 + 1, 1);
+}
+
+static unsigned int month_of(double day)
+{
+	unsigned int m = day > 0 ? day / 31 : 0;
+
+	while (month_start(m + 1) <= day)
+		m++;
+	return m;
+}
+
+void hb_sched_date(double day, unsigned int *year, unsigned int *month,
+		   unsigned int *mday)
+{
+	unsigned int m = month_of(day);
+
+	*mday = 1 + (unsigned int)(day - month_start(m));
+	m += HB_CAMPAIGN_MONTH - 1;
+	*year = HB_CAMPAIGN_YEAR + m / 12;
+	*month = m % 12 + 1;
+}
+
+/* Binary min-heaps, by key and then seq */
+
+struct item {
+	double key;
+	unsigned int seq;
+	unsigned int job;
+	unsigned int gen; /* for events: the job's, when it was started */
+};
+
+struct heap {
+	unsigned int n, cap;
+	struct item *a;
+};
+
+static bool before(const struct item *a, const struct item *b)
+{
+	if (a->key != b->key)
+		return a->key < b->key;
+	return a->seq < b->seq;
+}
+
+static int heap_push(struct heap *h, struct item it)
+{
+	unsigned int i, up;
+
+	if (h->n == h->cap) {
+		unsigned int cap = h->cap ? h->cap * 2 : 16;
+		void *a = realloc(h->a, cap * sizeof(*h->a));
+
+		if (!a)
+			return -ENOMEM;
+		h->a = a;
+		h->cap = cap;
+	}
+	for (i = h->n++; i; i = up) {
+		up = (i - 1) / 2;
+		if (!before(&it, h->a + up))
+			break;
+		h->a[i] = h->a[up];
+	}
+	h->a[i] = it;
+	return 0;
+}
+
+static struct item heap_pop(struct heap *h)
+{
+	struct item top = h->a[0], last = h->a[--h->n];
+	unsigned int i = 0, c;
+
+	while ((c = 2 * i + 1) < h->n) {
+		if (c + 1 < h->n && before(h->a + c + 1, h->a + c))
+			c++;
+		if (!before(h->a + c, &last))
+			break;
+		h->a[i] = h->a[c];
+		i = c;
+	}
+	h->a[i] = last;
+	return top;
+}
+
+/* The simulation.  Job j is slot j % HB_SLOTS of order j / HB_SLOTS. */
+
+struct slot_state {
+	int job; /* running, or -1 */
+	struct heap refit, fresh; /* waiting */
+};
+
+struct sim {
+	struct hb_order *o;
+	struct slot_state *slots; /* [manf * HB_SLOTS + slot] */
+	double *left, *seg; /* per job: days to go, and when last started */
+	unsigned int *gen; /* per job: bumped when it's paused */
+	unsigned int *pending; /* per order: jobs not done */
+	struct heap events;
+	unsigned int seq;
+	struct hb_sched_result *res;
+};
+
+#define ORDER(s, j)	((s)->o + (j) / HB_SLOTS)
+#define SLOT(s, j)	((s)->slots + ORDER(s, j)->manf * HB_SLOTS + (j) % HB_SLOTS)
+
+/* Spends amount evenly from day a to day b, or all on day a if b is no
+ * later
+ */
+static int spend(struct sim *s, double a, double b, double amount)
+{
+	struct hb_sched_result *res = s->res;
+	unsigned int m = month_of(a), months;
+	double rate = b > a ? amount / (b - a) : 0, end, x;
+	void *cash;
+
+	do {
+		if (m >= res->months) {
+			months = max(m + 1, res->months * 2);
+			cash = realloc(res->cash, months * sizeof(*res->cash));
+			if (!cash)
+				return -ENOMEM;
+			res->cash = cash;
+			memset(res->cash + res->months, 0,
+			       (months - res->months) * sizeof(*res->cash));
+			res->months = months;
+		}
+		end = min(b, month_start(m + 1));
+		x = b > a ? rate * (end - a) : amount;
+		res->cash[m] += x;
+		res->spent += x;
+		a = end;
+		m++;
+	} while (a < b);
+	return 0;
+}
+
+/* Spends what job j has run up since it was last started */
+static int bill(struct sim *s, unsigned int j, double now)
+{
+	const struct hb_order *o = ORDER(s, j);
+	unsigned int k = j % HB_SLOTS;
+
+	if (o->time[k] <= 0 || now <= s->seg[j])
+		return 0;
+	return spend(s, s->seg[j], now, o->cost[k] * (now - s->seg[j]) /
+					    o->time[k]);
+}
+
+static int dispatch(struct sim *s, struct slot_state *st, double now)
+{
+	struct hb_order *o;
+	unsigned int j, k;
+	int rc;
+
+	if (st->job >= 0 || (!st->refit.n && !st->fresh.n))
+		return 0;
+	j = heap_pop(st->refit.n ? &st->refit : &st->fresh).job;
+	o = ORDER(s, j);
+	k = j % HB_SLOTS;
+	if (isnan(o->start[k])) {
+		o->start[k] = now;
+		/* No time to spread it over */
+		if (o->time[k] <= 0) {
+			rc = spend(s, now, now, o->cost[k]);
+			if (rc)
+				return rc;
+		}
+	}
+	st->job = j;
+	s->seg[j] = now;
+	return heap_push(&s->events, (struct item){
+		.key = now + s->left[j], .seq = s->seq++, .job = j,
+		.gen = s->gen[j],
+	});
+}
+
+static int ready(struct sim *s, unsigned int j, double now)
+{
+	const struct hb_order *o = ORDER(s, j);
+	struct slot_state *st = SLOT(s, j);
+	struct item it = {.key = o->release, .seq = j, .job = j};
+	unsigned int k;
+	int rc;
+
+	rc = heap_push(o->refit ? &st->refit : &st->fresh, it);
+	if (rc)
+		return rc;
+	/* A refit pushes a fresh design aside, unless it's just finishing */
+	k = st->job;
+	if (o->refit && st->job >= 0 && !ORDER(s, k)->refit &&
+	    s->seg[k] + s->left[k] > now) {
+		rc = bill(s, k, now);
+		if (rc)
+			return rc;
+		s->left[k] -= now - s->seg[k];
+		s->gen[k]++;
+		ORDER(s, k)->paused++;
+		st->job = -1;
+		it = (struct item){.key = ORDER(s, k)->release, .seq = k,
+				   .job = k};
+		rc = heap_push(&st->fresh, it);
+		if (rc)
+			return rc;
+	}
+	return dispatch(s, st, now);
+}
+
+static int done(struct sim *s, unsigned int j, double now)
+{
+	struct hb_order *o = ORDER(s, j);
+	struct slot_state *st = SLOT(s, j);
+	unsigned int k = j % HB_SLOTS;
+	int rc;
+
+	rc = bill(s, j, now);
+	if (rc)
+		return rc;
+	s->left[j] = 0;
+	o->done[k] = now;
+	st->job = -1;
+	if (!--s->pending[j / HB_SLOTS])
+		o->service = now;
+	s->res->end = max(s->res->end, now);
+	if (k == HB_SLOT_PROTO && !o->direct) {
+		rc = ready(s, j + HB_SLOT_TOOL - HB_SLOT_PROTO, now);
+		if (rc)
+			return rc;
+	}
+	return dispatch(s, st, now);
+}
+
+/* Releases are events too, with a job number past the last */
+int hb_schedule(struct hb_order *orders, unsigned int n, unsigned int nmanf,
+		struct hb_sched_result *res)
+{
+	unsigned int njobs = n * HB_SLOTS, i, k;
+	struct sim s = {.o = orders, .res = res};
+	struct item ev;
+	int rc = -ENOMEM;
+
+	memset(res, 0, sizeof(*res));
+	for (i = 0; i < n; i++) {
+		struct hb_order *o = orders + i;
+
+		if (o->manf >= nmanf || !(o->release >= 0))
+			return -EINVAL;
+		for (k = 0; k < HB_SLOTS; k++) {
+			if (!(o->time[k] >= 0) || !(o->cost[k] >= 0))
+				return -EINVAL;
+			o->start[k] = o->done[k] = NAN;
+		}
+		o->paused = 0;
+		o->service = NAN;
+	}
+	s.slots = calloc((size_t)nmanf * HB_SLOTS, sizeof(*s.slots));
+	s.left = malloc(njobs * sizeof(*s.left));
+	s.seg = calloc(njobs, sizeof(*s.seg));
+	s.gen = calloc(njobs, sizeof(*s.gen));
+	s.pending = malloc(n * sizeof(*s.pending));
+	if (!s.slots || !s.left || !s.seg || !s.gen || !s.pending)
+		goto out;
+	for (i = 0; i < nmanf * HB_SLOTS; i++)
+		s.slots[i].job = -1;
+	for (i = 0; i < n; i++) {
+		s.pending[i] = HB_SLOTS;
+		for (k = 0; k < HB_SLOTS; k++)
+			s.left[i * HB_SLOTS + k] = orders[i].time[k];
+		rc = heap_push(&s.events, (struct item){
+			.key = orders[i].release, .seq = s.seq++,
+			.job = njobs + i,
+		});
+		if (rc)
+			goto out;
+	}
+
+	rc = 0;
+	while (!rc && s.events.n) {
+		ev = heap_pop(&s.events);
+		res->events++;
+		if (ev.job >= njobs) {
+			i = ev.job - njobs;
+			rc = ready(&s, i * HB_SLOTS + HB_SLOT_PROTO, ev.key);
+			if (!rc && orders[i].direct)
+				rc = ready(&s, i * HB_SLOTS + HB_SLOT_TOOL,
+					   ev.key);
+		} else if (ev.gen == s.gen[ev.job]) {
+			rc = done(&s, ev.job, ev.key);
+		}
+	}
+out:
+	if (s.slots)
+		for (i = 0; i < nmanf * HB_SLOTS; i++) {
+			free(s.slots[i].refit.a);
+			free(s.slots[i].fresh.a);
+		}
+	free(s.events.a);
+	free(s.pending);
+	free(s.gen);
+	free(s.seg);
+	free(s.left);
+	free(s.slots);
+	if (rc)
+		hb_sched_free(res);
+	return rc;
+}
+
+void hb_sched_free(struct hb_sched_result *res)
+{
+	free(res->cash);
+	res->cash = NULL;
+	res->months = 0;
+}
@@ -0,0 +1,62 @@
+#ifndef _PROGRAMME_H
+#define _PROGRAMME_H
+
+/* Development and production scheduling.
+ *
+ * Each manufacturer can have one design prototyping and one tooling for
+ * production at a time (see RULES.md).  An order is released on some day
+ * and then queues for its manufacturer's prototype slot; ordered off the
+ * drawing board it queues for the tooling slot at the same time, and
+ * otherwise only once its prototype is done.  A Mark or Mod refit goes
+ * ahead of any fresh design, pausing one that is already under way; the
+ * fresh design picks up where it left off afterwards.  Otherwise orders
+ * are taken first come (by release, then by order) first served.  Money
+ * is spent evenly over the days each job is worked on.
+ *
+ * hb_schedule() runs this as a discrete-event simulation, with a heap of
+ * events and heaps of waiting jobs for each slot.  Days count from the
+ * first of HB_CAMPAIGN_MONTH, HB_CAMPAIGN_YEAR.
+ */
+
+#include "research.h"
+
+enum hb_slot {
+	HB_SLOT_PROTO,
+	HB_SLOT_TOOL,
+
+	HB_SLOTS
+};
+
+struct hb_order {
+	unsigned int manf;
+	bool refit; /* a Mark or Mod */
+	bool direct; /* off the drawing board */
+	double release; /* day */
+	double time[HB_SLOTS]; /* days of work: tproto, tprod */
+	double cost[HB_SLOTS]; /* cproto, cprod */
+	/* Filled in by hb_schedule() */
+	double start[HB_SLOTS], done[HB_SLOTS];
+	unsigned int paused; /* times a refit pushed in */
+	double service; /* day it can enter service */
+};
+
+struct hb_sched_result {
+	double end; /* day the last job finished */
+	double spent;
+	/* cash[m]: spent in month m, from HB_CAMPAIGN_MONTH */
+	unsigned int months;
+	double *cash;
+	unsigned long events;
+};
+
+/* Days from the start of the campaign to the given date */
+double hb_sched_day(unsigned int year, unsigned int month, unsigned int mday);
+/* ...and back again; mday is from 1 */
+void hb_sched_date(double day, unsigned int *year, unsigned int *month,
+		   unsigned int *mday);
+
+int hb_schedule(struct hb_order *orders, unsigned int n, unsigned int nmanf,
+		struct hb_sched_result *res);
+void hb_sched_free(struct hb_sched_result *res);
+
+#endif // _PROGRAMME_H
@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "dice.h"
+#include "proto.h"
+
+/* Per worker */
+struct tally {
+	bool ready; /* worker's scratch bomber holds the base design */
+	unsigned long lemons, good;
+	double defn[2], range, accu, serv;
+};
+
+struct sim {
+	const struct bomber *base;
+	const struct tech_numbers *tn;
+	const struct hb_constraint *cons;
+	unsigned int ncons;
+	unsigned long long seed;
+	enum calc_stage from;
+	struct tally *t;
+};
+
+static int trial(void *ctx, struct hb_worker *w, unsigned long i)
+{
+	struct sim *m = ctx;
+	struct tally *t = hb_tally(m->t, sizeof(*t), w->id);
+	struct bomber *b = &w->b;
+	unsigned int unused = 0;
+	int rc;
+
+	if (!t->ready) {
+		*b = *m->base;
+		rc = calc_bomber(b, m->tn);
+		if (rc)
+			return rc;
+		t->ready = true;
+	}
+	b->dice = m->base->dice;
+	b->dice.seed = dice_roll(m->seed, i) | 1;
+	rc = do_randomise(b, &unused);
+	if (!rc)
+		rc = calc_bomber_from(b, m->tn, m->from);
+	if (rc)
+		return rc;
+	if (hb_violation(b, m->cons, m->ncons) > 0.0f) {
+		t->lemons++;
+		return 0;
+	}
+	t->good++;
+	t->defn[0] += b->defn[0];
+	t->defn[1] += b->defn[1];
+	t->range += b->range;
+	t->accu += b->accu;
+	t->serv += b->serv;
+	return 0;
+}
+
+int hb_proto_simulate(struct hb_pool *p, const struct bomber *b,
+		      const struct tech_numbers *tn, const struct hb_proto *o,
+		      struct hb_proto_result *res)
+{
+	struct sim m = {.tn = tn, .cons = o->cons, .ncons = o->ncons,
+			.seed = o->seed};
+	struct hb_constraint worse;
+	unsigned int n = hb_pool_size(p), i;
+	struct bomber *base;
+	struct tally sum = {}, *t;
+	double q;
+	int rc;
+
+	if (b->refit >= REFIT_LEVELS || !o->trials)
+		return -EINVAL;
+	base = malloc(sizeof(*base));
+	m.t = hb_tally_alloc(p, sizeof(*m.t));
+	if (!base || !m.t) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	/* The prediction: what the design looks like before the roll */
+	*base = *b;
+	if (base->refit == REFIT_FRESH)
+		memset(&base->dice, 0, sizeof(base->dice));
+	base->dice.rolled = false;
+	rc = calc_bomber(base, tn);
+	if (rc)
+		goto out;
+	m.base = base;
+	/* By default, a lemon is anything noticeably worse than predicted */
+	if (!m.ncons) {
+		worse = (struct hb_constraint){
+			.m = hb_find_metric("defn0"),
+			.le = true,
+			.value = base->defn[0] * (1.0f + HB_PROTO_SLACK),
+		};
+		m.cons = &worse;
+		m.ncons = 1;
+	}
+	m.from = hb_dice_from(base->refit);
+	rc = hb_parallel_for(p, o->trials, 0, trial, &m);
+	if (rc)
+		goto out;
+
+	for (i = 0; i < n; i++) {
+		t = hb_tally(m.t, sizeof(*t), i);
+		sum.lemons += t->lemons;
+		sum.good += t->good;
+		sum.defn[0] += t->defn[0];
+		sum.defn[1] += t->defn[1];
+		sum.range += t->range;
+		sum.accu += t->accu;
+		sum.serv += t->serv;
+	}
+	memset(res, 0, sizeof(*res));
+	res->trials = o->trials;
+	res->lemons = sum.lemons;
+	q = res->p_lemon = (double)sum.lemons / o->trials;
+	res->stderr_lemon = sqrt(q * (1.0 - q) / o->trials);
+	res->defn[0] = sum.defn[0] / sum.good;
+	res->defn[1] = sum.defn[1] / sum.good;
+	res->range = sum.range / sum.good;
+	res->accu = sum.accu / sum.good;
+	res->serv = sum.serv / sum.good;
+
+	res->direct = (struct hb_proto_strategy){
+		.cost = base->cproto + base->cprod,
+		.days = max(base->tproto, base->tprod),
+		.service = 1.0,
+		.lemon = q,
+	};
+	res->proto = (struct hb_proto_strategy){
+		.cost = base->cproto + (1.0 - q) * base->cprod,
+		.days = base->tproto + base->tprod,
+		.service = 1.0 - q,
+		.lemon = 0.0,
+	};
+out:
+	free(m.t);
+	free(base);
+	return rc;
+}
@@ -0,0 +1,55 @@
+#ifndef _PROTO_H
+#define _PROTO_H
+
+/* Prototype first, or order off the drawing board?
+ *
+ * Ordering off the drawing board runs prototyping and tooling side by
+ * side: the full cproto + cprod is spent, and the type enters service
+ * after max(tproto, tprod), lemon or not.  Prototyping first spends cproto
+ * and waits tproto to see how the dice fall; a lemon is then cancelled,
+ * and a good design goes on to tooling, entering service after
+ * tproto + tprod.
+ *
+ * hb_proto_simulate() rolls the prototype dice many times over, across the
+ * pool, to find how likely the design is to be a lemon, and what each
+ * choice can be expected to cost.  A lemon is a roll that leaves the
+ * design with errors or breaking any of the given constraints; with none
+ * given, one whose defn0 comes out more than HB_PROTO_SLACK worse than
+ * predicted.  Each trial's dice are keyed by the run's seed and the trial
+ * number (see pool.h).
+ */
+
+#include "opt.h"
+
+#define HB_PROTO_SLACK	0.05f
+
+struct hb_proto {
+	const struct hb_constraint *cons;
+	unsigned int ncons;
+	unsigned long trials;
+	unsigned int seed;
+};
+
+struct hb_proto_strategy {
+	double cost; /* expected funds spent */
+	double days; /* to service, if it gets there */
+	double service; /* probability it gets there */
+	double lemon; /* probability it's a lemon when it does */
+};
+
+struct hb_proto_result {
+	unsigned long trials, lemons;
+	double p_lemon, stderr_lemon;
+	/* Means over the non-lemon trials; NaN if there were none */
+	double defn[2], range, accu, serv;
+	struct hb_proto_strategy direct, proto;
+};
+
+/* b is not changed.  For a Mark or Mod the dice in b are taken as those it
+ * inherited, before its own roll.
+ */
+int hb_proto_simulate(struct hb_pool *p, const struct bomber *b,
+		      const struct tech_numbers *tn, const struct hb_proto *o,
+		      struct hb_proto_result *res);
+
+#endif // _PROTO_H
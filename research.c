@@ -0,0 +1,346 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "research.h"
+
+struct outcome {
+	int rc;
+	bool error;
+	float v[HB_MAX_GOALS];
+};
+
+struct survey {
+	const struct bomber *designs;
+	unsigned int n;
+	const struct tech_numbers *cand;
+	const struct hb_tech_value *val;
+	const struct hb_goal *goals;
+	unsigned int ngoals;
+	struct outcome *res;
+};
+
+static void measure(const struct survey *s, const struct bomber *b,
+		    struct outcome *r)
+{
+	unsigned int g;
+
+	r->error = b->error;
+	for (g = 0; g < s->ngoals; g++)
+		r->v[g] = s->goals[g].m->get(b);
+}
+
+static int eval_one(void *ctx, struct hb_worker *w, unsigned long i)
+{
+	struct survey *s = ctx;
+	unsigned int c = i / s->n, d = i % s->n;
+	struct outcome *r = s->res + (unsigned long)(c + 1) * s->n + d;
+
+	w->b = s->designs[d];
+	r->rc = calc_bomber_retech(&w->b, s->cand + c, s->val[c].from);
+	if (!r->rc)
+		measure(s, &w->b, r);
+	return 0;
+}
+
+/* Legalising designs first, then by the first goal */
+static int cmp_value(const void *a, const void *b)
+{
+	const struct hb_tech_value *x = a, *y = b;
+	int fx = x->fixed - x->broken, fy = y->fixed - y->broken;
+
+	if (fx != fy)
+		return fy - fx;
+	if (x->gain[0] != y->gain[0])
+		return x->gain[0] < y->gain[0] ? 1 : -1;
+	return x->tech - y->tech;
+}
+
+int hb_tech_values(struct hb_pool *p, const struct entities *ent,
+		   const struct tech_numbers *tn, struct bomber *designs,
+		   unsigned int n, const struct hb_goal *goals,
+		   unsigned int ngoals, struct hb_tech_value *val)
+{
+	struct survey s = {.designs = designs, .n = n, .goals = goals,
+			   .ngoals = ngoals, .val = val};
+	struct tech_numbers *cand;
+	unsigned int nc = 0, c, d, g, used;
+	int rc;
+
+	if (!n || !ngoals || ngoals > HB_MAX_GOALS)
+		return -EINVAL;
+	cand = malloc(ent->ntech * sizeof(*cand));
+	/* res[0..n) is the designs as they are, then n for each candidate */
+	s.res = calloc((size_t)(ent->ntech + 1) * n, sizeof(*s.res));
+	if (!cand || !s.res) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	for (d = 0; d < n; d++) {
+		s.res[d].rc = calc_bomber(designs + d, tn);
+		if (!s.res[d].rc)
+			measure(&s, designs + d, s.res + d);
+	}
+	for (c = 0; c < ent->ntech; c++) {
+		if (test_bit(tn->tech, c) || !tech_have_reqs(ent->tech[c], tn))
+			continue;
+		cand[nc] = *tn;
+		rc = hb_tech_add(ent, cand + nc, c);
+		if (rc < 0)
+			goto out;
+		memset(val + nc, 0, sizeof(*val));
+		val[nc].tech = c;
+		val[nc].from = calc_tn_stage(tn, cand + nc);
+		nc++;
+	}
+	s.cand = cand;
+	rc = nc ? hb_parallel_for(p, (unsigned long)nc * n, 0, eval_one, &s) :
+		  0;
+	if (rc)
+		goto out;
+
+	for (c = 0; c < nc; c++) {
+		const struct outcome *r = s.res + (unsigned long)(c + 1) * n;
+
+		used = 0;
+		for (d = 0; d < n; d++) {
+			const struct outcome *o = s.res + d;
+
+			if (r[d].rc || (!o->rc && !o->error && r[d].error)) {
+				val[c].broken++;
+				continue;
+			}
+			if (o->rc || o->error) {
+				if (!r[d].error)
+					val[c].fixed++;
+				continue;
+			}
+			for (g = 0; g < ngoals; g++) {
+				double gain = (r[d].v[g] - o->v[g]) /
+					      fmax(fabs(o->v[g]), 1e-6);
+
+				val[c].gain[g] += goals[g].maximise ? gain : -gain;
+			}
+			used++;
+		}
+		for (g = 0; used && g < ngoals; g++)
+			val[c].gain[g] /= used;
+	}
+	qsort(val, nc, sizeof(*val), cmp_value);
+	rc = nc;
+out:
+	free(s.res);
+	free(cand);
+	return rc;
+}
+
+#define HIST_LEN	(HB_CAMPAIGN_MONTHS + 1)
+
+int hb_campaign_month(const struct tech *t)
+{
+	/* Techs dated just by year come in January */
+	return ((int)t->year - HB_CAMPAIGN_YEAR) * 12 + (int)max(t->month, 1) -
+	       HB_CAMPAIGN_MONTH - 1;
+}
+
+enum slot_kind {
+	SLOT_EMPTY,
+	SLOT_TECH,
+	SLOT_SUPPORT,
+	SLOT_MOTHBALL,
+	SLOT_PRODENG,
+};
+
+struct slot {
+	enum slot_kind kind;
+	unsigned int j; /* index into pend[], for SLOT_TECH */
+};
+
+/* Per worker */
+struct campaign_tally {
+	unsigned long mothball, prodeng;
+	unsigned long hist[]; /* [ntech * HIST_LEN] */
+};
+
+struct campaign {
+	const struct hb_research_sim *o;
+	unsigned int start[BITSET_WORDS(MAX_TECHS)];
+	/* The techs still to research at the start, in date order */
+	unsigned int npend, pend[MAX_TECHS];
+	int date[MAX_TECHS];
+	unsigned int req[MAX_TECHS][BITSET_WORDS(MAX_TECHS)];
+	struct campaign_tally *t;
+	size_t tally_size;
+};
+
+/* The next of a campaign's rolls, from 0 to n - 1 */
+static unsigned int roll(unsigned long long key, unsigned int *idx,
+			 unsigned int n)
+{
+	return ((dice_roll(key, (*idx)++) >> 32) * n) >> 32;
+}
+
+static bool reqs_met(const unsigned int *req, const unsigned int *have)
+{
+	unsigned int w;
+
+	for (w = 0; w < BITSET_WORDS(MAX_TECHS); w++)
+		if (req[w] & ~have[w])
+			return false;
+	return true;
+}
+
+static int play(void *ctx, struct hb_worker *w, unsigned long i)
+{
+	struct campaign *c = ctx;
+	const struct hb_research_sim *o = c->o;
+	struct campaign_tally *t = hb_tally(c->t, c->tally_size, w->id);
+	unsigned long long key = dice_roll(o->seed, i);
+	unsigned int have[BITSET_WORDS(MAX_TECHS)], pend[MAX_TECHS];
+	unsigned int cur[MAX_TECHS], fut[MAX_TECHS];
+	unsigned int npend = c->npend, ncur, nfut, idx = 0, m, j, k, x, ns;
+	unsigned int prodeng;
+	struct slot slot[HB_RESEARCH_SLOTS];
+	bool mothball;
+
+	memcpy(have, c->start, sizeof(have));
+	memcpy(pend, c->pend, npend * sizeof(*pend));
+	for (m = 0; m < HB_CAMPAIGN_MONTHS; m++) {
+		/* What's on offer */
+		ncur = nfut = 0;
+		for (j = 0; j < npend; j++) {
+			x = pend[j];
+			if (c->date[x] > (int)(m + HB_RESEARCH_WINDOW))
+				break;
+			if (!reqs_met(c->req[x], have))
+				continue;
+			if (c->date[x] <= (int)m)
+				cur[ncur++] = j;
+			else
+				fut[nfut++] = j;
+		}
+		/* Fill the slots */
+		ns = 0;
+		if (nfut && roll(key, &idx, 100) < o->support) {
+			slot[ns++].kind = SLOT_SUPPORT;
+			slot[ns].kind = SLOT_TECH;
+			slot[ns++].j = fut[roll(key, &idx, nfut)];
+		}
+		mothball = true;
+		prodeng = o->types;
+		for (; ns < HB_RESEARCH_SLOTS; ns++) {
+			if (ncur && !(o->meta && roll(key, &idx, 100) < o->meta)) {
+				k = roll(key, &idx, ncur);
+				slot[ns].kind = SLOT_TECH;
+				slot[ns].j = cur[k];
+				cur[k] = cur[--ncur];
+			} else if (mothball || prodeng) {
+				k = roll(key, &idx, mothball + prodeng);
+				if (mothball && !k) {
+					slot[ns].kind = SLOT_MOTHBALL;
+					mothball = false;
+				} else {
+					slot[ns].kind = SLOT_PRODENG;
+					prodeng--;
+				}
+			} else {
+				slot[ns].kind = SLOT_EMPTY;
+			}
+		}
+		/* ...and see which one comes off */
+		k = roll(key, &idx, HB_RESEARCH_SLOTS);
+		switch (slot[k].kind) {
+		case SLOT_TECH:
+			j = slot[k].j;
+			x = pend[j];
+			set_bit(have, x);
+			t->hist[x * HIST_LEN + m]++;
+			/* Keeping the rest in date order */
+			memmove(pend + j, pend + j + 1,
+				(--npend - j) * sizeof(*pend));
+			break;
+		case SLOT_MOTHBALL:
+			t->mothball++;
+			break;
+		case SLOT_PRODENG:
+			t->prodeng++;
+			break;
+		default:
+			break;
+		}
+	}
+	for (j = 0; j < npend; j++)
+		t->hist[pend[j] * HIST_LEN + HB_CAMPAIGN_MONTHS]++;
+	return 0;
+}
+
+int hb_research_simulate(struct hb_pool *p, const struct entities *ent,
+			 const struct hb_research_sim *o,
+			 struct hb_research_result *res)
+{
+	unsigned int n = hb_pool_size(p), i, j, k;
+	size_t len = (size_t)ent->ntech * HIST_LEN;
+	const struct campaign_tally *tl;
+	struct campaign *c;
+	int rc = -ENOMEM;
+
+	memset(res, 0, sizeof(*res));
+	if (!o->campaigns || o->support > 100 || o->meta > 100)
+		return -EINVAL;
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		return -ENOMEM;
+	c->o = o;
+	c->tally_size = sizeof(*c->t) + len * sizeof(*c->t->hist);
+	c->t = hb_tally_alloc(p, c->tally_size);
+	if (!c->t)
+		goto out;
+	res->hist = calloc(len, sizeof(*res->hist));
+	if (!res->hist)
+		goto out;
+
+	for (i = 0; i < ent->ntech; i++) {
+		const struct tech *t = ent->tech[i];
+
+		c->date[i] = hb_campaign_month(t);
+		if (c->date[i] < 0) {
+			set_bit(c->start, i);
+			continue;
+		}
+		/* In date order, by insertion */
+		for (k = c->npend++; k && c->date[c->pend[k - 1]] > c->date[i];
+		     k--)
+			c->pend[k] = c->pend[k - 1];
+		c->pend[k] = i;
+		for (j = 0; j < ARRAY_SIZE(t->req) && t->req[j]; j++)
+			set_bit(c->req[i], t->req[j]->idx);
+	}
+	rc = hb_parallel_for(p, o->campaigns, 0, play, c);
+	if (rc)
+		goto out;
+
+	res->campaigns = o->campaigns;
+	res->ntech = ent->ntech;
+	memcpy(res->start, c->start, sizeof(res->start));
+	for (i = 0; i < n; i++) {
+		tl = hb_tally(c->t, c->tally_size, i);
+		for (k = 0; k < len; k++)
+			res->hist[k] += tl->hist[k];
+		res->mothball += tl->mothball;
+		res->prodeng += tl->prodeng;
+	}
+	res->mothball /= o->campaigns;
+	res->prodeng /= o->campaigns;
+out:
+	free(c->t);
+	free(c);
+	if (rc)
+		hb_research_free(res);
+	return rc;
+}
+
+void hb_research_free(struct hb_research_result *res)
+{
+	free(res->hist);
+	res->hist = NULL;
+}
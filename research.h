@@ -0,0 +1,108 @@
+#ifndef _RESEARCH_H
+#define _RESEARCH_H
+
+/* Research planning.
+ *
+ * hb_tech_values() weighs up each tech that could be researched next
+ * (its prerequisites are in the tech state, and it isn't) by what it
+ * would do for a set of designs.  Each candidate state is the current one
+ * plus that tech, applied with hb_tech_add(), and each design is only
+ * re-run from the first calculation stage that reads a tech number the
+ * tech changes.  Candidates and designs are spread over the pool.
+ */
+
+#include "opt.h"
+
+#define HB_MAX_GOALS	8
+
+struct hb_goal {
+	const struct hb_metric *m;
+	bool maximise;
+};
+
+struct hb_tech_value {
+	unsigned int tech; /* index into ent->tech */
+	enum calc_stage from; /* first stage it affects */
+	/* Mean relative improvement in each goal, over the designs that
+	 * are free of errors with and without the tech
+	 */
+	double gain[HB_MAX_GOALS];
+	unsigned int fixed; /* designs it rids of errors */
+	unsigned int broken; /* designs it gives errors, or failed */
+};
+
+/* Fills in val[] for each candidate, best first (most designs rid of
+ * errors, less those given them, then gain[0]), and returns how many
+ * there are (at most ent->ntech), or a negative error.  The
+ * designs are evaluated in place under tn.
+ */
+int hb_tech_values(struct hb_pool *p, const struct entities *ent,
+		   const struct tech_numbers *tn, struct bomber *designs,
+		   unsigned int n, const struct hb_goal *goals,
+		   unsigned int ngoals, struct hb_tech_value *val);
+
+/* Research over the campaign, as RULES.md has it.
+ *
+ * The campaign opens in HB_CAMPAIGN_MONTH of HB_CAMPAIGN_YEAR with every
+ * tech dated no later already researched, and then each month to the end
+ * of HB_CAMPAIGN_LAST offers the techs whose prerequisites are met and
+ * which are dated no more than HB_RESEARCH_WINDOW months ahead.  The
+ * player fills HB_RESEARCH_SLOTS slots, each with a tech or a meta:
+ * Supporting Research (which lets one other slot hold a tech dated in
+ * the future), Mothball Labs, or Production Engineering for one of the
+ * types in production.  At the end of the month one slot, picked at
+ * random, takes effect: a tech is researched, Mothball Labs adds to the
+ * budget, Production Engineering to its type's production, and
+ * Supporting Research does nothing.
+ *
+ * hb_research_simulate() plays many campaigns, over the pool, with a
+ * player who
+ *  - slots Supporting Research and a future tech, picked at random, in
+ *    support percent of the months in which there is one,
+ *  - fills each other slot with a meta in meta percent of cases, and
+ *    otherwise with a tech of this month or earlier picked at random
+ *    (or a meta if there are none, or an empty slot if they're used up),
+ * and counts in which month each tech was researched.  Each campaign's
+ * rolls are keyed by the run's seed and the campaign number (see pool.h).
+ */
+
+#define HB_CAMPAIGN_YEAR	1939
+#define HB_CAMPAIGN_MONTH	9
+#define HB_CAMPAIGN_LAST	1945
+#define HB_CAMPAIGN_LAST_MONTH	5
+/* Research months, from the one after HB_CAMPAIGN_MONTH */
+#define HB_CAMPAIGN_MONTHS	((HB_CAMPAIGN_LAST - HB_CAMPAIGN_YEAR) * 12 + \
+				 HB_CAMPAIGN_LAST_MONTH - HB_CAMPAIGN_MONTH)
+#define HB_RESEARCH_SLOTS	3
+#define HB_RESEARCH_WINDOW	6
+
+struct hb_research_sim {
+	unsigned long campaigns;
+	unsigned int seed;
+	unsigned int support, meta; /* percent */
+	unsigned int types; /* in production, each with its own meta */
+};
+
+struct hb_research_result {
+	unsigned long campaigns;
+	unsigned int ntech;
+	unsigned int start[BITSET_WORDS(MAX_TECHS)]; /* researched at the start */
+	/* hist[t * (HB_CAMPAIGN_MONTHS + 1) + m]: campaigns in which tech t
+	 * was researched in month m (from 0); m = HB_CAMPAIGN_MONTHS for never
+	 */
+	unsigned long *hist;
+	double mothball, prodeng; /* mean times each took effect */
+};
+
+/* Month m (from 0) is month (HB_CAMPAIGN_MONTH + m) % 12 + 1 of
+ * HB_CAMPAIGN_YEAR + (HB_CAMPAIGN_MONTH + m) / 12; a tech's date is
+ * negative if it is researched at the start.
+ */
+int hb_campaign_month(const struct tech *t);
+
+int hb_research_simulate(struct hb_pool *p, const struct entities *ent,
+			 const struct hb_research_sim *o,
+			 struct hb_research_result *res);
+void hb_research_free(struct hb_research_result *res);
+
+#endif // _RESEARCH_H
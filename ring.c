@@ -0,0 +1,372 @@
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ring.h"
+
+#define RING_MAGIC	0x48425231 /* "HBR1" */
+#define RING_MAX_ORDER	20
+#define CACHELINE	64
+
+/* Each slot carries a sequence number, as in Vyukov's bounded MPMC queue:
+ * seq == pos means the slot is free for the producer claiming position
+ * pos, and seq == pos + 1 means it holds the record for position pos.
+ */
+struct slot {
+	atomic_ulong seq;
+	union {
+		struct hb_design_in in;
+		struct hb_result out;
+	};
+} __attribute__((aligned(CACHELINE)));
+
+struct queue {
+	atomic_ulong head __attribute__((aligned(CACHELINE)));
+	atomic_ulong tail __attribute__((aligned(CACHELINE)));
+};
+
+struct ring_shm {
+	unsigned int magic;
+	unsigned int order;
+	unsigned int in_size, out_size; /* catch mismatched builds */
+	sem_t sq_bell, cq_bell;
+	/* results submitted but not yet reaped; bounded by the ring size, so
+	 * the completion queue can never fill up on a worker
+	 */
+	atomic_uint outstanding __attribute__((aligned(CACHELINE)));
+	struct queue sq, cq;
+	struct slot slots[]; /* sq, then cq */
+};
+
+struct hb_ring {
+	struct ring_shm *shm;
+	size_t len;
+	unsigned long mask;
+	struct slot *sq, *cq;
+};
+
+static int shm_name(const char *name, char *buf, size_t len)
+{
+	if (strchr(name, '/'))
+		return -EINVAL;
+	if (snprintf(buf, len, "/%s", name) >= len)
+		return -ENAMETOOLONG;
+	return 0;
+}
+
+static size_t ring_len(unsigned int order)
+{
+	return sizeof(struct ring_shm) + (2ul << order) * sizeof(struct slot);
+}
+
+static int ring_map(int fd, size_t len, struct hb_ring **r)
+{
+	struct hb_ring *ring;
+	void *p;
+
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		return -errno;
+	ring = malloc(sizeof(*ring));
+	if (!ring) {
+		munmap(p, len);
+		return -ENOMEM;
+	}
+	ring->shm = p;
+	ring->len = len;
+	*r = ring;
+	return 0;
+}
+
+static void ring_setup(struct hb_ring *r)
+{
+	r->mask = (1ul << r->shm->order) - 1;
+	r->sq = r->shm->slots;
+	r->cq = r->shm->slots + r->mask + 1;
+}
+
+int hb_ring_create(const char *name, unsigned int order, struct hb_ring **r)
+{
+	char path[NAME_MAX];
+	struct ring_shm *shm;
+	unsigned long i;
+	size_t len;
+	int fd, rc;
+
+	if (order > RING_MAX_ORDER)
+		return -EINVAL;
+	rc = shm_name(name, path, sizeof(path));
+	if (rc)
+		return rc;
+	shm_unlink(path);
+	fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0)
+		return -errno;
+	len = ring_len(order);
+	if (ftruncate(fd, len)) {
+		rc = -errno;
+		goto out_unlink;
+	}
+	rc = ring_map(fd, len, r);
+	if (rc)
+		goto out_unlink;
+	close(fd);
+	shm = (*r)->shm;
+	shm->order = order;
+	shm->in_size = sizeof(struct hb_design_in);
+	shm->out_size = sizeof(struct hb_result);
+	if (sem_init(&shm->sq_bell, 1, 0) || sem_init(&shm->cq_bell, 1, 0)) {
+		rc = -errno;
+		hb_ring_close(*r);
+		shm_unlink(path);
+		return rc;
+	}
+	ring_setup(*r);
+	for (i = 0; i <= (*r)->mask; i++) {
+		atomic_init(&(*r)->sq[i].seq, i);
+		atomic_init(&(*r)->cq[i].seq, i);
+	}
+	/* Publish last, so that clients never see a half-built ring */
+	atomic_thread_fence(memory_order_release);
+	shm->magic = RING_MAGIC;
+	return 0;
+out_unlink:
+	close(fd);
+	shm_unlink(path);
+	return rc;
+}
+
+int hb_ring_open(const char *name, struct hb_ring **r)
+{
+	char path[NAME_MAX];
+	struct ring_shm *shm;
+	struct stat st;
+	int fd, rc;
+
+	rc = shm_name(name, path, sizeof(path));
+	if (rc)
+		return rc;
+	fd = shm_open(path, O_RDWR, 0);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st)) {
+		rc = -errno;
+		close(fd);
+		return rc;
+	}
+	if (st.st_size < sizeof(*shm)) {
+		close(fd);
+		return -EPROTO;
+	}
+	rc = ring_map(fd, st.st_size, r);
+	close(fd);
+	if (rc)
+		return rc;
+	shm = (*r)->shm;
+	if (shm->magic != RING_MAGIC || shm->order > RING_MAX_ORDER ||
+	    ring_len(shm->order) > st.st_size ||
+	    shm->in_size != sizeof(struct hb_design_in) ||
+	    shm->out_size != sizeof(struct hb_result)) {
+		hb_ring_close(*r);
+		return -EPROTO;
+	}
+	ring_setup(*r);
+	return 0;
+}
+
+void hb_ring_close(struct hb_ring *r)
+{
+	munmap(r->shm, r->len);
+	free(r);
+}
+
+int hb_ring_unlink(const char *name)
+{
+	char path[NAME_MAX];
+	int rc;
+
+	rc = shm_name(name, path, sizeof(path));
+	if (rc)
+		return rc;
+	if (shm_unlink(path))
+		return -errno;
+	return 0;
+}
+
+/* Claims the next slot to fill, or NULL if the queue is full */
+static struct slot *claim_tail(struct queue *q, struct slot *slots,
+			       unsigned long mask, unsigned long *pos)
+{
+	unsigned long p = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+	for (;;) {
+		struct slot *s = slots + (p & mask);
+		unsigned long seq = atomic_load_explicit(&s->seq,
+							 memory_order_acquire);
+		long dif = (long)(seq - p);
+
+		if (!dif) {
+			if (atomic_compare_exchange_weak_explicit(&q->tail,
+					&p, p + 1, memory_order_relaxed,
+					memory_order_relaxed))
+				break;
+		} else if (dif < 0) {
+			return NULL;
+		} else {
+			p = atomic_load_explicit(&q->tail,
+						 memory_order_relaxed);
+		}
+	}
+	*pos = p;
+	return slots + (p & mask);
+}
+
+/* Claims the next full slot, or NULL if the queue is empty */
+static struct slot *claim_head(struct queue *q, struct slot *slots,
+			       unsigned long mask, unsigned long *pos)
+{
+	unsigned long p = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+	for (;;) {
+		struct slot *s = slots + (p & mask);
+		unsigned long seq = atomic_load_explicit(&s->seq,
+							 memory_order_acquire);
+		long dif = (long)(seq - (p + 1));
+
+		if (!dif) {
+			if (atomic_compare_exchange_weak_explicit(&q->head,
+					&p, p + 1, memory_order_relaxed,
+					memory_order_relaxed))
+				break;
+		} else if (dif < 0) {
+			return NULL;
+		} else {
+			p = atomic_load_explicit(&q->head,
+						 memory_order_relaxed);
+		}
+	}
+	*pos = p;
+	return slots + (p & mask);
+}
+
+static void fill_done(struct slot *s, unsigned long pos)
+{
+	atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
+}
+
+static void take_done(struct slot *s, unsigned long pos, unsigned long mask)
+{
+	atomic_store_explicit(&s->seq, pos + mask + 1, memory_order_release);
+}
+
+int hb_ring_submit(struct hb_ring *r, const struct hb_design_in *in,
+		   unsigned int n)
+{
+	unsigned int size = r->mask + 1, old, i;
+	unsigned long pos;
+	struct slot *s;
+
+	/* Reserve completion space for the whole batch up front */
+	old = atomic_load(&r->shm->outstanding);
+	do {
+		if (old >= size)
+			return 0;
+		if (n > size - old)
+			n = size - old;
+	} while (!atomic_compare_exchange_weak(&r->shm->outstanding, &old,
+					       old + n));
+	/* With outstanding <= size, the sq can't be full either */
+	for (i = 0; i < n; i++) {
+		s = claim_tail(&r->shm->sq, r->sq, r->mask, &pos);
+		if (!s)
+			return -EIO; /* can't happen */
+		s->in = in[i];
+		fill_done(s, pos);
+	}
+	if (n && sem_post(&r->shm->sq_bell))
+		return -errno;
+	return n;
+}
+
+int hb_ring_reap(struct hb_ring *r, struct hb_result *out,
+		 unsigned int max)
+{
+	unsigned long pos;
+	unsigned int i;
+	struct slot *s;
+
+	for (i = 0; i < max; i++) {
+		s = claim_head(&r->shm->cq, r->cq, r->mask, &pos);
+		if (!s)
+			break;
+		out[i] = s->out;
+		take_done(s, pos, r->mask);
+	}
+	atomic_fetch_sub(&r->shm->outstanding, i);
+	return i;
+}
+
+int hb_ring_wait(struct hb_ring *r)
+{
+	while (sem_wait(&r->shm->cq_bell))
+		if (errno != EINTR)
+			return -errno;
+	return 0;
+}
+
+int hb_ring_work(struct hb_ring *r, const struct entities *ent)
+{
+	struct hb_result out;
+	unsigned long pos, cpos;
+	struct slot *s, *c;
+	struct hb_worker *w;
+	int rc = 0;
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return -ENOMEM;
+	for (;;) {
+		unsigned int done = 0;
+
+		while ((s = claim_head(&r->shm->sq, r->sq, r->mask, &pos))) {
+			struct hb_design_in in = s->in;
+
+			take_done(s, pos, r->mask);
+			/* Woken for a batch?  If there's more than we took,
+			 * wake another worker to help with it.
+			 */
+			if (!done && atomic_load(&r->shm->sq.tail) != pos + 1)
+				sem_post(&r->shm->sq_bell);
+			hb_eval_packed(ent, w, &in, &out);
+			/* Claim the cq slot only now, so that a slow design
+			 * doesn't hold up reaping of the results behind it.
+			 */
+			c = claim_tail(&r->shm->cq, r->cq, r->mask, &cpos);
+			if (!c) { /* client broke the outstanding count */
+				rc = -EIO;
+				goto out;
+			}
+			c->out = out;
+			fill_done(c, cpos);
+			done++;
+		}
+		if (done && sem_post(&r->shm->cq_bell)) {
+			rc = -errno;
+			goto out;
+		}
+		while (sem_wait(&r->shm->sq_bell))
+			if (errno != EINTR) {
+				rc = -errno;
+				goto out;
+			}
+	}
+out:
+	free(w);
+	return rc;
+}
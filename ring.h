@@ -0,0 +1,55 @@
+#ifndef _RING_H
+#define _RING_H
+
+/* Shared-memory request rings, for clients on the same machine.
+ *
+ * A ring is a POSIX shared memory object holding a submission queue of
+ * struct hb_design_in and a completion queue of struct hb_result.  Both
+ * are bounded MPMC queues, so any number of client threads (in any number
+ * of processes) may submit and reap, and any number of workers may serve.
+ * Records are copied in and out of the shared slots; nothing is parsed or
+ * formatted, and no syscalls are made per request.  Instead each side has
+ * a doorbell (a process-shared semaphore): a client rings the server once
+ * per batch it submits, and a worker rings the client once each time it
+ * has drained the submission queue.
+ *
+ * Client:
+ *	hb_ring_open("name", &r);
+ *	hb_ring_submit(r, ins, n);
+ *	while (have < n) {
+ *		got = hb_ring_reap(r, outs + have, n - have);
+ *		if (!got)
+ *			hb_ring_wait(r);
+ *		have += got;
+ *	}
+ *
+ * Results are reaped in completion order, not submission order; match
+ * them up by tag.
+ */
+
+#include "hbuilder.h"
+
+struct hb_ring;
+
+/* Creates (replacing any old one) a ring with 2^order slots per queue */
+int hb_ring_create(const char *name, unsigned int order, struct hb_ring **r);
+int hb_ring_open(const char *name, struct hb_ring **r);
+void hb_ring_close(struct hb_ring *r);
+int hb_ring_unlink(const char *name);
+
+/* Queues up to n requests and rings the doorbell; returns the number
+ * queued, which is less than n if that many results are outstanding
+ * (submitted but not yet reaped) that the ring is full.
+ */
+int hb_ring_submit(struct hb_ring *r, const struct hb_design_in *in,
+		   unsigned int n);
+/* Takes up to max results without blocking; returns the number taken */
+int hb_ring_reap(struct hb_ring *r, struct hb_result *out,
+		 unsigned int max);
+/* Waits for the server to ring the completion doorbell */
+int hb_ring_wait(struct hb_ring *r);
+
+/* Serves requests from the ring, forever.  Run one per worker thread. */
+int hb_ring_work(struct hb_ring *r, const struct entities *ent);
+
+#endif // _RING_H
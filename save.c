@@ -2,7 +2,6 @@
 #include <string.h>
 #include <errno.h>
 #include "save.h"
-#include "edit.h"
 #include "parse.h"
 
 static void save_tn(FILE *f, const struct tech_numbers *tn)
@@ -82,20 +81,14 @@ int save_design(FILE *f, const struct bomber *b)
 		b->tanks.sst ? 1 : 0);
 	fprintf(f, "MTW=%u:USR=%u\n", b->mtow, b->user_mtow ? 1 : 0);
 	fprintf(f, "RFL=%u\n", b->refit);
-	fprintf(f, "RND=%u:DRG=%d:SRV=%d:VUL=%d:MNU=%d:ACC=%d\n",
+	fprintf(f, "RND=%u:DRG=%d:SRV=%d:VUL=%d:MNU=%d:ACC=%d:SED=%llx\n",
 		b->dice.rolled ? 1 : 0, b->dice.drag, b->dice.serv,
-		b->dice.vuln, b->dice.manu, b->dice.accu);
+		b->dice.vuln, b->dice.manu, b->dice.accu, b->dice.seed);
 	save_tn(f, &b->tn);
 	fprintf(f, "EOD\n");
 	return 0;
 }
 
-struct loaddata {
-	struct bomber *b;
-	const struct entities *ent;
-	unsigned int ei, ti, tn;
-};
-
 static void load_error(struct loaddata *l, const char *format, ...)
 {
 	va_list ap;
@@ -326,6 +319,13 @@ LOADER_INT(vul, dice.vuln);
 LOADER_INT(mnu, dice.manu);
 LOADER_INT(acc, dice.accu);
 
+static int load_sed(const char *value, struct loaddata *l)
+{
+	if (sscanf(value, "%llx", &l->b->dice.seed) != 1)
+		return -EINVAL;
+	return 0;
+}
+
 static int load_tn(const char *value, struct loaddata *l)
 {
 	if (sscanf(value, "%u", &l->tn) != 1)
@@ -372,6 +372,7 @@ struct loadkey {
 	{"VUL", load_vul},
 	{"MNU", load_mnu},
 	{"ACC", load_acc},
+	{"SED", load_sed},
 	{"TN", load_tn},
 	{"EOD", load_eod},
 };
@@ -394,7 +395,8 @@ static int load_design_word(const char *key, const char *value, void *data)
 	return -ENOENT;
 }
 
-static int load_design_line(const char *line, void *data)
+/* Returns 1 once the EOD line has been seen */
+int load_design_line(const char *line, void *data)
 {
 	struct loaddata *l = data;
 
@@ -402,20 +404,31 @@ static int load_design_line(const char *line, void *data)
 	return for_each_word(line, load_design_word, l);
 }
 
-int load_design(FILE *f, struct bomber *b, const struct entities *ent)
+void load_design_start(struct loaddata *l, struct bomber *b,
+		       const struct entities *ent)
 {
-	struct loaddata l = {b, ent};
-	int fd = fileno(f), rc;
+	memset(l, 0, sizeof(*l));
+	l->b = b;
+	l->ent = ent;
 
 	memset(b, 0, sizeof(*b));
 	b->manf = ent->manf[0];
 	b->engines.typ = b->engines.mou = ent->eng[0];
 	b->parent = b;
+}
+
+int load_design(FILE *f, struct bomber *b, const struct entities *ent)
+{
+	int fd = fileno(f), rc;
+	struct loaddata l;
 
+	load_design_start(&l, b, ent);
 	if (fd < 0) {
 		load_error(&l, "Invalid stream!");
 		return -EBADF;
 	}
 	rc = for_each_line(fd, load_design_line, &l);
+	if (!rc) /* nothing left in the file */
+		return -ENODATA;
 	return rc > 0 ? 0 : rc;
 }
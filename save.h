@@ -7,4 +7,17 @@
 int save_design(FILE *f, const struct bomber *b);
 int load_design(FILE *f, struct bomber *b, const struct entities *ent);
 
+/* For loading a design a line at a time, from a stream that can't be
+ * handed to load_design() (such as a socket).
+ */
+struct loaddata {
+	struct bomber *b;
+	const struct entities *ent;
+	unsigned int ei, ti, tn;
+};
+
+void load_design_start(struct loaddata *l, struct bomber *b,
+		       const struct entities *ent);
+int load_design_line(const char *line, void *data);
+
 #endif // _SAVE_H
@@ -0,0 +1,446 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "serve.h"
+#include "hbuilder.h"
+#include "parse.h"
+#include "save.h"
+
+/* Protocol.  Requests are lines of colon-separated KEY=value words, like
+ * the save file format.
+ *	TST=<id>:BIT=<hex>
+ * defines tech state <id> (0-255) for this connection, from a bitset as
+ * taken by hb_tech_hex().
+ *	REQ=<tag>:TST=<id>	or	REQ=<tag>:BIT=<hex>
+ * is followed by a design in save file format, ending with EOD.  Each one
+ * gets a single line of response,
+ *	RES=<tag>:RC=<rc>:ERR=<0/1>:WRN=<count>:TAR=<tare>:...
+ * though not necessarily in the order the requests were sent; a client
+ * can have any number of requests in flight.  A bad TST line is answered
+ * with TST=<id>:RC=<rc>.
+ */
+
+#define MAX_TST		256
+#define TAG_LEN		32
+#define LINE_LEN	256
+
+struct conn {
+	int in, out;
+	pthread_mutex_t wlock; /* serialises writes to out */
+	pthread_mutex_t lock; /* protects inflight */
+	pthread_cond_t idle;
+	unsigned int inflight;
+	struct tech_numbers *tst[MAX_TST];
+};
+
+struct job {
+	struct job *next;
+	struct conn *conn;
+	const struct tech_numbers *tn;
+	struct tech_numbers own;
+	char tag[TAG_LEN];
+	struct bomber b;
+};
+
+struct server {
+	const struct entities *ent;
+	pthread_mutex_t lock; /* protects all below */
+	pthread_cond_t more, gone;
+	struct job *head, **tail;
+	unsigned int conns; /* socket connections being served */
+	bool stop; /* workers exit once the queue is empty */
+};
+
+static void reply(struct conn *c, const char *line, size_t len)
+{
+	/* A client that hangs up early just loses its answers */
+	while (len) {
+		ssize_t bytes = write(c->out, line, len);
+
+		if (bytes < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		line += bytes;
+		len -= bytes;
+	}
+}
+
+static void reply_result(struct conn *c, const char *tag, int rc,
+			 const struct bomber *b)
+{
+	struct hb_outputs o;
+	char line[LINE_LEN * 2];
+	int len;
+
+	if (rc >= 0 && b)
+		hb_outputs(b, &o);
+	len = hb_format_result(line, sizeof(line), tag, rc,
+			       rc >= 0 && b ? &o : NULL);
+	pthread_mutex_lock(&c->wlock);
+	reply(c, line, min((size_t)len, sizeof(line) - 1));
+	pthread_mutex_unlock(&c->wlock);
+}
+
+static void *worker(void *data)
+{
+	struct server *s = data;
+	struct job *j;
+	int rc;
+
+	do {
+		pthread_mutex_lock(&s->lock);
+		while (!s->head && !s->stop)
+			pthread_cond_wait(&s->more, &s->lock);
+		j = s->head;
+		if (!j) {
+			pthread_mutex_unlock(&s->lock);
+			break;
+		}
+		s->head = j->next;
+		if (!s->head)
+			s->tail = &s->head;
+		pthread_mutex_unlock(&s->lock);
+
+		rc = hb_evaluate(&j->b, j->tn);
+		reply_result(j->conn, j->tag, rc, &j->b);
+
+		pthread_mutex_lock(&j->conn->lock);
+		if (!--j->conn->inflight)
+			pthread_cond_signal(&j->conn->idle);
+		pthread_mutex_unlock(&j->conn->lock);
+		free(j);
+	} while (1);
+	return NULL;
+}
+
+static void submit(struct server *s, struct job *j)
+{
+	pthread_mutex_lock(&j->conn->lock);
+	j->conn->inflight++;
+	pthread_mutex_unlock(&j->conn->lock);
+
+	j->next = NULL;
+	pthread_mutex_lock(&s->lock);
+	*s->tail = j;
+	s->tail = &j->next;
+	pthread_cond_signal(&s->more);
+	pthread_mutex_unlock(&s->lock);
+}
+
+struct linebuf {
+	char buf[LINE_LEN * 16];
+	size_t from, to;
+};
+
+/* Returns 1 with *line set, 0 on EOF, or -errno */
+static int read_line(int fd, struct linebuf *lb, char **line)
+{
+	ssize_t bytes;
+	char *nl;
+
+	do {
+		nl = memchr(lb->buf + lb->from, '\n', lb->to - lb->from);
+		if (nl) {
+			*nl = 0;
+			*line = lb->buf + lb->from;
+			lb->from = nl + 1 - lb->buf;
+			return 1;
+		}
+		if (lb->to - lb->from >= LINE_LEN)
+			return -EIO; /* line too long */
+		memmove(lb->buf, lb->buf + lb->from, lb->to - lb->from);
+		lb->to -= lb->from;
+		lb->from = 0;
+		bytes = read(fd, lb->buf + lb->to, sizeof(lb->buf) - lb->to);
+		if (bytes < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (!bytes)
+			return 0;
+		lb->to += bytes;
+	} while (1);
+}
+
+struct header {
+	struct server *s;
+	struct conn *c;
+	char tag[TAG_LEN];
+	const struct tech_numbers *tn;
+	struct tech_numbers own;
+	int tst, rc;
+	bool req;
+};
+
+static int parse_tst(const char *value, int *id)
+{
+	unsigned int v;
+
+	if (!value || sscanf(value, "%u", &v) != 1 || v >= MAX_TST)
+		return -EINVAL;
+	*id = v;
+	return 0;
+}
+
+static int header_word(const char *key, const char *value, void *data)
+{
+	struct header *h = data;
+
+	if (!strcmp(key, "REQ") && value) {
+		h->req = true;
+		snprintf(h->tag, sizeof(h->tag), "%s", value);
+		return 0;
+	}
+	if (!strcmp(key, "TST")) {
+		/* Looked up once the whole line is in, as REQ= may follow */
+		h->rc = parse_tst(value, &h->tst);
+		return 0;
+	}
+	if (!strcmp(key, "BIT") && value) {
+		h->rc = hb_tech_hex(h->s->ent, value, &h->own);
+		h->tn = &h->own;
+		return 0;
+	}
+	h->rc = -EINVAL;
+	return 0;
+}
+
+static void define_tst(struct conn *c, struct header *h)
+{
+	char line[LINE_LEN];
+	int len;
+
+	if (!h->rc && h->tn != &h->own)
+		h->rc = -EINVAL; /* no BIT= */
+	if (!h->rc && c->tst[h->tst])
+		h->rc = -EEXIST; /* might be in use by in-flight jobs */
+	if (!h->rc) {
+		c->tst[h->tst] = malloc(sizeof(h->own));
+		if (!c->tst[h->tst])
+			h->rc = -ENOMEM;
+		else
+			*c->tst[h->tst] = h->own;
+	}
+	if (h->rc) {
+		len = snprintf(line, sizeof(line), "TST=%d:RC=%d\n", h->tst,
+			       h->rc);
+		pthread_mutex_lock(&c->wlock);
+		reply(c, line, len);
+		pthread_mutex_unlock(&c->wlock);
+	}
+}
+
+static int serve_conn(struct server *s, int in, int out)
+{
+	struct job *j = NULL;
+	struct linebuf *lb;
+	struct loaddata l;
+	struct header h;
+	struct conn c;
+	unsigned int i;
+	int rc, lrc = 0;
+	char *line;
+
+	memset(&c, 0, sizeof(c));
+	c.in = in;
+	c.out = out;
+	pthread_mutex_init(&c.wlock, NULL);
+	pthread_mutex_init(&c.lock, NULL);
+	pthread_cond_init(&c.idle, NULL);
+	lb = calloc(1, sizeof(*lb));
+	if (!lb)
+		return -ENOMEM;
+
+	while ((rc = read_line(in, lb, &line)) > 0) {
+		if (j) {
+			/* Inside a design record */
+			if (!lrc)
+				lrc = load_design_line(line, &l);
+			if (!strcmp(line, "EOD")) {
+				if (lrc < 0) {
+					reply_result(&c, j->tag, lrc, NULL);
+					free(j);
+				} else {
+					submit(s, j);
+				}
+				j = NULL;
+			}
+			continue;
+		}
+		if (!*line)
+			continue;
+		memset(&h, 0, sizeof(h));
+		h.s = s;
+		h.c = &c;
+		h.tst = -1;
+		for_each_word(line, header_word, &h);
+		if (!h.req) {
+			if (h.tst >= 0)
+				define_tst(&c, &h);
+			else /* so a client with a typo isn't left waiting */
+				reply_result(&c, "", h.rc ? h.rc : -EINVAL, NULL);
+			continue;
+		}
+		if (!h.rc && !h.tn && h.tst >= 0) {
+			h.tn = c.tst[h.tst];
+			if (!h.tn)
+				h.rc = -ENOENT;
+		}
+		j = malloc(sizeof(*j));
+		if (!j) {
+			rc = -ENOMEM;
+			break;
+		}
+		j->conn = &c;
+		memcpy(j->tag, h.tag, sizeof(j->tag));
+		load_design_start(&l, &j->b, s->ent);
+		lrc = h.rc;
+		if (!lrc && !h.tn)
+			lrc = -EINVAL; /* no tech state given */
+		if (h.tn == &h.own) {
+			/* Only valid for this request; keep it with the job */
+			j->own = h.own;
+			j->tn = &j->own;
+		} else {
+			j->tn = h.tn;
+		}
+	}
+	free(j);
+
+	pthread_mutex_lock(&c.lock);
+	while (c.inflight)
+		pthread_cond_wait(&c.idle, &c.lock);
+	pthread_mutex_unlock(&c.lock);
+	for (i = 0; i < MAX_TST; i++)
+		free(c.tst[i]);
+	free(lb);
+	return rc;
+}
+
+static void *conn_thread(void *data)
+{
+	struct server *s = ((void **)data)[0];
+	int fd = (long)((void **)data)[1];
+
+	free(data);
+	serve_conn(s, fd, fd);
+	close(fd);
+	pthread_mutex_lock(&s->lock);
+	if (!--s->conns)
+		pthread_cond_signal(&s->gone);
+	pthread_mutex_unlock(&s->lock);
+	return NULL;
+}
+
+static int serve_socket(struct server *s, const char *path)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	pthread_t thread;
+	int sfd, fd, rc;
+	void **arg;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	strcpy(addr.sun_path, path);
+	sfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sfd < 0)
+		return -errno;
+	unlink(path);
+	if (bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(sfd, 16)) {
+		rc = -errno;
+		close(sfd);
+		return rc;
+	}
+	fprintf(stderr, "Listening on %s\n", path);
+	do {
+		fd = accept(sfd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			rc = -errno;
+			break;
+		}
+		arg = malloc(2 * sizeof(*arg));
+		if (!arg) {
+			close(fd);
+			continue;
+		}
+		arg[0] = s;
+		arg[1] = (void *)(long)fd;
+		pthread_mutex_lock(&s->lock);
+		s->conns++;
+		pthread_mutex_unlock(&s->lock);
+		if (pthread_create(&thread, NULL, conn_thread, arg)) {
+			pthread_mutex_lock(&s->lock);
+			s->conns--;
+			pthread_mutex_unlock(&s->lock);
+			free(arg);
+			close(fd);
+			continue;
+		}
+		pthread_detach(thread);
+	} while (1);
+	close(sfd);
+	/* The connections still open are using s */
+	pthread_mutex_lock(&s->lock);
+	while (s->conns)
+		pthread_cond_wait(&s->gone, &s->lock);
+	pthread_mutex_unlock(&s->lock);
+	return rc;
+}
+
+/* Has the workers finish what's queued, and waits for them */
+static void stop_workers(struct server *s, pthread_t *workers, long n)
+{
+	long i;
+
+	pthread_mutex_lock(&s->lock);
+	s->stop = true;
+	pthread_cond_broadcast(&s->more);
+	pthread_mutex_unlock(&s->lock);
+	for (i = 0; i < n; i++)
+		pthread_join(workers[i], NULL);
+}
+
+int serve(const struct entities *ent, const char *path)
+{
+	struct server s = {.ent = ent};
+	long i, nworkers;
+	pthread_t *workers;
+	int rc;
+
+	s.tail = &s.head;
+	pthread_mutex_init(&s.lock, NULL);
+	pthread_cond_init(&s.more, NULL);
+	pthread_cond_init(&s.gone, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	nworkers = max(sysconf(_SC_NPROCESSORS_ONLN), 1);
+	workers = malloc(nworkers * sizeof(*workers));
+	if (!workers)
+		return -ENOMEM;
+	for (i = 0; i < nworkers; i++)
+		if (pthread_create(workers + i, NULL, worker, &s)) {
+			stop_workers(&s, workers, i);
+			free(workers);
+			return -EAGAIN;
+		}
+	fprintf(stderr, "Serving with %ld workers\n", nworkers);
+	if (path)
+		rc = serve_socket(&s, path);
+	else
+		rc = serve_conn(&s, STDIN_FILENO, STDOUT_FILENO);
+	stop_workers(&s, workers, nworkers);
+	free(workers);
+	return rc;
+}
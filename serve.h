@@ -0,0 +1,11 @@
+#ifndef _SERVE_H
+#define _SERVE_H
+
+#include "data.h"
+
+/* Serves evaluation requests until EOF (on stdin) or forever (on a
+ * Unix-domain socket at path).  path == NULL means stdin/stdout.
+ */
+int serve(const struct entities *ent, const char *path);
+
+#endif // _SERVE_H
@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "solve.h"
+
+static unsigned int get_area(const struct bomber *b) { return b->wing.area; }
+static unsigned int get_aspect(const struct bomber *b) { return b->wing.art; }
+static unsigned int get_load(const struct bomber *b) { return b->bay.load; }
+static unsigned int get_bay(const struct bomber *b) { return b->bay.cap; }
+static unsigned int get_fuel(const struct bomber *b) { return b->tanks.hlb; }
+static unsigned int get_fill(const struct bomber *b) { return b->tanks.pct; }
+static unsigned int get_mtow(const struct bomber *b) { return b->mtow; }
+
+static void set_area(struct bomber *b, unsigned int v) { b->wing.area = v; }
+static void set_aspect(struct bomber *b, unsigned int v) { b->wing.art = v; }
+static void set_load(struct bomber *b, unsigned int v) { b->bay.load = v; }
+static void set_bay(struct bomber *b, unsigned int v) { b->bay.cap = v; }
+static void set_fuel(struct bomber *b, unsigned int v) { b->tanks.hlb = v; }
+static void set_fill(struct bomber *b, unsigned int v) { b->tanks.pct = v; }
+
+static void set_mtow(struct bomber *b, unsigned int v)
+{
+	b->mtow = v;
+	b->user_mtow = true;
+}
+
+const struct hb_knob hb_knobs[] = {
+	{"area", CALC_WING, get_area, set_area, 1, 10000, NULL, REFIT_FRESH,
+	 "Wing area, sq ft"},
+	{"aspect", CALC_WING, get_aspect, set_aspect, 1, 300, NULL,
+	 REFIT_FRESH, "Aspect ratio, tenths"},
+	{"load", CALC_BOMBBAY, get_load, set_load, 0, 50000, get_bay,
+	 REFIT_DOCTRINE, "Bomb load, lb"},
+	{"bay", CALC_BOMBBAY, get_bay, set_bay, 0, 50000, NULL, REFIT_FRESH,
+	 "Bomb bay capacity, lb"},
+	{"fuel", CALC_TANKS, get_fuel, set_fuel, 1, 1000, NULL, REFIT_MARK,
+	 "Fuel capacity, hundreds lb"},
+	{"fill", CALC_TANKS, get_fill, set_fill, 1, 100, NULL, REFIT_DOCTRINE,
+	 "Fuel fill level, %"},
+	{"mtow", CALC_PERF, get_mtow, set_mtow, 1, 200000, NULL, REFIT_MARK,
+	 "Max. take-off weight, lb"},
+};
+const unsigned int hb_nknobs = ARRAY_SIZE(hb_knobs);
+
+const struct hb_knob *hb_find_knob(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < hb_nknobs; i++)
+		if (!strcmp(name, hb_knobs[i].name))
+			return hb_knobs + i;
+	return NULL;
+}
+
+int hb_parse_query(const char *s, struct hb_query *q)
+{
+	size_t len = strcspn(s, " \t");
+	char name[32];
+
+	if (!strncmp(s, "min:", 4))
+		q->maximise = false;
+	else if (!strncmp(s, "max:", 4))
+		q->maximise = true;
+	else
+		return -EINVAL;
+	if (len < 4 || len - 4 >= sizeof(name))
+		return -EINVAL;
+	memcpy(name, s + 4, len - 4);
+	name[len - 4] = 0;
+	q->k = hb_find_knob(name);
+	if (!q->k)
+		return -ENOENT;
+	s += len + strspn(s + len, " \t");
+	return hb_parse_constraint(s, &q->goal);
+}
+
+struct trial {
+	struct bomber *b;
+	const struct tech_numbers *tn;
+	const struct hb_query *q;
+	unsigned int evals;
+};
+
+/* Sets the input to v and tells whether the goal is met */
+static int meets(struct trial *t, unsigned int v, bool *ok)
+{
+	const struct hb_constraint *c = &t->q->goal;
+	float x;
+	int rc;
+
+	t->q->k->set(t->b, v);
+	rc = calc_bomber_from(t->b, t->tn, t->q->k->stage);
+	t->evals++;
+	if (rc)
+		return rc;
+	x = c->m->get(t->b);
+	*ok = c->le ? x <= c->value : x >= c->value;
+	return 0;
+}
+
+int hb_solve(struct bomber *b, const struct tech_numbers *tn,
+	     const struct hb_query *q, unsigned int *evals)
+{
+	struct trial t = {.b = b, .tn = tn, .q = q};
+	const struct hb_knob *k = q->k;
+	unsigned int lo = k->lo, hi = k->hi, orig = k->get(b), v0;
+	unsigned int good, bad, step, v;
+	bool up = !q->maximise, user_mtow = b->user_mtow, ok;
+	int rc;
+
+	if (b->refit > k->refit)
+		return -EPERM;
+	if (k->top)
+		hi = min(hi, k->top(b));
+	if (lo > hi)
+		return -ERANGE;
+	v0 = min(max(orig, lo), hi);
+	/* Searching up for a min or down for a max: if the end we're
+	 * searching towards meets the goal, that's the answer; else it
+	 * anchors the bracket.
+	 */
+	bad = up ? lo : hi;
+	rc = meets(&t, bad, &ok);
+	if (rc)
+		goto out;
+	if (ok) {
+		good = bad;
+		goto done;
+	}
+	/* Walk out from the current setting, doubling the step, until the
+	 * goal is met
+	 */
+	good = v0;
+	step = 1;
+	do {
+		if (good != bad) {
+			rc = meets(&t, good, &ok);
+			if (rc)
+				goto out;
+			if (ok)
+				break;
+			bad = good;
+		}
+		if (good == (up ? hi : lo)) {
+			rc = -ERANGE;
+			goto out;
+		}
+		good = up ? (hi - good > step ? good + step : hi) :
+			    (good - lo > step ? good - step : lo);
+		step *= 2;
+	} while (1);
+	/* Bisect the bracket */
+	while (max(good, bad) - min(good, bad) > 1) {
+		v = min(good, bad) + (max(good, bad) - min(good, bad)) / 2;
+		rc = meets(&t, v, &ok);
+		if (rc)
+			goto out;
+		if (ok)
+			good = v;
+		else
+			bad = v;
+	}
+done:
+	k->set(b, good);
+	rc = calc_bomber_from(b, tn, k->stage);
+	t.evals++;
+out:
+	if (rc) {
+		k->set(b, orig);
+		b->user_mtow = user_mtow;
+		calc_bomber_from(b, tn, k->stage);
+	}
+	if (evals)
+		*evals = t.evals;
+	return rc;
+}
@@ -0,0 +1,54 @@
+#ifndef _SOLVE_H
+#define _SOLVE_H
+
+/* Inverse queries: what is the least (or greatest) value of one input
+ * that meets a constraint on an output?  "min:area takeoff<=110" asks for
+ * the smallest wing that still gets off a 110 mph runway, "min:fill
+ * range>=600" the least fuel for 600 miles, "max:mtow cost<=40000" the
+ * highest MTOW before the stress factor pushes cost past 40000.
+ *
+ * The constraint is taken to be met on one side of some value of the
+ * input and not the other, as it is for the questions above.  The solver
+ * brackets that value, by steps doubling out from the input's current
+ * setting, then bisects the bracket; each trial only re-runs the
+ * calculation from the first stage the input feeds into.  Design errors
+ * are ignored while searching, so check the answer.
+ */
+
+#include "opt.h"
+
+struct hb_knob {
+	const char *name;
+	enum calc_stage stage; /* first stage it feeds into */
+	unsigned int (*get)(const struct bomber *b);
+	void (*set)(struct bomber *b, unsigned int v);
+	unsigned int lo, hi; /* values searched */
+	unsigned int (*top)(const struct bomber *b); /* if hi depends on b */
+	/* The last refit level that may change it, as the editor allows */
+	enum refit_level refit;
+	const char *desc;
+};
+
+extern const struct hb_knob hb_knobs[];
+extern const unsigned int hb_nknobs;
+
+const struct hb_knob *hb_find_knob(const char *name);
+
+struct hb_query {
+	const struct hb_knob *k;
+	bool maximise;
+	struct hb_constraint goal;
+};
+
+/* "min:INPUT CONSTRAINT" or "max:INPUT CONSTRAINT" */
+int hb_parse_query(const char *s, struct hb_query *q);
+
+/* On success b is left set to, and evaluated at, the answer.  Returns
+ * -ERANGE if no value in the input's range meets the goal, leaving b as
+ * it was, or -EPERM if b is a refit that can't change the input.  evals,
+ * if not NULL, counts the recalculations.
+ */
+int hb_solve(struct bomber *b, const struct tech_numbers *tn,
+	     const struct hb_query *q, unsigned int *evals);
+
+#endif // _SOLVE_H
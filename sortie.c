@@ -0,0 +1,195 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "sortie.h"
+
+struct force_type {
+	unsigned int count, load;
+	unsigned long long serv, abort, flak, accu;
+	double fighters; /* exponent, per unit of the night's weight */
+};
+
+/* Per worker; type[] and tons[] follow it */
+struct raid_tally {
+	struct hb_sortie_type *type;
+	unsigned long *tons;
+	unsigned long loss[HB_SORTIE_LOSS_BINS + 1];
+	unsigned long sorties, lost;
+};
+
+struct force {
+	const struct hb_sortie_sim *o;
+	unsigned int n, ntons;
+	struct force_type *t;
+	struct raid_tally *tally;
+	size_t tally_size;
+};
+
+static int fly(void *ctx, struct hb_worker *w, unsigned long i)
+{
+	struct force *f = ctx;
+	struct raid_tally *t = hb_tally(f->tally, f->tally_size, w->id);
+	unsigned long long key = dice_roll(f->o->seed, i), r, idx = 1;
+	unsigned long long fighters;
+	unsigned long sorties = 0, lost = 0, lb = 0;
+	const struct force_type *ft;
+	struct hb_sortie_type *tt;
+	unsigned int d, k;
+	double weight;
+
+	/* How well the night fighters find the stream tonight */
+	weight = -log(((dice_roll(key, 0) >> 11) + 0.5) / 9007199254740992.0);
+	for (d = 0; d < f->n; d++) {
+		ft = f->t + d;
+		tt = t->type + d;
+		fighters = dice_bound(1.0 - exp(-ft->fighters * weight));
+		/* Three rolls an aircraft, whether it needs them or not, so
+		 * that the rest of the raid doesn't depend on how it went
+		 */
+		for (k = 0; k < ft->count; k++, idx += 3) {
+			r = dice_roll(key, idx);
+			if ((r & 0xffffffff) >= ft->serv)
+				continue;
+			tt->sorties++;
+			sorties++;
+			if ((r >> 32) < ft->abort) {
+				tt->aborts++;
+				continue;
+			}
+			r = dice_roll(key, idx + 1);
+			if ((r & 0xffffffff) < fighters) {
+				tt->fighter++;
+				lost++;
+				continue;
+			}
+			if ((r >> 32) < ft->flak) {
+				tt->flak++;
+				lost++;
+				continue;
+			}
+			r = dice_roll(key, idx + 2);
+			if ((r & 0xffffffff) < ft->accu) {
+				tt->hits++;
+				lb += ft->load;
+			}
+			if ((r >> 32) < fighters) {
+				tt->fighter++;
+				lost++;
+			}
+		}
+	}
+	t->sorties += sorties;
+	t->lost += lost;
+	if (sorties)
+		t->loss[(lost * HB_SORTIE_LOSS_BINS + sorties / 2) / sorties]++;
+	t->tons[lb / HB_SORTIE_TON_LB]++;
+	return 0;
+}
+
+int hb_sortie_simulate(struct hb_pool *p, const struct bomber *designs,
+		       const unsigned int *count, unsigned int n,
+		       const struct hb_sortie_sim *o,
+		       struct hb_sortie_result *res)
+{
+	unsigned int nw = hb_pool_size(p), i, j;
+	struct force f = {.o = o, .n = n};
+	struct raid_tally *t;
+	const struct bomber *b;
+	unsigned long lb = 0;
+	float d = o->dist / HB_SORTIE_DIST;
+	int rc = -ENOMEM;
+
+	memset(res, 0, sizeof(*res));
+	if (!n || !o->raids || o->dist < 0 || o->fighters < 0 || o->flak < 0)
+		return -EINVAL;
+	for (i = 0; i < n; i++)
+		if (designs[i].range < o->dist)
+			return -EDOM;
+	f.t = calloc(n, sizeof(*f.t));
+	if (!f.t)
+		return -ENOMEM;
+	for (i = 0; i < n; i++) {
+		b = designs + i;
+		f.t[i] = (struct force_type){
+			.count = count[i],
+			.load = b->bay.load,
+			.serv = dice_bound(b->serv),
+			.abort = dice_bound(1.0 - exp(-b->fail * d)),
+			.flak = dice_bound(1.0 - exp(-o->flak * b->flak_factor /
+						1000.0)),
+			.accu = dice_bound(b->accu),
+			.fighters = o->fighters * b->fight_factor[o->schrage] *
+				    d / 2000.0,
+		};
+		lb += (unsigned long)count[i] * b->bay.load;
+	}
+	f.ntons = lb / HB_SORTIE_TON_LB + 1;
+	f.tally_size = sizeof(*t) + n * sizeof(*t->type) +
+		       f.ntons * sizeof(*t->tons);
+	f.tally = hb_tally_alloc(p, f.tally_size);
+	if (!f.tally)
+		goto out;
+	for (i = 0; i < nw; i++) {
+		t = hb_tally(f.tally, f.tally_size, i);
+		t->type = (struct hb_sortie_type *)(t + 1);
+		t->tons = (unsigned long *)(t->type + n);
+	}
+	res->type = calloc(n, sizeof(*res->type));
+	res->tons = calloc(f.ntons, sizeof(*res->tons));
+	if (!res->type || !res->tons)
+		goto out;
+	rc = hb_parallel_for(p, o->raids, 0, fly, &f);
+	if (rc)
+		goto out;
+
+	res->raids = o->raids;
+	res->ndesign = n;
+	res->ntons = f.ntons;
+	for (i = 0; i < nw; i++) {
+		t = hb_tally(f.tally, f.tally_size, i);
+		res->sorties += t->sorties;
+		res->lost += t->lost;
+		for (j = 0; j <= HB_SORTIE_LOSS_BINS; j++)
+			res->loss[j] += t->loss[j];
+		for (j = 0; j < f.ntons; j++)
+			res->tons[j] += t->tons[j];
+		for (j = 0; j < n; j++) {
+			res->type[j].sorties += t->type[j].sorties;
+			res->type[j].aborts += t->type[j].aborts;
+			res->type[j].fighter += t->type[j].fighter;
+			res->type[j].flak += t->type[j].flak;
+			res->type[j].hits += t->type[j].hits;
+		}
+	}
+	for (j = 0; j < n; j++)
+		res->type[j].tons = res->type[j].hits * (double)f.t[j].load /
+				    2240.0;
+out:
+	free(f.tally);
+	free(f.t);
+	if (rc)
+		hb_sortie_free(res);
+	return rc;
+}
+
+void hb_sortie_free(struct hb_sortie_result *res)
+{
+	free(res->tons);
+	free(res->type);
+	res->tons = NULL;
+	res->type = NULL;
+}
+
+unsigned int hb_hist_quantile(const unsigned long *h, unsigned int n,
+			      double q)
+{
+	unsigned long total = 0, sum;
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		total += h[i];
+	for (i = 0, sum = h[0]; i + 1 < n && sum < q * total; )
+		sum += h[++i];
+	return i;
+}
@@ -0,0 +1,75 @@
+#ifndef _SORTIE_H
+#define _SORTIE_H
+
+/* What a design's figures would mean over the target.
+ *
+ * hb_sortie_simulate() flies many raids, over the pool, with a force made
+ * up of some number of each of a set of evaluated designs.  For each
+ * aircraft in turn,
+ *  - it is fit to fly with probability serv; if not, it stays at home
+ *    and doesn't count as a sortie,
+ *  - it turns back with a fault with probability 1 - exp(-fail * d),
+ *  - it is shot down by fighters on the way out with probability
+ *    1 - exp(-F * ff * d / 2000),
+ *  - it is shot down by flak over the target with probability
+ *    1 - exp(-K * flak_factor / 1000),
+ *  - its bombs hit the target with probability accu, and
+ *  - it is shot down by fighters on the way home with the same
+ *    probability as on the way out,
+ * where d is the distance to the target over HB_SORTIE_DIST and ff the
+ * design's fight_factor, before or after Schräge Musik.  K is the flak
+ * level, and F the fighter level times a weight for how well the night
+ * fighters find the stream, drawn for each raid from an exponential with
+ * mean 1.  The designs must all have the range to get there.
+ *
+ * Each raid's rolls are keyed by the run's seed and the raid number (see
+ * pool.h).
+ */
+
+#include "pool.h"
+
+#define HB_SORTIE_DIST		500.0f /* miles */
+#define HB_SORTIE_LOSS_BINS	1000 /* loss rate in steps of 0.1% */
+#define HB_SORTIE_TON_LB	224 /* tonnage in steps of a tenth of a ton */
+
+struct hb_sortie_sim {
+	unsigned long raids;
+	unsigned int seed;
+	float dist; /* miles */
+	float fighters, flak;
+	bool schrage;
+};
+
+/* Totals over all the raids for one design */
+struct hb_sortie_type {
+	unsigned long sorties, aborts, fighter, flak, hits;
+	double tons; /* on the target */
+};
+
+struct hb_sortie_result {
+	unsigned long raids, sorties, lost;
+	unsigned int ndesign;
+	struct hb_sortie_type *type; /* [ndesign] */
+	/* Raids by loss rate, lost * HB_SORTIE_LOSS_BINS / sorties rounded
+	 * (raids with no sorties aren't counted)
+	 */
+	unsigned long loss[HB_SORTIE_LOSS_BINS + 1];
+	/* Raids by tonnage on the target, in HB_SORTIE_TON_LB units */
+	unsigned int ntons;
+	unsigned long *tons;
+};
+
+/* count[i] of designs[i] fly on each raid; -EDOM if one of them hasn't
+ * the range
+ */
+int hb_sortie_simulate(struct hb_pool *p, const struct bomber *designs,
+		       const unsigned int *count, unsigned int n,
+		       const struct hb_sortie_sim *o,
+		       struct hb_sortie_result *res);
+void hb_sortie_free(struct hb_sortie_result *res);
+
+/* The least bin i with h[0] + ... + h[i] at least q of the total */
+unsigned int hb_hist_quantile(const unsigned long *h, unsigned int n,
+			      double q);
+
+#endif // _SORTIE_H
@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "squadron.h"
+
+struct sq_type {
+	unsigned long long serv, fail, fix;
+};
+
+/* Per worker; the counts follow it */
+struct sq_tally {
+	unsigned long *ready; /* [n * (aircraft + 1)] */
+	unsigned long *sorties, *faults; /* [n] */
+};
+
+struct squadrons {
+	const struct hb_squadron *o;
+	unsigned int n;
+	struct sq_type *t;
+	struct sq_tally *tally;
+	size_t tally_size;
+};
+
+static int campaign(void *ctx, struct hb_worker *w, unsigned long i)
+{
+	struct squadrons *s = ctx;
+	const struct hb_squadron *o = s->o;
+	unsigned int d = i / o->runs, day, k, line, ready, waiting = 0;
+	unsigned int working = 0, fixed, broke;
+	unsigned long long key = dice_roll(o->seed, i % o->runs), r, idx;
+	const struct sq_type *t = s->t + d;
+	struct sq_tally *tl = hb_tally(s->tally, s->tally_size, w->id);
+	unsigned long *hist = tl->ready + d * (o->aircraft + 1);
+	bool raid;
+
+	line = o->aircraft;
+	for (day = 0; day < o->days; day++) {
+		/* One roll an aircraft a day: line aircraft first, then those
+		 * in the hangar, then the weather
+		 */
+		idx = (unsigned long long)day * (o->aircraft + 1);
+		r = dice_roll(key, idx + o->aircraft);
+		raid = ((r >> 32) * 100 >> 32) < o->raid;
+		ready = broke = 0;
+		for (k = 0; k < line; k++) {
+			r = dice_roll(key, idx + k);
+			if ((r & 0xffffffff) >= t->serv)
+				continue;
+			ready++;
+			if (raid && (r >> 32) < t->fail)
+				broke++;
+		}
+		hist[ready]++;
+		if (raid) {
+			tl->sorties[d] += ready;
+			tl->faults[d] += broke;
+		}
+		for (fixed = 0, k = 0; k < working; k++) {
+			r = dice_roll(key, idx + line + k);
+			if ((r & 0xffffffff) < t->fix)
+				fixed++;
+		}
+		line += fixed - broke;
+		working -= fixed;
+		waiting += broke;
+		k = min(waiting, o->crews - working);
+		working += k;
+		waiting -= k;
+	}
+	return 0;
+}
+
+int hb_squadron_simulate(struct hb_pool *p, const struct bomber *designs,
+			 unsigned int n, const struct hb_squadron *o,
+			 struct hb_squadron_result *res)
+{
+	unsigned int nw = hb_pool_size(p), len = o->aircraft + 1, i, j, k;
+	struct squadrons s = {.o = o, .n = n};
+	const struct bomber *b;
+	struct sq_tally *tl;
+	double repair;
+	int rc = -ENOMEM;
+
+	memset(res, 0, n * sizeof(*res));
+	if (!n || !o->runs || !o->aircraft || !o->days || !o->crews ||
+	    o->raid > 100 || o->repair < 1)
+		return -EINVAL;
+	s.t = calloc(n, sizeof(*s.t));
+	if (!s.t)
+		return -ENOMEM;
+	for (i = 0; i < n; i++) {
+		b = designs + i;
+		repair = o->repair;
+		if (b->crew.engineers)
+			repair *= 0.9 / b->crew.es;
+		s.t[i] = (struct sq_type){
+			.serv = dice_bound(b->serv),
+			.fail = dice_bound(b->fail),
+			.fix = dice_bound(1.0 / max(repair, 1.0)),
+		};
+	}
+	s.tally_size = sizeof(*tl) +
+		       (size_t)n * (len + 2) * sizeof(*tl->ready);
+	s.tally = hb_tally_alloc(p, s.tally_size);
+	if (!s.tally)
+		goto out;
+	for (i = 0; i < nw; i++) {
+		tl = hb_tally(s.tally, s.tally_size, i);
+		tl->ready = (unsigned long *)(tl + 1);
+		tl->sorties = tl->ready + n * len;
+		tl->faults = tl->sorties + n;
+	}
+	for (i = 0; i < n; i++) {
+		res[i].ready = calloc(len, sizeof(*res[i].ready));
+		if (!res[i].ready)
+			goto out;
+	}
+	rc = hb_parallel_for(p, (unsigned long)n * o->runs, 0, campaign, &s);
+	if (rc)
+		goto out;
+
+	for (i = 0; i < n; i++) {
+		res[i].aircraft = o->aircraft;
+		res[i].days = o->runs * o->days;
+		for (j = 0; j < nw; j++) {
+			tl = hb_tally(s.tally, s.tally_size, j);
+			for (k = 0; k < len; k++)
+				res[i].ready[k] += tl->ready[i * len + k];
+			res[i].sorties += tl->sorties[i];
+			res[i].faults += tl->faults[i];
+		}
+		for (k = 0; k < len; k++)
+			res[i].mean += (double)k * res[i].ready[k];
+		res[i].mean /= res[i].days;
+	}
+out:
+	free(s.tally);
+	free(s.t);
+	if (rc)
+		hb_squadron_free(res, n);
+	return rc;
+}
+
+void hb_squadron_free(struct hb_squadron_result *res, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		free(res[i].ready);
+		res[i].ready = NULL;
+	}
+}
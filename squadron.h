@@ -0,0 +1,46 @@
+#ifndef _SQUADRON_H
+#define _SQUADRON_H
+
+/* How many of a squadron's aircraft are ready to fly, day by day.
+ *
+ * hb_squadron_simulate() runs a squadron of each design through many
+ * campaigns of some days, over the pool, starting with every aircraft on
+ * the line.  Each day
+ *  - each aircraft on the line is ready with probability serv (else it
+ *    has a snag the line crew clears by the next day),
+ *  - on raid nights, which come at random, every ready aircraft flies,
+ *    and comes back with a fault with probability fail; it then joins the
+ *    queue for the hangar,
+ *  - the hangar works on as many aircraft at once as it has crews, and
+ *    each job is finished with probability 1 / repair each day.  A flight
+ *    engineer's log pins faults down, so for a design carrying one, repair
+ *    is scaled by the same 0.9 / es that calc_rely() applies to fail.
+ * It counts the days on which each number of aircraft were ready.  Run r
+ * of every design uses the same rolls, keyed by the run's seed and r, so
+ * designs are compared on the same luck.
+ */
+
+#include "pool.h"
+
+struct hb_squadron {
+	unsigned long runs;
+	unsigned int seed;
+	unsigned int aircraft, days, crews;
+	unsigned int raid; /* percent of nights */
+	float repair; /* mean days in the hangar, with no engineer */
+};
+
+struct hb_squadron_result {
+	unsigned int aircraft;
+	unsigned long *ready; /* [aircraft + 1]: days with that many ready */
+	unsigned long days, sorties, faults;
+	double mean; /* aircraft ready, per day */
+};
+
+/* Fills in res[i] for designs[i] */
+int hb_squadron_simulate(struct hb_pool *p, const struct bomber *designs,
+			 unsigned int n, const struct hb_squadron *o,
+			 struct hb_squadron_result *res);
+void hb_squadron_free(struct hb_squadron_result *res, unsigned int n);
+
+#endif // _SQUADRON_H
@@ -0,0 +1,138 @@
+/* techcheck [-n ROUNDS]: tech states built a tech at a time against ones
+ * built from scratch.
+ *
+ * Fails unless every month's state from hb_timeline_techs() is, byte for
+ * byte, hb_tech_date()'s for that month; and unless random sets of techs,
+ * researched one by one in random order with hb_tech_add() on top of a
+ * random starting set, give hb_tech_set()'s state after every one.
+ * Run by `make check`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "timeline.h"
+
+/* Reports the first word in which a and b differ, if they do */
+static bool differ(const struct tech_numbers *a, const struct tech_numbers *b,
+		   const char *what)
+{
+	const unsigned int *p = (const unsigned int *)a;
+	const unsigned int *q = (const unsigned int *)b;
+	size_t i;
+
+	for (i = 0; i < sizeof(*a) / sizeof(*p); i++)
+		if (p[i] != q[i]) {
+			fprintf(stderr, "%s: word %zu is %#x, not %#x\n", what,
+				i, p[i], q[i]);
+			return true;
+		}
+	return memcmp(a, b, sizeof(*a));
+}
+
+static int check_timeline(const struct entities *ent)
+{
+	struct tech_numbers *tn, want;
+	unsigned int m, bad = 0;
+	char what[32];
+	int rc;
+
+	tn = malloc(HB_TIMELINE_MONTHS * sizeof(*tn));
+	if (!tn)
+		return -ENOMEM;
+	rc = hb_timeline_techs(ent, tn);
+	for (m = 0; !rc && m < HB_TIMELINE_MONTHS; m++) {
+		rc = hb_tech_date(ent, HB_TIMELINE_FIRST + m / 12, m % 12 + 1,
+				  &want);
+		snprintf(what, sizeof(what), "%u/%u", HB_TIMELINE_FIRST + m / 12,
+			 m % 12 + 1);
+		if (!rc && differ(tn + m, &want, what))
+			bad++;
+	}
+	free(tn);
+	if (rc)
+		return rc;
+	printf("TIMELINE:MONTHS=%u:BAD=%u\n", HB_TIMELINE_MONTHS, bad);
+	return bad ? 1 : 0;
+}
+
+static int check_random(const struct entities *ent, unsigned int rounds)
+{
+	unsigned int order[MAX_TECHS], techs[BITSET_WORDS(MAX_TECHS)];
+	unsigned int r, i, j, k, n, t, adds = 0, bad = 0;
+	struct tech_numbers tn, want;
+	unsigned long long roll = 0;
+	char what[48];
+	int rc;
+
+	for (r = 0; r < rounds; r++) {
+		/* Start from a random set, and add the rest of another in a
+		 * random order
+		 */
+		memset(techs, 0, sizeof(techs));
+		for (i = n = 0; i < ent->ntech; i++) {
+			k = dice_roll(r, roll++) % 4;
+			if (!k)
+				set_bit(techs, i);
+			else if (k == 1)
+				order[n++] = i;
+		}
+		for (i = n; i > 1; i--) {
+			j = dice_roll(r, roll++) % i;
+			t = order[i - 1];
+			order[i - 1] = order[j];
+			order[j] = t;
+		}
+		rc = hb_tech_set(ent, techs, &tn);
+		if (rc)
+			return rc;
+		for (i = 0; i < n; i++, adds++) {
+			rc = hb_tech_add(ent, &tn, order[i]);
+			if (rc < 0)
+				return rc;
+			set_bit(techs, order[i]);
+			rc = hb_tech_set(ent, techs, &want);
+			if (rc)
+				return rc;
+			snprintf(what, sizeof(what), "round %u, add %u", r, i);
+			if (differ(&tn, &want, what)) {
+				bad++;
+				break;
+			}
+		}
+	}
+	printf("RANDOM:ROUNDS=%u:ADDS=%u:BAD=%u\n", rounds, adds, bad);
+	return bad ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int rounds = 1000;
+	struct hb_data d;
+	int rc, bad = 0;
+
+	if (argc == 3 && !strcmp(argv[1], "-n"))
+		rounds = strtoul(argv[2], NULL, 0);
+	if (argc != 1 && argc != 3) {
+		fprintf(stderr, "Usage: techcheck [-n ROUNDS]\n");
+		return 2;
+	}
+	rc = hb_load(&d, ".");
+	if (rc)
+		return 2;
+	rc = check_timeline(&d.ent);
+	if (rc >= 0) {
+		bad = rc;
+		rc = check_random(&d.ent, rounds);
+	}
+	hb_free(&d);
+	if (rc < 0) {
+		fprintf(stderr, "techcheck: %s\n", strerror(-rc));
+		return 2;
+	}
+	bad |= rc;
+	if (bad)
+		fprintf(stderr, "techcheck: tech states disagree\n");
+	return bad;
+}
@@ -0,0 +1,69 @@
+#include <string.h>
+#include <errno.h>
+#include "timeline.h"
+
+int hb_timeline_techs(const struct entities *ent,
+		      struct tech_numbers tn[HB_TIMELINE_MONTHS])
+{
+	unsigned int m, i;
+	int rc;
+
+	/* Everything from before the war */
+	rc = hb_tech_date(ent, HB_TIMELINE_FIRST - 1, 0, tn);
+	if (rc)
+		return rc;
+	for (m = 0; m < HB_TIMELINE_MONTHS; m++) {
+		unsigned int year = HB_TIMELINE_FIRST + m / 12;
+		unsigned int month = m % 12 + 1;
+
+		if (m)
+			tn[m] = tn[m - 1];
+		for (i = 0; i < ent->ntech; i++) {
+			const struct tech *t = ent->tech[i];
+
+			/* Techs dated just by year come in January */
+			if (t->year != year || max(t->month, 1) != month)
+				continue;
+			rc = hb_tech_add(ent, tn + m, i);
+			if (rc < 0)
+				return rc;
+		}
+	}
+	return 0;
+}
+
+struct timeline {
+	const struct bomber *designs;
+	unsigned int n;
+	const struct tech_numbers *tn;
+	struct hb_timeline_eval *res;
+};
+
+static int eval_one(void *ctx, struct hb_worker *w, unsigned long i)
+{
+	struct timeline *tl = ctx;
+	unsigned int m = i / tl->n, d = i % tl->n;
+	struct hb_timeline_eval *r = tl->res + d * HB_TIMELINE_MONTHS + m;
+
+	w->b = tl->designs[d];
+	r->rc = hb_evaluate(&w->b, tl->tn + m);
+	if (r->rc)
+		return 0;
+	hb_outputs(&w->b, &r->o);
+	r->new = w->b.new;
+	memcpy(r->ew, w->b.ew, w->b.new * sizeof(r->ew[0]));
+	return 0;
+}
+
+int hb_timeline(struct hb_pool *p, const struct bomber *designs,
+		unsigned int n, const struct tech_numbers *tn,
+		struct hb_timeline_eval *res)
+{
+	struct timeline tl = {.designs = designs, .n = n, .tn = tn,
+			      .res = res};
+
+	if (!n)
+		return -EINVAL;
+	return hb_parallel_for(p, (unsigned long)n * HB_TIMELINE_MONTHS, 0,
+			       eval_one, &tl);
+}
@@ -0,0 +1,36 @@
+#ifndef _TIMELINE_H
+#define _TIMELINE_H
+
+/* Designs across the war.
+ *
+ * hb_timeline_techs() builds the tech state of every month from January
+ * HB_TIMELINE_FIRST to December HB_TIMELINE_LAST, as hb_tech_date() would
+ * give it, but by adding each month's new techs to the month before with
+ * hb_tech_add() rather than starting over.  hb_timeline() then evaluates
+ * designs against all of them, over the pool, a month's designs at a time.
+ */
+
+#include "hbuilder.h"
+#include "pool.h"
+
+#define HB_TIMELINE_FIRST	1939
+#define HB_TIMELINE_LAST	1945
+#define HB_TIMELINE_MONTHS	((HB_TIMELINE_LAST - HB_TIMELINE_FIRST + 1) * 12)
+
+/* Month m (from 0) is month m % 12 + 1 of HB_TIMELINE_FIRST + m / 12 */
+int hb_timeline_techs(const struct entities *ent,
+		      struct tech_numbers tn[HB_TIMELINE_MONTHS]);
+
+struct hb_timeline_eval {
+	int rc;
+	struct hb_outputs o;
+	unsigned int new;
+	char ew[MAX_EW][EW_LEN]; /* errors and warnings */
+};
+
+/* res[d * HB_TIMELINE_MONTHS + m] is design d in month m */
+int hb_timeline(struct hb_pool *p, const struct bomber *designs,
+		unsigned int n, const struct tech_numbers *tn,
+		struct hb_timeline_eval *res);
+
+#endif // _TIMELINE_H